@@ -0,0 +1,144 @@
+// abcompare.h
+// interleaved, randomized A/B(/n) comparison of kernels with paired samples
+//
+//   std::vector<abcompare::TCandidate> candidates {{"stream", [&]{ stream(...); }},
+//                                                  {"faststream", [&]{ faststream(...); }}};
+//   auto results = abcompare::compare(candidates, 31);
+//   abcompare::print(std::cout, results);
+//
+// Each round runs every candidate once, in a new random order (after one discarded warm-up
+// round), so thermal drift and background noise hit all of them alike. Samples of the same
+// round are paired: candidate k is compared with the first one (baseline) by the per-round
+// log ratios log(t_k/t_0), i.e.
+// - relative difference exp(mean)-1 with the 95% confidence interval of Student's t,
+// - Wilcoxon signed-rank test (normal approximation, two-sided p): robust against outliers.
+// The optional setup function is called before each (untimed) run.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace abcompare {
+
+struct TCandidate {
+  std::string name;
+  std::function<void()> run;
+  std::function<void()> setup = nullptr;
+};
+
+struct TResult {
+  std::string name;
+  std::vector<double> times;  // [s] per round
+  double median = 0.;
+  // relative to the baseline (candidate 0), NAN for the baseline itself
+  double reldiff = NAN, reldiff_lo = NAN, reldiff_hi = NAN;  // 95% confidence interval
+  double pvalue = NAN;
+};
+
+struct TComparison {
+  unsigned int seed;
+  int rounds;
+  std::vector<TResult> results;
+};
+
+// two-sided 97.5% quantile of Student's t distribution
+inline double tquantile(int dof) {
+  static constexpr double table[] = {12.706, 4.303, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201,
+                                     2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+                                     2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042, 2.040};
+  if (dof < 1) return NAN;
+  if (dof <= 30) return table[dof - 1];
+  return 1.960 + 2.4 / dof;  // asymptotic
+}
+
+// Wilcoxon signed-rank test of the differences d (zeros dropped), two-sided p
+inline double wilcoxon(std::vector<double> d) {
+  d.erase(std::remove(d.begin(), d.end(), 0.), d.end());
+  const auto n = d.size();
+  if (n == 0) return 1.;
+  std::sort(d.begin(), d.end(), [](double x, double y) { return std::fabs(x) < std::fabs(y); });
+  double wplus = 0., tiecorrection = 0.;
+  for (std::size_t i = 0; i < n;) {
+    auto j = i;
+    while (j < n && std::fabs(d[j]) == std::fabs(d[i])) ++j;
+    const double rank = (i + 1 + j) / 2.;  // mean rank of ties
+    for (auto k = i; k < j; ++k)
+      if (d[k] > 0.) wplus += rank;
+    const double t = j - i;
+    tiecorrection += (t * t * t - t) / 48.;
+    i = j;
+  }
+  const double mean = n * (n + 1) / 4.;
+  const double var = n * (n + 1) * (2. * n + 1) / 24. - tiecorrection;
+  if (var <= 0.) return 1.;
+  const double z = (std::fabs(wplus - mean) - 0.5) / std::sqrt(var);  // continuity correction
+  return std::min(1., std::erfc(std::max(z, 0.) / std::sqrt(2.)));
+}
+
+inline double seconds(const TCandidate& candidate) {
+  if (candidate.setup) candidate.setup();
+  const auto start = std::chrono::steady_clock::now();
+  candidate.run();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+inline TComparison compare(const std::vector<TCandidate>& candidates, int rounds,
+                           unsigned int seed = std::random_device{}()) {
+  TComparison comparison{seed, rounds, {}};
+  const auto n = candidates.size();
+  for (const auto& candidate : candidates) comparison.results.push_back(TResult{candidate.name, {}});
+  std::vector<std::size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 generator(seed);
+
+  for (auto k : order) seconds(candidates[k]);  // warm-up (page faults, caches, frequency)
+  for (int round = 0; round < rounds; ++round) {
+    std::shuffle(order.begin(), order.end(), generator);
+    for (auto k : order) comparison.results[k].times.push_back(seconds(candidates[k]));
+  }
+
+  for (auto& result : comparison.results) {
+    auto sorted = result.times;
+    std::sort(sorted.begin(), sorted.end());
+    if (!sorted.empty())
+      result.median = (sorted[(sorted.size() - 1) / 2] + sorted[sorted.size() / 2]) / 2.;
+  }
+  if (rounds < 2) return comparison;
+  const auto& baseline = comparison.results[0].times;
+  for (std::size_t k = 1; k < n; ++k) {
+    auto& result = comparison.results[k];
+    std::vector<double> logratio(rounds);
+    for (int round = 0; round < rounds; ++round) logratio[round] = std::log(result.times[round] / baseline[round]);
+    const double mean = std::accumulate(logratio.begin(), logratio.end(), 0.) / rounds;
+    double var = 0.;
+    for (auto x : logratio) var += (x - mean) * (x - mean);
+    var /= rounds - 1;
+    const double halfwidth = tquantile(rounds - 1) * std::sqrt(var / rounds);
+    result.reldiff = std::expm1(mean);
+    result.reldiff_lo = std::expm1(mean - halfwidth);
+    result.reldiff_hi = std::expm1(mean + halfwidth);
+    result.pvalue = wilcoxon(logratio);
+  }
+  return comparison;
+}
+
+inline void print(std::ostream& out, const TComparison& comparison, double alpha = 0.05) {
+  out << "# A/B comparison: " << comparison.rounds << " interleaved rounds, seed " << comparison.seed << "\n";
+  out << "# name\tmedian[s]\treldiff\tCI95(lo)\tCI95(hi)\tp(Wilcoxon)\n";
+  for (const auto& result : comparison.results) {
+    out << result.name << "\t" << result.median << "\t" << result.reldiff << "\t" << result.reldiff_lo << "\t"
+        << result.reldiff_hi << "\t" << result.pvalue;
+    if (result.pvalue < alpha) out << "\tsignificant";
+    out << "\n";
+  }
+}
+
+}  // namespace abcompare
@@ -1,8 +1,15 @@
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <chrono>
+#include <cstdlib>
+#include <string>
 #include <vector>
 #include <numeric>
+#include <random>
+
+#include "abcompare.h"
 
 using TFloat = double;
 
@@ -24,14 +31,66 @@ void faststream(TFloat* a, TFloat* b, TFloat* c, TFloat* d, int N) {
   }
 }
 
+struct TKernel {
+  const char* name;
+  void (*func)(TFloat*, TFloat*, TFloat*, TFloat*, int);
+};
+
+constexpr std::array kernels {TKernel{"stream", stream}, TKernel{"faststream", faststream}};
+
+// benchmark              all iterations of one kernel, then the next one
+// benchmark ab [rounds] [seed=<seed>] [<kernel> <kernel>...]
+//                        interleaved, randomized comparison (abcompare.h), the first kernel is the baseline,
+//                        rounds >= 2 (default 31), the printed seed repeats the order of a comparison
 int main(int argc, char* argv[]) {
   constexpr int N = 10'000'000;
   int num_iters = 10;
   num_iters += 1 - (num_iters%2);
   using TimeUnit = std::chrono::microseconds;
 
-  std::array functions {stream, faststream};
-  for (const auto& func: functions) {
+  if (argc > 1 && std::string(argv[1]) == "ab") {
+    auto isnumber = [](const std::string& s) {
+      return !s.empty() && std::all_of(s.begin(), s.end(), [](unsigned char ch) { return std::isdigit(ch); });
+    };
+    int rounds = 31;
+    unsigned int seed = std::random_device{}();
+    int arg = 2;
+    if (arg < argc && isnumber(argv[arg])) rounds = std::atoi(argv[arg++]);
+    if (arg < argc && std::string(argv[arg]).rfind("seed=", 0) == 0) {
+      const std::string value = argv[arg++] + 5;
+      if (!isnumber(value)) {
+        std::cout << "ERROR seed has to be a number: " << value << "\n";
+        return 1;
+      }
+      seed = static_cast<unsigned int>(std::stoul(value));
+    }
+    if (rounds < 2) {
+      std::cout << "ERROR at least 2 rounds are needed for the comparison\n";
+      return 1;
+    }
+    auto a = init(N);
+    auto b = init(N);
+    auto c = init(N);
+    auto d = init(N);
+    std::vector<abcompare::TCandidate> candidates;
+    for (; arg < argc; ++arg) {
+      const auto kernel = std::find_if(kernels.begin(), kernels.end(),
+                                       [&](const TKernel& k) { return argv[arg] == std::string(k.name); });
+      if (kernel == kernels.end()) {
+        std::cout << "ERROR unknown kernel " << argv[arg] << "\n";
+        return 1;
+      }
+      candidates.push_back({kernel->name, [&, func = kernel->func] { func(&a[0], &b[0], &c[0], &d[0], N); }});
+    }
+    if (candidates.empty())
+      for (const auto& kernel : kernels)
+        candidates.push_back({kernel.name, [&, func = kernel.func] { func(&a[0], &b[0], &c[0], &d[0], N); }});
+    abcompare::print(std::cout, abcompare::compare(candidates, rounds, seed));
+    return 0;
+  }
+
+  for (const auto& [name, func]: kernels) {
+    std::cout << name << "\n";
     auto results = std::vector<int>(num_iters);
     for (auto i = 0; i < num_iters; ++i) {
       auto a = init(N);
@@ -0,0 +1,521 @@
+/* cachesim.c
+   set-associative multi-level cache simulator: predicted traffic of the stream kernels next to the measured bandwidth
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -march=native -O3 -pthread cachesim.c -o cachesim -lm
+
+	cachesim [<kernel copy|add|striad|vtriad>] [<stride>] [<layout array|list[<extra Bytes>]>] [<caches sysfs|<size>:<ways>[:<linesize>],...>] [<N> ...]
+
+	e.g.
+	$ taskset -c 2 ./cachesim vtriad 1 array sysfs
+	$ ./cachesim copy 8 list16 32K:8,1M:16,8M:16 100000 1000000
+	$ CACHESIM_MEASURE=0 ./cachesim vtriad 1 array 48K:12,2M:16,30M:12	# prediction only
+
+	- caches: data or unified caches of cpu0 (/sys/devices/system/cpu/cpu0/cache: size,
+	  ways_of_associativity, coherency_line_size) or given as size[K|M]:ways[:linesize] per level
+	  (up to MAXLEVELS), modulo set index, LRU replacement, write-back with write allocate,
+	  non-inclusive (a miss fills all levels, dirty victims are written to the next level)
+	- layouts: the arrays of stream_ref.c (element i at a+i*sizeof(Tfloat)) or the listnode of
+	  ../bernremn.develop/streamlist.c ({next,data[,extra[LIST_NEXTRA]]}, the traversal reads
+	  next and data, writes data of a), every stride-th element, i.e. Neff=ceil(N/stride)
+	- replay: the load/store address streams in the order of the kernel (b,c,d loads, a store)
+	  at the addresses of the arrays actually allocated for the measurement. An access to the
+	  same line as the previous one of the same array is an L1 hit without lookup (no reuse
+	  distance in between), i.e. stride 1 costs one lookup per line. After a warm-up sweep
+	  SIMSWEEPS sweeps are counted: hits/misses per level and the Bytes moved between the
+	  levels (fills and writebacks of dirty lines), per element
+	- measurement: stream_kernels.h (scalar kernels, vtriad_strided for stride>1; no strided
+	  copy/add/sTRIAD there, i.e. nan) or the list traversal, best of NUMSAMPLES with at least
+	  MINSAMPLETIME, bandwidth as stream_ref.c counts it (Neff*sizeof(Tfloat)*arrays)
+	- level: the one serving the loads (deepest boundary moving at least half of the L1 fills,
+	  L1 if the L1 fills stay below 1/8 of the elements accessed). The measured time divided into
+	  the predicted Bytes of that boundary gives its effective bandwidth, points deviating more
+	  than FLAGFACTOR from the median of all points of the same level are flagged:
+	    FASTER: less traffic than predicted (hardware prefetchers hiding the latency of the
+	      next level, adaptive replacement keeping more than LRU would, larger effective cache)
+	    SLOWER: more traffic (adjacent line/stream prefetchers fetching unused lines at strides,
+	      conflicts of the physical indexing/L3 slice hashing, TLB misses)
+	There is no prefetcher model on purpose: the difference to the measurement shows it.
+*/
+
+#include<stdlib.h>	/* malloc(),calloc(),free(),atol(),getenv() */
+#include<stdio.h>	/* printf(),fopen(),fscanf() */
+#include<string.h>	/* strcmp(),strncmp(),strchr(),strtok() */
+#include<strings.h>	/* strcasecmp() */
+#include<stdint.h>	/* uintptr_t */
+
+#include "stream_kernels.h"
+#include "tsctimer.h"
+
+#define MAXLEVELS 4
+#define MAXPOINTS 64
+#define SIMSWEEPS 2
+#define NUMSAMPLES 5
+#define MINSAMPLETIME 0.02	/* [s] */
+#define MAXWORKINGSET (1024UL<<20)	/* default N sweep up to 4x the last level, at most [Bytes] */
+#define FLAGFACTOR 1.3
+#define DEFAULT_LINESIZE 64
+
+typedef struct {
+	unsigned long size;
+	unsigned int ways, linesize;
+	unsigned long numsets;
+	unsigned long *tag;	/* numsets*ways: line+1, 0: invalid */
+	unsigned long *stamp;	/* last use (LRU) */
+	unsigned char *dirty;
+	unsigned long clock;
+	unsigned long hits, misses, writebacks;	/* hits/misses of loads and stores (fills), not of writebacks */
+} Tcache;
+
+typedef struct {
+	unsigned long lastline;
+	int lastwrite;
+} Tstream;
+
+typedef struct Tlistnode {
+	struct Tlistnode *next;	/* as streamlist.c: next, data (and extra Bytes) */
+	Tfloat data;
+} Tlistnode;
+
+typedef struct {
+	Tindex N, Neff;
+	double bytes[MAXLEVELS];	/* predicted between level l and l+1 (memory) per element */
+	double hitrate[MAXLEVELS];
+	int level;	/* serving level, numlevels: memory */
+	double time, bandwidth, levelbandwidth;	/* measured [s] per sweep, [Bytes/s] */
+	double simtime;
+} Tpoint;
+
+static Tcache cache[MAXLEVELS];
+static unsigned int numlevels=0;
+static Ttsctimer timer;
+
+
+/* caches =======================================================================================*/
+static unsigned long sysfsvalue(unsigned int index, const char *name)
+{	/* number in /sys/devices/system/cpu/cpu0/cache/index<index>/<name> (K/M suffix), 0 if unknown */
+	char path[128], unit=' ';
+	unsigned long value=0;
+	FILE *f;
+	snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%u/%s",index,name);
+	if(!(f=fopen(path,"r"))) return 0;
+	if(fscanf(f,"%lu%c",&value,&unit)<1) value=0;
+	fclose(f);
+	if(unit=='K') value<<=10;
+	if(unit=='M') value<<=20;
+	return value;
+}
+
+static void cache_init(Tcache *c, unsigned long size, unsigned int ways, unsigned int linesize)
+{
+	if(!linesize) linesize=DEFAULT_LINESIZE;
+	if(!ways) ways=1;
+	c->linesize=linesize;
+	c->ways=ways;
+	c->numsets=size/((unsigned long)ways*linesize);
+	if(c->numsets==0)
+	{
+		printf("ERROR cache level %u: %lu Bytes too small for %u ways of %u Bytes\n",numlevels+1,size,ways,linesize);
+		exit(1);
+	}
+	c->size=c->numsets*ways*linesize;
+	c->tag=(unsigned long*)malloc(c->numsets*ways*sizeof(unsigned long));
+	c->stamp=(unsigned long*)malloc(c->numsets*ways*sizeof(unsigned long));
+	c->dirty=(unsigned char*)malloc(c->numsets*ways);
+	if(!c->tag || !c->stamp || !c->dirty)
+	{
+		printf("ERROR allocating the tags of cache level %u (%lu Bytes)\n",numlevels+1,size);
+		exit(1);
+	}
+}
+
+static void caches_sysfs(void)
+{
+	unsigned int level, index;
+	for(level=1;level<=MAXLEVELS;++level)
+	{
+		for(index=0;index<16;++index)
+		{
+			char path[128], type[32]="";
+			FILE *f;
+			snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%u/type",index);
+			if(!(f=fopen(path,"r"))) break;
+			if(fscanf(f,"%31s",type)!=1) type[0]='\0';
+			fclose(f);
+			if(sysfsvalue(index,"level")!=level || (strcmp(type,"Data") && strcmp(type,"Unified"))) continue;
+			cache_init(&cache[numlevels],sysfsvalue(index,"size"),sysfsvalue(index,"ways_of_associativity")
+			          ,sysfsvalue(index,"coherency_line_size"));
+			++numlevels;
+			break;
+		}
+	}
+}
+
+static void caches_parse(char *spec)
+{	/* size[K|M]:ways[:linesize],... */
+	char *level;
+	for(level=strtok(spec,",");level && numlevels<MAXLEVELS;level=strtok(NULL,","))
+	{
+		char unit=' ';
+		unsigned long size=0;
+		unsigned int ways=0, linesize=0;
+		int n=sscanf(level,"%lu%c",&size,&unit);
+		char *p=strchr(level,':');
+		if(n<1 || !p || sscanf(p,":%u:%u",&ways,&linesize)<1)
+		{
+			printf("ERROR cache specification %s (size[K|M]:ways[:linesize])\n",level);
+			exit(1);
+		}
+		if(unit=='K') size<<=10;
+		if(unit=='M') size<<=20;
+		cache_init(&cache[numlevels],size,ways,linesize);
+		++numlevels;
+	}
+}
+
+static void caches_reset(void)
+{
+	unsigned int l;
+	for(l=0;l<numlevels;++l)
+	{
+		Tcache *c=&cache[l];
+		unsigned long i;
+		for(i=0;i<c->numsets*c->ways;++i)
+		{
+			c->tag[i]=0;
+			c->stamp[i]=0;
+			c->dirty[i]=0;
+		}
+		c->clock=c->hits=c->misses=c->writebacks=0;
+	}
+}
+
+static void caches_resetcounters(void)
+{
+	unsigned int l;
+	for(l=0;l<numlevels;++l) cache[l].hits=cache[l].misses=cache[l].writebacks=0;
+}
+
+/* load/store (fill) or writeback (no fill: whole dirty line from the level above) of addr */
+static void cache_access(unsigned int level, uintptr_t addr, int write, int fill)
+{
+	if(level>=numlevels) return;	/* memory */
+	Tcache *c=&cache[level];
+	unsigned long line=addr/c->linesize;
+	unsigned long set=line%c->numsets;
+	unsigned long *tag=c->tag+set*c->ways, *stamp=c->stamp+set*c->ways;
+	unsigned char *dirty=c->dirty+set*c->ways;
+	unsigned int w, victim=0;
+	for(w=0;w<c->ways;++w)
+	{
+		if(tag[w]==line+1)
+		{
+			if(fill) ++c->hits;
+			stamp[w]=++c->clock;
+			if(write) dirty[w]=1;
+			return;
+		}
+		if(stamp[w]<stamp[victim]) victim=w;	/* invalid ways have stamp 0 */
+	}
+	if(fill)
+	{
+		++c->misses;
+		cache_access(level+1,addr,0,1);
+	}
+	if(tag[victim] && dirty[victim])
+	{
+		++c->writebacks;
+		cache_access(level+1,(uintptr_t)(tag[victim]-1)*c->linesize,1,0);
+	}
+	tag[victim]=line+1;
+	stamp[victim]=++c->clock;
+	dirty[victim]=(unsigned char)write;
+}
+
+static inline void stream_access(Tstream *s, uintptr_t addr, int write)
+{
+	unsigned long line=addr/cache[0].linesize;
+	if(line==s->lastline && (!write || s->lastwrite))
+	{	/* same line as the previous access of this array: L1 hit */
+		++cache[0].hits;
+		return;
+	}
+	cache_access(0,addr,write,1);
+	s->lastline=line;
+	s->lastwrite=write;
+}
+
+
+/* kernels ======================================================================================*/
+static unsigned int numinputs(Tstreamop op)
+{
+	switch(op)
+	{
+		case COPY:	return 1;
+		case ADD:
+		case sTRIAD:	return 2;
+		default:	return 3;
+	}
+}
+
+/* one sweep of the address streams, base[0]=a, base[1..]=b,c,d, element size (array: sizeof(Tfloat)) */
+static void replay(Tstreamop op, Tindex N, Tindex stride, int list, unsigned long elementsize, const uintptr_t *base)
+{
+	const unsigned int inputs=numinputs(op);
+	const unsigned long dataoffset=list?sizeof(Tlistnode*):0;
+	Tstream s[4];
+	unsigned int k;
+	Tindex i;
+	for(k=0;k<4;++k)
+	{
+		s[k].lastline=~0UL;
+		s[k].lastwrite=0;
+	}
+	for(i=0;i<N;i+=stride)
+	{
+		const uintptr_t offset=i*elementsize;
+		for(k=1;k<=inputs;++k) stream_access(&s[k],base[k]+offset+dataoffset,0);
+		stream_access(&s[0],base[0]+offset+dataoffset,1);
+		if(list)
+			for(k=0;k<=inputs;++k) stream_access(&s[k],base[k]+offset,0);	/* p=p->next */
+	}
+}
+
+/* best of NUMSAMPLES [s] for one sweep */
+static double measure(const Tstreamkernel *kernel, Tstreamop op, Tindex N, Tindex stride, Tfloat **arrays, Tlistnode **lists)
+{
+	double best=NAN;
+	unsigned long nrepeat=1, j;
+	int sample;
+	for(sample=0;sample<NUMSAMPLES;)
+	{
+		Ttscticks t0=tsctimer_start();
+		for(j=0;j<nrepeat;++j)
+		{
+			if(kernel)
+				kernel->func(N,stride,arrays[0],arrays[1],arrays[2],arrays[3],1.0001);
+			else
+			{	/* streamlist.c */
+				Tlistnode *pa=lists[0], *pb=lists[1], *pc=lists[2], *pd=lists[3];
+				switch(op)
+				{
+					case COPY:
+						for(;pa;pa=pa->next,pb=pb->next) pa->data=pb->data;
+						break;
+					case ADD:
+						for(;pa;pa=pa->next,pb=pb->next,pc=pc->next)
+							pa->data=pb->data+pc->data;
+						break;
+					case sTRIAD:
+						for(;pa;pa=pa->next,pb=pb->next,pc=pc->next)
+							pa->data=1.0001*pb->data+pc->data;
+						break;
+					default:
+						for(;pa;pa=pa->next,pb=pb->next,pc=pc->next,pd=pd->next)
+							pa->data=pb->data*pc->data+pd->data;
+				}
+			}
+		}
+		Ttscticks t1=tsctimer_stop();
+		double time_diff=tsctimer_seconds(&timer,t0,t1);
+		if(time_diff<MINSAMPLETIME)
+		{
+			nrepeat=tsctimer_repetitions(nrepeat,time_diff,MINSAMPLETIME);
+			continue;
+		}
+		if(sample==0 || time_diff/nrepeat<best) best=time_diff/nrepeat;
+		++sample;
+	}
+	return best;
+}
+
+static Tlistnode* initlist(Tindex N, Tindex stride, unsigned long nodesize)
+{	/* streamlist.c initvec(), every stride-th node linked */
+	char *l=(char*)malloc(N*nodesize);
+	Tindex i;
+	if(!l) return NULL;
+	for(i=0;i<N;i+=stride)
+	{
+		Tlistnode *node=(Tlistnode*)(l+i*nodesize);
+		node->next=(i+stride<N)?(Tlistnode*)(l+(i+stride)*nodesize):NULL;
+		node->data=(Tfloat)i;
+	}
+	return (Tlistnode*)l;
+}
+
+
+int main(int argc, char *argv[])
+{
+	Tstreamop op=vTRIAD;
+	Tindex stride=1, Nlist[MAXPOINTS];
+	unsigned int numpoints=0, l, k, p;
+	int list=0, measured;
+	unsigned long elementsize=sizeof(Tfloat);
+	const char *env=getenv("CACHESIM_MEASURE");
+	measured=!(env && env[0]=='0');
+
+	if(argc>1)
+	{
+		for(k=0;k<4 && strcasecmp(argv[1],streamopname[k]);++k);
+		if(k==4)
+		{
+			printf("ERROR unknown kernel %s (copy|add|striad|vtriad)\n",argv[1]);
+			exit(1);
+		}
+		op=(Tstreamop)k;
+	}
+	if(argc>2) stride=labs(atol(argv[2]));
+	if(stride<1) stride=1;
+	if(argc>3)
+	{
+		if(!strncmp(argv[3],"list",4))
+		{	/* listnode {next,data,extra[LIST_NEXTRA]} */
+			list=1;
+			elementsize=sizeof(Tlistnode)+labs(atol(argv[3]+4));
+			elementsize=(elementsize+sizeof(Tlistnode*)-1)/sizeof(Tlistnode*)*sizeof(Tlistnode*);
+		}
+		else if(strcmp(argv[3],"array"))
+		{
+			printf("ERROR unknown layout %s (array|list[<extra Bytes>])\n",argv[3]);
+			exit(1);
+		}
+	}
+	if(argc>4 && strcmp(argv[4],"sysfs"))
+		caches_parse(argv[4]);
+	else
+		caches_sysfs();
+	if(numlevels==0)
+	{
+		printf("ERROR no cache sizes in /sys/devices/system/cpu/cpu0/cache, give them as size:ways,...\n");
+		exit(1);
+	}
+	const unsigned int numarrays=numinputs(op)+1;
+	for(k=5;(int)k<argc && numpoints<MAXPOINTS;++k) Nlist[numpoints++]=labs(atol(argv[k]));
+	if(numpoints==0)
+	{	/* working set 1/4 L1 .. 4x last level, factor 2 */
+		unsigned long maxbytes=4*cache[numlevels-1].size;
+		if(maxbytes>MAXWORKINGSET) maxbytes=MAXWORKINGSET;
+		Tindex N=cache[0].size/4/numarrays/elementsize;
+		for(;N*elementsize*numarrays<=maxbytes && numpoints<MAXPOINTS;N*=2) Nlist[numpoints++]=N;
+	}
+
+	const Tstreamkernel *kernel=NULL;
+	if(!list)
+	{
+		const char *name=(stride>1)?"vtriad_strided":"vtriad_scalar";
+		if(stride==1 && op==COPY) name="copy_scalar";
+		if(stride==1 && op==ADD) name="add_scalar";
+		if(stride==1 && op==sTRIAD) name="striad_scalar";
+		for(k=0;k<numstreamkernels && strcmp(streamkernels[k].name,name);++k);
+		if(k<numstreamkernels && (stride==1 || op==vTRIAD)) kernel=&streamkernels[k];
+		else measured=0;
+	}
+
+	printf("# cachesim: %s stride %lu %s (%lu Bytes per element), %u arrays, LRU write-back write-allocate\n"
+	      ,streamopname[op],stride,list?"list":"array",elementsize,numarrays);
+	for(l=0;l<numlevels;++l)
+		printf("# L%u: %lu Bytes, %u ways, %lu sets, %u Bytes per line\n"
+		      ,l+1,cache[l].size,cache[l].ways,cache[l].numsets,cache[l].linesize);
+	if(!measured) printf("# no measurement (%s)\n",list||kernel?"CACHESIM_MEASURE=0":"no strided kernel in stream_kernels.h");
+
+	Tpoint points[MAXPOINTS];
+	tsctimer_init(&timer);
+	for(p=0;p<numpoints;++p)
+	{
+		Tpoint *pt=&points[p];
+		Tindex N=Nlist[p];
+		Tfloat *arrays[4]={NULL,NULL,NULL,NULL};
+		Tlistnode *lists[4]={NULL,NULL,NULL,NULL};
+		uintptr_t base[4]={0,0,0,0};
+		pt->N=N;
+		pt->Neff=(N+stride-1)/stride;
+		for(k=0;k<numarrays;++k)
+		{
+			if(list)
+			{
+				lists[k]=initlist(N,stride,elementsize);
+				base[k]=(uintptr_t)lists[k];
+			}
+			else if((arrays[k]=(Tfloat*)malloc(N*sizeof(Tfloat))))
+			{
+				Tindex i;
+				for(i=0;i<N;++i) arrays[k][i]=(Tfloat)i;
+				base[k]=(uintptr_t)arrays[k];
+			}
+			if(!base[k])
+			{
+				printf("ERROR allocating %lu Bytes\n",N*elementsize);
+				exit(1);
+			}
+		}
+
+		Ttscticks t0=tsctimer_start();
+		caches_reset();
+		replay(op,N,stride,list,elementsize,base);	/* warm-up */
+		caches_resetcounters();
+		for(k=0;k<SIMSWEEPS;++k) replay(op,N,stride,list,elementsize,base);
+		pt->simtime=tsctimer_seconds(&timer,t0,tsctimer_stop());
+
+		double accesses=(double)pt->Neff*(list?2*numarrays:numarrays);
+		pt->level=0;
+		for(l=0;l<numlevels;++l)
+		{
+			const Tcache *c=&cache[l];
+			pt->bytes[l]=(double)(c->misses+c->writebacks)/SIMSWEEPS*c->linesize/pt->Neff;
+			pt->hitrate[l]=(c->hits+c->misses)?(double)c->hits/(c->hits+c->misses):NAN;
+			if(cache[0].misses>=accesses*SIMSWEEPS/8. && 2*c->misses>=cache[0].misses) pt->level=l+1;
+		}
+		pt->time=pt->bandwidth=pt->levelbandwidth=NAN;
+		if(measured)
+		{
+			pt->time=measure(kernel,op,N,stride,arrays,lists);
+			pt->bandwidth=(double)pt->Neff*sizeof(Tfloat)*numarrays/pt->time;
+			if(pt->level>0) pt->levelbandwidth=pt->bytes[pt->level-1]*pt->Neff/pt->time;
+			else pt->levelbandwidth=accesses*sizeof(Tfloat)/pt->time;
+		}
+		for(k=0;k<numarrays;++k)
+		{
+			free(arrays[k]);
+			free(lists[k]);
+		}
+	}
+
+	/* median effective bandwidth per serving level */
+	double median[MAXLEVELS+1];
+	for(l=0;l<=numlevels;++l)
+	{
+		double values[MAXPOINTS];
+		unsigned int n=0, i, j;
+		for(p=0;p<numpoints;++p)
+			if(points[p].level==(int)l && points[p].levelbandwidth==points[p].levelbandwidth)
+				values[n++]=points[p].levelbandwidth;
+		for(i=1;i<n;++i)
+			for(j=i;j>0 && values[j-1]>values[j];--j)
+			{
+				double v=values[j];
+				values[j]=values[j-1];
+				values[j-1]=v;
+			}
+		median[l]=n?(values[(n-1)/2]+values[n/2])/2.:NAN;
+	}
+
+	printf("# N\tNeff\tworkingset[Bytes]");
+	for(l=0;l<numlevels;++l) printf("\tL%u hitrate\tL%u<->%s[Bytes/element]",l+1,l+1,(l+1<numlevels)?"next":"memory");
+	printf("\tlevel\tsim[s]\t\ttime[s]\tbandwidth[Bytes/s]\tlevel bandwidth[Bytes/s]\tratio to median\tflag\n");
+	for(p=0;p<numpoints;++p)
+	{
+		const Tpoint *pt=&points[p];
+		double ratio=pt->levelbandwidth/median[pt->level];
+		const char *flag="";
+		if(ratio>FLAGFACTOR) flag="FASTER";
+		if(ratio<1./FLAGFACTOR) flag="SLOWER";
+		printf("%lu\t%lu\t%lu",pt->N,pt->Neff,pt->N*elementsize*numarrays);
+		for(l=0;l<numlevels;++l) printf("\t%.4f\t%.3f",pt->hitrate[l],pt->bytes[l]);
+		if(pt->level<(int)numlevels)
+			printf("\tL%d",pt->level+1);
+		else
+			printf("\tmemory");
+		printf("\t%g\t\t%g\t%g\t%g\t%.3f\t%s\n",pt->simtime,pt->time,pt->bandwidth,pt->levelbandwidth,ratio,flag);
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+/* ddouble.h
+   double-double arithmetic (unevaluated sum hi+lo of two doubles, ~106 bit mantissa)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static functions), just #include "ddouble.h" (link with -lm)
+	see e.g. T.J. Dekker (1971), D.H. Bailey's QD library, or
+	J.-M. Muller et al. "Handbook of Floating-Point Arithmetic"
+
+	do NOT compile with -ffast-math/-Ofast (or icc -fp-model fast): the error free
+	transformations below rely on strict IEEE rounding and would be optimized away
+*/
+
+#ifndef DDOUBLE_H
+#define DDOUBLE_H
+
+#include<math.h>	/* fma() */
+#include<ctype.h>	/* isdigit(),isspace() */
+
+typedef struct {
+	double hi, lo;
+} Tdd;
+
+
+static inline Tdd dd_from_double(double a)
+{
+	Tdd r={a,0.};
+	return r;
+}
+
+static inline double dd_to_double(Tdd a)
+{
+	return a.hi+a.lo;
+}
+
+static inline Tdd dd_quick_two_sum(double a, double b)
+{	/* |a|>=|b| */
+	Tdd r;
+	r.hi=a+b;
+	r.lo=b-(r.hi-a);
+	return r;
+}
+
+static inline Tdd dd_two_sum(double a, double b)
+{
+	Tdd r;
+	r.hi=a+b;
+	double bb=r.hi-a;
+	r.lo=(a-(r.hi-bb))+(b-bb);
+	return r;
+}
+
+static inline Tdd dd_two_prod(double a, double b)
+{
+	Tdd r;
+	r.hi=a*b;
+	r.lo=fma(a,b,-r.hi);
+	return r;
+}
+
+static inline Tdd dd_add(Tdd a, Tdd b)
+{
+	Tdd s=dd_two_sum(a.hi,b.hi);
+	Tdd t=dd_two_sum(a.lo,b.lo);
+	s.lo+=t.hi;
+	s=dd_quick_two_sum(s.hi,s.lo);
+	s.lo+=t.lo;
+	return dd_quick_two_sum(s.hi,s.lo);
+}
+
+static inline Tdd dd_neg(Tdd a)
+{
+	Tdd r={-a.hi,-a.lo};
+	return r;
+}
+
+static inline Tdd dd_sub(Tdd a, Tdd b)
+{
+	return dd_add(a,dd_neg(b));
+}
+
+static inline Tdd dd_add_d(Tdd a, double b)
+{
+	Tdd s=dd_two_sum(a.hi,b);
+	s.lo+=a.lo;
+	return dd_quick_two_sum(s.hi,s.lo);
+}
+
+static inline Tdd dd_mul(Tdd a, Tdd b)
+{
+	Tdd p=dd_two_prod(a.hi,b.hi);
+	p.lo+=a.hi*b.lo+a.lo*b.hi;
+	return dd_quick_two_sum(p.hi,p.lo);
+}
+
+static inline Tdd dd_mul_d(Tdd a, double b)
+{
+	Tdd p=dd_two_prod(a.hi,b);
+	p.lo+=a.lo*b;
+	return dd_quick_two_sum(p.hi,p.lo);
+}
+
+static inline Tdd dd_sqr(Tdd a)
+{
+	Tdd p=dd_two_prod(a.hi,a.hi);
+	p.lo+=2.*a.hi*a.lo;
+	return dd_quick_two_sum(p.hi,p.lo);
+}
+
+static inline Tdd dd_div_d(Tdd a, double b)
+{
+	double q1=a.hi/b;
+	Tdd p=dd_two_prod(q1,b);
+	double q2=(a.hi-p.hi-p.lo+a.lo)/b;
+	return dd_quick_two_sum(q1,q2);
+}
+
+/* parse a decimal number like "-0.74364388703715870475219150611477" or "1.5e-3"
+   (all digits count, unlike strtod()), returns the number of characters used */
+static inline int dd_from_string(const char *s, Tdd *a)
+{
+	const char *p=s;
+	int sign=1, exponent=0;
+	Tdd r=dd_from_double(0.);
+	while(isspace((unsigned char)*p)) ++p;
+	if(*p=='-' || *p=='+') { if(*p=='-') sign=-1; ++p; }
+	for(;isdigit((unsigned char)*p);++p) r=dd_add_d(dd_mul_d(r,10.),*p-'0');
+	if(*p=='.')
+	{
+		for(++p;isdigit((unsigned char)*p);++p)
+		{
+			r=dd_add_d(dd_mul_d(r,10.),*p-'0');
+			--exponent;
+		}
+	}
+	if(*p=='e' || *p=='E')
+	{
+		int esign=1, e=0;
+		++p;
+		if(*p=='-' || *p=='+') { if(*p=='-') esign=-1; ++p; }
+		for(;isdigit((unsigned char)*p);++p) e=10*e+(*p-'0');
+		exponent+=esign*e;
+	}
+	for(;exponent>0;--exponent) r=dd_mul_d(r,10.);
+	for(;exponent<0;++exponent) r=dd_div_d(r,10.);
+	*a=(sign<0)?dd_neg(r):r;
+	return (int)(p-s);
+}
+
+#endif /* DDOUBLE_H */
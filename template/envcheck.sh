@@ -0,0 +1,140 @@
+#!/bin/bash
+# envcheck.sh
+# benchmark environment fingerprint and noise check, e.g.
+#  ./envcheck.sh -c 0x1 -b ./stream_ref
+# prints "# env <key>: <value>" lines (to embed in the .dat files) and "# WARNING ..." lines
+# exit status: 0 ok, 1 warnings, 2 refuse (conditions known to spoil measurements:
+#  powersave governor, target cores busy); run.sh stops then, unless ENVCHECK_FORCE=1
+#
+#  -c <cpumask>	target cores (taskset mask, hex), default: all online cpus
+#  -b <binary>	compiler and flags from its .comment and DWARF producer (gcc -g records the flags)
+#
+# M. Bernreuther <bernreuther@hlrs.de>
+
+BUSYTHRESHOLD=10	# [%] utilization of a target core by others, to refuse
+BUSYSAMPLETIME=0.5	# [s]
+LOADTHRESHOLD=50	# [%] load average (1 min) per online cpu, to warn
+
+cpumask=''
+b=''
+while getopts "c:b:" opt; do
+	case "$opt" in
+		c) cpumask="$OPTARG" ;;
+		b) b="$OPTARG" ;;
+		*) echo "usage: $0 [-c <cpumask>] [-b <binary>]"; exit 2 ;;
+	esac
+done
+
+sysfscpu=/sys/devices/system/cpu
+status=0
+warn() {
+	echo "# WARNING $*"
+	[ ${status} -lt 1 ] && status=1
+}
+refuse() {
+	echo "# ERROR $*"
+	status=2
+}
+entry() {
+	echo "# env $1: $2"
+}
+readfile() {	# content of $1 or n/a
+	if [ -r "$1" ]; then cat "$1" 2>/dev/null; else echo "n/a"; fi
+}
+
+# target cpus
+online="$(readfile ${sysfscpu}/online)"
+cpus=""
+if [ -n "${cpumask}" ]; then
+	mask=$(( ${cpumask} ))
+	c=0
+	while [ ${mask} -gt 0 ]; do
+		[ $(( mask & 1 )) -eq 1 ] && cpus="${cpus} $c"
+		mask=$(( mask >> 1 ))
+		c=$(( c+1 ))
+	done
+else
+	for r in ${online//,/ }; do
+		cpus="${cpus} `seq -s ' ' ${r%-*} ${r#*-}`"
+	done
+fi
+cpus="${cpus# }"
+entry "target cpus" "${cpus} (online ${online})"
+
+entry "kernel" "`uname -r`"
+entry "cmdline" "`readfile /proc/cmdline`"
+
+# frequency scaling
+governors=""
+for c in ${cpus}; do
+	g="$(readfile ${sysfscpu}/cpu$c/cpufreq/scaling_governor)"
+	governors="${governors} $g"
+	case "$g" in
+		performance|n/a) ;;
+		powersave) refuse "cpu$c: powersave governor (frequency scales with the load, use performance)" ;;
+		*) warn "cpu$c: $g governor (use performance)" ;;
+	esac
+done
+entry "governor" "${governors# }"
+entry "scaling driver" "`readfile ${sysfscpu}/cpu${cpus%% *}/cpufreq/scaling_driver`"
+if [ -r ${sysfscpu}/intel_pstate/no_turbo ]; then
+	turbo=$(( 1-`cat ${sysfscpu}/intel_pstate/no_turbo` ))
+else
+	turbo="$(readfile ${sysfscpu}/cpufreq/boost)"
+fi
+entry "turbo" "${turbo}"
+[ "${turbo}" = "1" ] && warn "turbo enabled (frequency depends on temperature and active cores)"
+
+# memory
+entry "THP" "`readfile /sys/kernel/mm/transparent_hugepage/enabled | sed -e 's/.*\[\(.*\)\].*/\1/'`"
+nodes=""
+for n in /sys/devices/system/node/node[0-9]*; do
+	[ -d "$n" ] && nodes="${nodes} ${n##*/}:`cat $n/cpulist`"
+done
+nodes="${nodes# }"
+entry "NUMA" "${nodes:-n/a}"
+
+# SMT and isolation
+smt="$(readfile ${sysfscpu}/smt/active)"
+entry "SMT" "${smt} (control `readfile ${sysfscpu}/smt/control`)"
+siblings=""
+for c in ${cpus}; do
+	s="$(readfile ${sysfscpu}/cpu$c/topology/thread_siblings_list)"
+	[ "$s" != "n/a" ] && [ "$s" != "$c" ] && siblings="${siblings} cpu$c:$s"
+done
+[ -n "${siblings}" ] && warn "SMT siblings share the target cores:${siblings}"
+isolated="$(readfile ${sysfscpu}/isolated)"
+entry "isolcpus" "${isolated:-none}"
+entry "nohz_full" "`readfile ${sysfscpu}/nohz_full`"
+
+# compiler
+if [ -n "$b" ] && [ -r "$b" ]; then
+	comp="$(readelf -p .comment "$b" 2>/dev/null | sed -n -e 's/^\s*\[\s*[0-9a-f]*\]\s*//p' | sort -u | tr '\n' ';')"
+	entry "compiler" "${comp%;}"
+	flags="$(readelf --debug-dump=info "$b" 2>/dev/null | grep -m 1 'DW_AT_producer' | sed -e 's/.*:\s*//')"
+	entry "compiler flags" "${flags:-n/a (no -g)}"
+fi
+
+# load
+entry "loadavg" "`readfile /proc/loadavg`"
+ncpus=`getconf _NPROCESSORS_ONLN`
+load=`awk '{print $1}' /proc/loadavg`
+if awk -v l=${load} -v n=${ncpus} -v t=${LOADTHRESHOLD} 'BEGIN {exit !(100*l>t*n)}'; then
+	warn "load average ${load} on ${ncpus} cpus"
+fi
+
+# utilization of the target cores (by others) while idle here
+stat0="$(grep '^cpu[0-9]' /proc/stat)"
+sleep ${BUSYSAMPLETIME}
+stat1="$(grep '^cpu[0-9]' /proc/stat)"
+for c in ${cpus}; do
+	busy=`( echo "${stat0}"; echo "${stat1}" ) | awk -v cpu="cpu$c" '$1==cpu {
+		total=0; for(i=2;i<=NF;++i) total+=$i; idle=$5+$6;
+		if(n++) { dt=total-t0; printf("%d",dt>0?100*(dt-(idle-i0))/dt:0); } else { t0=total; i0=idle; } }'`
+	if [ -n "${busy}" ] && [ ${busy} -gt ${BUSYTHRESHOLD} ]; then
+		procs="$(ps -eo psr=,pcpu=,comm= | awk -v c=$c '$1==c && $2>1.0 {printf(" %s(%s%%)",$3,$2)}')"
+		refuse "cpu$c busy ${busy}% (${procs# })"
+	fi
+done
+
+exit ${status}
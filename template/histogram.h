@@ -0,0 +1,162 @@
+/* histogram.h
+   HDR-style (log-linear) histogram of durations and an interval time series
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static inline functions), just #include "histogram.h"
+
+	Thistogram *h=histogram_new();
+	histogram_add(h,ticks);			// e.g. TSC ticks of one repetition
+	Ttscticks p99=histogram_percentile(h,99.);	// upper bound of the bucket
+	free(h);
+
+	Buckets: values < HISTOGRAM_SUB exactly, above HISTOGRAM_SUB/2 sub-buckets per power of two,
+	i.e. relative precision 2/HISTOGRAM_SUB (1.6%) over the whole 64 bit range, constant
+	memory and O(1) add (no allocation in the timed region).
+
+	Ttimeseries ts;
+	timeseries_open(&ts,"ts.dat",tscfrequency,interval,bytes,start);	// NULL filename: off
+	timeseries_add(&ts,now,ticks);	// a line per interval [s]: time count min mean max (bandwidth)
+	timeseries_close(&ts);
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include<stdint.h>	/* uint64_t */
+#include<stdio.h>	/* FILE,fprintf() */
+#include<stdlib.h>	/* calloc() */
+
+#define HISTOGRAM_SUBBITS 7
+#define HISTOGRAM_SUB (1<<HISTOGRAM_SUBBITS)
+#define HISTOGRAM_NUMBUCKETS ((64-HISTOGRAM_SUBBITS+2)*(HISTOGRAM_SUB/2))
+
+typedef struct {
+	uint64_t count[HISTOGRAM_NUMBUCKETS];
+	uint64_t total;
+	uint64_t min, max;
+} Thistogram;
+
+typedef struct {
+	FILE *file;
+	double frequency;	/* ticks per second */
+	double bytes;	/* per sample, 0: no bandwidth column */
+	uint64_t start, intervalticks, intervalstart;
+	uint64_t count, min, max, last;
+	double sum;
+} Ttimeseries;
+
+
+static inline Thistogram* histogram_new(void)
+{
+	Thistogram *h=(Thistogram*)calloc(1,sizeof(Thistogram));
+	if(h) h->min=UINT64_MAX;
+	return h;
+}
+
+static inline void histogram_reset(Thistogram *h)
+{
+	uint64_t i;
+	for(i=0;i<HISTOGRAM_NUMBUCKETS;++i) h->count[i]=0;
+	h->total=h->max=0;
+	h->min=UINT64_MAX;
+}
+
+static inline unsigned int histogram_index(uint64_t v)
+{
+	unsigned int shift;
+	if(v<HISTOGRAM_SUB) return (unsigned int)v;
+	shift=(63-__builtin_clzll(v))-HISTOGRAM_SUBBITS+1;	/* v>>shift in [HISTOGRAM_SUB/2,HISTOGRAM_SUB) */
+	return shift*(HISTOGRAM_SUB/2)+(unsigned int)(v>>shift);
+}
+
+/* largest value of bucket index */
+static inline uint64_t histogram_upper(unsigned int index)
+{
+	unsigned int shift;
+	if(index<HISTOGRAM_SUB) return index;
+	shift=index/(HISTOGRAM_SUB/2)-1;
+	return (((uint64_t)(index-shift*(HISTOGRAM_SUB/2))+1)<<shift)-1;
+}
+
+static inline void histogram_add(Thistogram *h, uint64_t v)
+{
+	++h->count[histogram_index(v)];
+	++h->total;
+	if(v<h->min) h->min=v;
+	if(v>h->max) h->max=v;
+}
+
+/* value at percentile p (0..100), the exact min/max for p=0/100 */
+static inline uint64_t histogram_percentile(const Thistogram *h, double p)
+{
+	uint64_t rank, sum=0;
+	unsigned int i;
+	if(h->total==0) return 0;
+	if(p<=0.) return h->min;
+	if(p>=100.) return h->max;
+	rank=(uint64_t)(p/100.*h->total);
+	if(rank>=h->total) rank=h->total-1;
+	for(i=0;i<HISTOGRAM_NUMBUCKETS;++i)
+	{
+		sum+=h->count[i];
+		if(sum>rank)
+		{
+			uint64_t v=histogram_upper(i);
+			return (v<h->max)?v:h->max;
+		}
+	}
+	return h->max;
+}
+
+
+static inline void timeseries_open(Ttimeseries *ts, const char *filename, double frequency, double interval
+                                  , double bytes, uint64_t start)
+{
+	ts->file=NULL;
+	if(filename && !(ts->file=fopen(filename,"w")))
+		fprintf(stderr,"# timeseries: ERROR opening %s\n",filename);
+	ts->frequency=frequency;
+	ts->bytes=bytes;
+	ts->start=ts->intervalstart=start;
+	ts->intervalticks=(uint64_t)(interval*frequency);
+	ts->count=0;
+	ts->last=start;
+	ts->sum=0.;
+	if(ts->file)
+		fprintf(ts->file,"# time[s]\tcount\tmin[s]\tmean[s]\tmax[s]%s\n",bytes>0.?"\tbandwidth(mean)[Bytes/s]":"");
+}
+
+static inline void timeseries_flush(Ttimeseries *ts, uint64_t now)
+{
+	if(!ts->file || ts->count==0) return;
+	double mean=ts->sum/ts->count/ts->frequency;
+	fprintf(ts->file,"%g\t%lu\t%g\t%g\t%g",(double)(now-ts->start)/ts->frequency,(unsigned long)ts->count
+	       ,ts->min/ts->frequency,mean,ts->max/ts->frequency);
+	if(ts->bytes>0.) fprintf(ts->file,"\t%g",ts->bytes/mean);
+	fprintf(ts->file,"\n");
+	ts->count=0;
+	ts->sum=0.;
+	ts->intervalstart=now;
+}
+
+/* sample of ticks ending at now; a line per interval */
+static inline void timeseries_add(Ttimeseries *ts, uint64_t now, uint64_t ticks)
+{
+	if(!ts->file) return;
+	if(ts->count==0 || ticks<ts->min) ts->min=ticks;
+	if(ts->count==0 || ticks>ts->max) ts->max=ticks;
+	++ts->count;
+	ts->sum+=ticks;
+	ts->last=now;
+	if(now-ts->intervalstart>=ts->intervalticks) timeseries_flush(ts,now);
+}
+
+static inline void timeseries_close(Ttimeseries *ts)
+{
+	if(!ts->file) return;
+	timeseries_flush(ts,ts->last);	/* last (partial) interval */
+	fclose(ts->file);
+	ts->file=NULL;
+}
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,157 @@
+/* mandelbrot.h
+   common types, escape-time kernel and PGM output for the Mandelbrot programs
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static functions), just #include "mandelbrot.h"
+	the kernel does the same arithmetic as mandelbrot_seq.c, but computes C directly
+	from the pixel index (CrealMin+column*dCreal) instead of summing up dCreal,
+	such that rows and tiles can be calculated independently and in any order
+*/
+
+#ifndef MANDELBROT_H
+#define MANDELBROT_H
+
+#include<stdlib.h>	/* malloc(),free(),exit() */
+#include<stdio.h>	/* printf(),fopen(),snprintf() */
+#include<time.h>	/* clock_gettime() */
+
+typedef unsigned long Tindex;
+typedef double Tfloat;
+typedef unsigned int Titer;
+
+typedef struct {
+	Tindex numcolumns, numrows;
+	Tfloat CrealMin, CimgMin, CrealMax, CimgMax;
+	Titer maxiter;	/* <= 65535 */
+	Tfloat Zabs2bound;
+} Tview;
+
+
+static inline Tindex colrow2index(Tindex column, Tindex row, Tindex numcolumns)
+{
+	return row*numcolumns+column;
+}
+
+static inline double gettime(void)
+{	/* wall clock time [s] */
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec+(double)t.tv_nsec/1.E9;
+}
+
+static inline void view_init(Tview *v, Tindex numcolumns, Tindex numrows, Titer maxiter
+                            ,Tfloat CrealMin, Tfloat CimgMin, Tfloat CrealMax, Tfloat CimgMax)
+{
+	Tfloat Zabsbound=2.;
+	v->numcolumns=numcolumns; v->numrows=numrows;
+	v->CrealMin=CrealMin; v->CimgMin=CimgMin;
+	v->CrealMax=CrealMax; v->CimgMax=CimgMax;
+	v->maxiter=maxiter;
+	v->Zabs2bound=Zabsbound*Zabsbound;
+}
+
+static inline Tfloat view_dCreal(const Tview *v)
+{
+	return (v->numcolumns>1)?(v->CrealMax-v->CrealMin)/(v->numcolumns-1):0.;
+}
+
+static inline Tfloat view_dCimg(const Tview *v)
+{
+	return (v->numrows>1)?(v->CimgMin-v->CimgMax)/(v->numrows-1):0.;
+}
+
+
+static inline Titer mandelbrot_point(Tfloat Creal, Tfloat Cimg, Titer maxiter, Tfloat Zabs2bound)
+{
+	Tfloat Zreal=0., Zimg=0., Zreal_tmp, Zabs2;
+	Titer i;
+	for(i=0;i<maxiter;++i)
+	{	/* 10 FlOp per iteration */
+		Zreal_tmp=Zreal*Zreal-Zimg*Zimg+Creal;	/* 4 FlOp */
+		Zimg=2.*Zreal*Zimg+Cimg;	/* 3 FlOp */
+		Zreal=Zreal_tmp;
+		Zabs2=Zreal*Zreal+Zimg*Zimg;	/* 3 FlOp */
+		if(Zabs2>Zabs2bound) break;
+	}
+	return i;
+}
+
+/* calculate the block column0<=column<column1, row0<=row<row1 of view v
+   and store it with row stride ld starting at M
+   returns the number of iterations (10 FlOp each) */
+static inline unsigned long mandelbrot_block(const Tview *v, Titer *M, Tindex ld
+                                            ,Tindex column0, Tindex column1, Tindex row0, Tindex row1)
+{
+	Tfloat dCreal=view_dCreal(v), dCimg=view_dCimg(v);
+	unsigned long sumiter=0;
+	Tindex column, row;
+	for(row=row0;row<row1;++row)
+	{
+		Tfloat Cimg=v->CimgMax+row*dCimg;
+		Titer* Mact=M+(row-row0)*ld;
+		for(column=column0;column<column1;++column)
+		{
+			Titer i=mandelbrot_point(v->CrealMin+column*dCreal,Cimg,v->maxiter,v->Zabs2bound);
+			*(Mact++)=i;
+			sumiter+=i;
+		}
+	}
+	return sumiter;
+}
+
+static inline unsigned long mandelbrot_rows(const Tview *v, Titer *M, Tindex row0, Tindex row1)
+{	/* M points to the whole image */
+	return mandelbrot_block(v,M+colrow2index(0,row0,v->numcolumns),v->numcolumns
+	                       ,0,v->numcolumns,row0,row1);
+}
+
+
+static inline size_t sizePGM5(Titer maxval, Tindex width, Tindex height)
+{	/* upper bound of the binary PGM size (header <=128 Bytes) */
+	return 128+width*height*(maxval<256?1:2);
+}
+
+/* encode binary PGM (P5) to buf (at least sizePGM5() Bytes), returns the actual size */
+static inline size_t encodePGM5(const Titer *M, Titer maxval, Tindex width, Tindex height, const char *comment
+                                      ,unsigned char *buf)
+{	/* see e.g. http://netpbm.sourceforge.net/doc/pgm.html */
+	int n=snprintf((char*)buf,128,"P5\n# %.64s\twritten by mandelbrot\n%lu %lu\n%u\n"
+	              ,comment?comment:"",width,height,maxval);
+	unsigned char *b=buf+n;
+	Tindex i, numelements=width*height;
+	if(maxval<256)
+	{
+		for(i=0;i<numelements;++i) *(b++)=(unsigned char)M[i];
+	}
+	else
+	{	/* 2 Bytes, most significant Byte first */
+		for(i=0;i<numelements;++i)
+		{
+			*(b++)=(unsigned char)(M[i]>>8);
+			*(b++)=(unsigned char)(M[i]&0xff);
+		}
+	}
+	return b-buf;
+}
+
+static inline void writePGM(Titer *M, Titer maxval, Tindex width, Tindex height, const char * filename)
+{	/* write binary PGM (P5) */
+	FILE *fhdl = fopen(filename, "wb");
+	if (!fhdl)
+	{
+		printf("ERROR opening file %s\n",filename);
+		exit(2);
+	}
+	unsigned char *buf=(unsigned char*)malloc(sizePGM5(maxval,width,height));
+	if(!buf)
+	{
+		printf("ERROR allocating memory for %s\n",filename);
+		exit(1);
+	}
+	size_t n=encodePGM5(M,maxval,width,height,filename,buf);
+	fwrite(buf,1,n,fhdl);
+	free(buf);
+	fclose(fhdl);
+}
+
+#endif /* MANDELBROT_H */
@@ -0,0 +1,371 @@
+/* mandelbrot_anim.c
+   calculate Mandelbrot animation frames along a keyframe path (pipelined batch renderer)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -Wall -g -pthread mandelbrot_anim.c -o mandelbrot_anim -lm
+	gcc -march=native -O3 -pthread mandelbrot_anim.c -o mandelbrot_anim -lm
+
+	mandelbrot_anim <width> <height> <keyframefile> [<outpattern>] [<numthreads>] [<framesperkey>] [<queuedepth>]
+
+	e.g.
+	$ ./mandelbrot_anim 640 480 path.txt frame%05lu.pgm 8 25
+	$ ffmpeg -i frame%05d.pgm -vf format=yuv420p mandelbrot.mp4
+
+	keyframe file: one keyframe per line (# starts a comment)
+		<Creal center> <Cimg center> <zoom> <maxiter>
+	zoom 1 is the view -2..2 (imaginary part, real part scaled by the aspect ratio).
+	With <framesperkey> >1 the frames between two keyframes are interpolated
+	(center linear, zoom geometric, maxiter linear), otherwise each keyframe is a frame.
+
+	The frames are processed in a three stage pipeline:
+	  compute (<numthreads> workers, blocks of rows)  ->  encode (binary PGM)  ->  write
+	connected by bounded queues of depth <queuedepth>. Only 2*<queuedepth>+2 frame buffers
+	exist, i.e. frame k+1 is calculated while frame k is encoded and frame k-1 is written.
+*/
+
+#include<stdlib.h>	/* malloc(),free(),labs(),atol(),atof() */
+#include<stdio.h>	/* printf(),fopen(),fgets() */
+#include<math.h>	/* pow() */
+#include<unistd.h>	/* sysconf() */
+#include<pthread.h>
+
+#include "mandelbrot.h"
+#include "queue.h"
+
+#define DEFAULT_QUEUEDEPTH 2
+#define ROWSPERBLOCK 4
+
+
+typedef struct {
+	double Creal, Cimg, zoom;
+	Titer maxiter;
+} Tkeyframe;
+
+typedef struct {
+	Tindex k;	/* frame number */
+	Tview view;
+	Titer *M;
+	unsigned char *buf;	/* encoded PGM */
+	size_t size;
+	Tindex rowsdone;
+	unsigned long sumiter;
+} Tframe;
+
+typedef struct {
+	Tindex numcolumns, numrows;
+	Tkeyframe *frames;
+	Tindex numframes;
+	const char *outpattern;
+
+	/* compute stage: workers claim blocks of rows of the current frame */
+	pthread_mutex_t mtx;
+	Tframe *cur;
+	Tindex currow;
+	Tindex nextframe;
+
+	Tqueue freeframes, encodeq, writeq;
+
+	/* statistics */
+	unsigned long sumiter;
+	double time_compute, time_encode, time_write;	/* accumulated busy times */
+} Tpipeline;
+
+typedef struct {
+	Tpipeline *p;
+	double time_busy;
+} Tworker;
+
+
+Tkeyframe* readkeyframes(const char *filename, Tindex framesperkey, Tindex *numframes)
+{	/* read keyframes and interpolate framesperkey-1 frames in between */
+	FILE *fhdl=fopen(filename,"r");
+	if(!fhdl)
+	{
+		printf("ERROR opening file %s\n",filename);
+		exit(2);
+	}
+	Tindex numkeys=0, maxkeys=16;
+	Tkeyframe *keys=(Tkeyframe*)malloc(maxkeys*sizeof(Tkeyframe));
+	char line[256];
+	while(keys && fgets(line,sizeof(line),fhdl))
+	{
+		Tkeyframe kf;
+		long maxiter;
+		if(line[0]=='#') continue;
+		if(sscanf(line,"%lf %lf %lf %ld",&kf.Creal,&kf.Cimg,&kf.zoom,&maxiter)!=4) continue;
+		kf.maxiter=(Titer)labs(maxiter);
+		if(kf.zoom<=0.) kf.zoom=1.;
+		if(numkeys==maxkeys)
+		{
+			maxkeys*=2;
+			keys=(Tkeyframe*)realloc(keys,maxkeys*sizeof(Tkeyframe));
+			if(!keys) break;
+		}
+		keys[numkeys++]=kf;
+	}
+	fclose(fhdl);
+	if(!keys)
+	{
+		printf("ERROR allocating memory for keyframes\n");
+		exit(1);
+	}
+	if(numkeys==0)
+	{
+		printf("ERROR no keyframes in %s\n",filename);
+		exit(2);
+	}
+	if(framesperkey<1) framesperkey=1;
+
+	*numframes=(numkeys-1)*framesperkey+1;
+	Tkeyframe *frames=(Tkeyframe*)malloc(*numframes*sizeof(Tkeyframe));
+	if(!frames)
+	{
+		printf("ERROR allocating memory for %lu frames\n",*numframes);
+		exit(1);
+	}
+	Tindex k,j;
+	for(k=0;k+1<numkeys;++k)
+	{
+		for(j=0;j<framesperkey;++j)
+		{
+			double t=(double)j/framesperkey;
+			Tkeyframe *f=&frames[k*framesperkey+j];
+			f->Creal=(1.-t)*keys[k].Creal+t*keys[k+1].Creal;
+			f->Cimg=(1.-t)*keys[k].Cimg+t*keys[k+1].Cimg;
+			f->zoom=keys[k].zoom*pow(keys[k+1].zoom/keys[k].zoom,t);
+			f->maxiter=(Titer)((1.-t)*keys[k].maxiter+t*keys[k+1].maxiter+.5);
+		}
+	}
+	frames[*numframes-1]=keys[numkeys-1];
+	free(keys);
+	return frames;
+}
+
+void frame_setview(Tframe *f, const Tkeyframe *kf, Tindex numcolumns, Tindex numrows)
+{
+	double halfheight=2./kf->zoom;
+	double halfwidth=halfheight*numcolumns/numrows;
+	view_init(&f->view,numcolumns,numrows,kf->maxiter
+	         ,kf->Creal-halfwidth,kf->Cimg-halfheight,kf->Creal+halfwidth,kf->Cimg+halfheight);
+}
+
+
+int claimrows(Tpipeline *p, Tframe **f, Tindex *row0, Tindex *row1)
+{	/* get the next block of rows to calculate, returns 0 if all frames are done */
+	int claimed=0;
+	pthread_mutex_lock(&p->mtx);
+	while(!claimed)
+	{
+		if(p->cur && p->currow<p->numrows)
+		{
+			*f=p->cur;
+			*row0=p->currow;
+			p->currow+=ROWSPERBLOCK;
+			if(p->currow>p->numrows) p->currow=p->numrows;
+			*row1=p->currow;
+			claimed=1;
+		}
+		else if(p->nextframe<p->numframes)
+		{	/* start next frame (blocks until a frame buffer is available) */
+			Tframe *fnew=(Tframe*)queue_pop(&p->freeframes);
+			fnew->k=p->nextframe;
+			frame_setview(fnew,&p->frames[fnew->k],p->numcolumns,p->numrows);
+			fnew->rowsdone=0;
+			fnew->sumiter=0;
+			p->cur=fnew;
+			p->currow=0;
+			++p->nextframe;
+		}
+		else
+			break;
+	}
+	pthread_mutex_unlock(&p->mtx);
+	return claimed;
+}
+
+void* compute_worker(void *arg)
+{
+	Tworker *w=(Tworker*)arg;
+	Tpipeline *p=w->p;
+	Tframe *f;
+	Tindex row0, row1;
+	while(claimrows(p,&f,&row0,&row1))
+	{
+		double t0=gettime();
+		unsigned long sumiter=mandelbrot_rows(&f->view,f->M,row0,row1);
+		w->time_busy+=gettime()-t0;
+		/* atomic, claimrows() might hold p->mtx while waiting for a free frame buffer */
+		__sync_add_and_fetch(&f->sumiter,sumiter);
+		if(__sync_add_and_fetch(&f->rowsdone,row1-row0)==p->numrows)
+			queue_push(&p->encodeq,f);
+	}
+	return NULL;
+}
+
+void* encode_stage(void *arg)
+{
+	Tpipeline *p=(Tpipeline*)arg;
+	Tframe *f;
+	char comment[64];
+	while((f=(Tframe*)queue_pop(&p->encodeq)))
+	{
+		double t0=gettime();
+		snprintf(comment,sizeof(comment),"frame %lu",f->k);
+		f->size=encodePGM5(f->M,f->view.maxiter,p->numcolumns,p->numrows,comment,f->buf);
+		p->time_encode+=gettime()-t0;
+		queue_push(&p->writeq,f);
+	}
+	queue_close(&p->writeq);
+	return NULL;
+}
+
+void* write_stage(void *arg)
+{
+	Tpipeline *p=(Tpipeline*)arg;
+	Tframe *f;
+	char filename[1024];
+	while((f=(Tframe*)queue_pop(&p->writeq)))
+	{
+		double t0=gettime();
+		snprintf(filename,sizeof(filename),p->outpattern,f->k);
+		FILE *fhdl=fopen(filename,"wb");
+		if(!fhdl)
+		{
+			printf("ERROR opening file %s\n",filename);
+			exit(2);
+		}
+		fwrite(f->buf,1,f->size,fhdl);
+		fclose(fhdl);
+		p->sumiter+=f->sumiter;
+		p->time_write+=gettime()-t0;
+		queue_push(&p->freeframes,f);	/* recycle frame buffer */
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	Tindex numcolumns, numrows;
+	const char *keyfilename;
+	char outpattern_default[]="frame%05lu.pgm";
+	const char *outpattern=outpattern_default;
+	long numthreads=sysconf(_SC_NPROCESSORS_ONLN);
+	Tindex framesperkey=1;
+	unsigned int queuedepth=DEFAULT_QUEUEDEPTH;
+
+	if (argc<4)
+	{
+		printf("usage: %s <width> <height> <keyframefile> [<outpattern>] [<numthreads>] [<framesperkey>] [<queuedepth>]\n",argv[0]);
+		printf("\tkeyframe file lines: <Creal center> <Cimg center> <zoom> <maxiter>\n");
+		exit(0);
+	}
+	numcolumns=labs(atol(argv[1]));
+	numrows=labs(atol(argv[2]));
+	keyfilename=argv[3];
+	if (argc>4) outpattern=argv[4];
+	if (argc>5) numthreads=labs(atol(argv[5]));
+	if (argc>6) framesperkey=labs(atol(argv[6]));
+	if (argc>7) queuedepth=labs(atol(argv[7]));
+	if(numcolumns<1) numcolumns=1;
+	if(numrows<1) numrows=1;
+	if(numthreads<1) numthreads=1;
+	if(queuedepth<1) queuedepth=1;
+
+	Tpipeline p;
+	p.numcolumns=numcolumns;
+	p.numrows=numrows;
+	p.frames=readkeyframes(keyfilename,framesperkey,&p.numframes);
+	p.outpattern=outpattern;
+	pthread_mutex_init(&p.mtx,NULL);
+	p.cur=NULL;
+	p.currow=0;
+	p.nextframe=0;
+	p.sumiter=0;
+	p.time_compute=p.time_encode=p.time_write=0.;
+
+	printf("width x height:\t%lu x %lu\n",numcolumns,numrows);
+	printf("frames:\t%lu\n",p.numframes);
+	printf("threads:\t%ld (+ encoder + writer)\n",numthreads);
+	printf("queue depth:\t%u\n",queuedepth);
+
+	/* frame buffers: one being calculated, one being encoded, one being written + queued ones */
+	unsigned int numbuffers=2*queuedepth+2, k;
+	Tframe *framebuffers=(Tframe*)malloc(numbuffers*sizeof(Tframe));
+	if(!framebuffers)
+	{
+		printf("ERROR allocating memory for frames\n");
+		exit(1);
+	}
+	queue_init(&p.freeframes,numbuffers);
+	queue_init(&p.encodeq,queuedepth);
+	queue_init(&p.writeq,queuedepth);
+	unsigned long arraysize=numcolumns*numrows*sizeof(Titer);
+	for(k=0;k<numbuffers;++k)
+	{
+		framebuffers[k].M=(Titer*)malloc(arraysize);
+		framebuffers[k].buf=(unsigned char*)malloc(sizePGM5(65535,numcolumns,numrows));
+		if(!framebuffers[k].M || !framebuffers[k].buf)
+		{
+			printf("ERROR allocating memory (%u frame buffers of %lu Bytes)\n",numbuffers,arraysize);
+			exit(1);
+		}
+		queue_push(&p.freeframes,&framebuffers[k]);
+	}
+
+	Tworker *workers=(Tworker*)malloc(numthreads*sizeof(Tworker));
+	pthread_t *threads=(pthread_t*)malloc(numthreads*sizeof(pthread_t));
+	pthread_t encoder, writer;
+	if(!workers || !threads)
+	{
+		printf("ERROR allocating memory for %ld threads\n",numthreads);
+		exit(1);
+	}
+
+/*------------------------------------------------------------------------------------------------*/
+	double time_start=gettime();
+	pthread_create(&writer,NULL,write_stage,&p);
+	pthread_create(&encoder,NULL,encode_stage,&p);
+	long t;
+	for(t=0;t<numthreads;++t)
+	{
+		workers[t].p=&p;
+		workers[t].time_busy=0.;
+		pthread_create(&threads[t],NULL,compute_worker,&workers[t]);
+	}
+	for(t=0;t<numthreads;++t)
+	{
+		pthread_join(threads[t],NULL);
+		p.time_compute+=workers[t].time_busy;
+	}
+	queue_close(&p.encodeq);
+	pthread_join(encoder,NULL);
+	pthread_join(writer,NULL);
+	double time_diff=gettime()-time_start;
+/*------------------------------------------------------------------------------------------------*/
+
+	printf("Time:\t%g\n",time_diff);
+	printf("frames/s:\t%g\n",p.numframes/time_diff);
+	printf("total number of iterations:\t%lu (%lu FlOp)\n",p.sumiter,p.sumiter*10);
+	if(time_diff>0.) printf("FlOp/s:\t%g\n",p.sumiter*10./time_diff);
+	/* the slowest stage limits the throughput */
+	printf("stage busy times [s]:\tcompute %g (%g per thread)\tencode %g\twrite %g\n"
+	      ,p.time_compute,p.time_compute/numthreads,p.time_encode,p.time_write);
+	printf("PGM files:\t%s\n",outpattern);
+
+	free(threads);
+	free(workers);
+	for(k=0;k<numbuffers;++k)
+	{
+		free(framebuffers[k].buf);
+		free(framebuffers[k].M);
+	}
+	free(framebuffers);
+	queue_destroy(&p.writeq);
+	queue_destroy(&p.encodeq);
+	queue_destroy(&p.freeframes);
+	pthread_mutex_destroy(&p.mtx);
+	free(p.frames);
+
+	return 0;
+}
@@ -0,0 +1,293 @@
+/* mandelbrot_deepzoom.c
+   calculate deep zooms into the Mandelbrot set with perturbation theory
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -Wall -g -pthread mandelbrot_deepzoom.c -lm -o mandelbrot_deepzoom
+	gcc -march=native -O3 -pthread mandelbrot_deepzoom.c -lm -o mandelbrot_deepzoom
+	// no -Ofast/-ffast-math (double-double arithmetic, see ddouble.h)
+
+	mandelbrot_deepzoom <width> <height> <maxiter> <Creal center> <Cimg center> <radius> [<filename>] [<numthreads>] [rebase|glitch]
+
+	e.g.
+	$ ./mandelbrot_deepzoom 1280 960 10000 -0.743643887037158704752191506114774 0.131825904205311970493132056385139 1e-25 deep.pgm
+
+	<radius> is half of the imaginary range, the pixel spacing is 2*<radius>/(<height>-1).
+	Below a spacing of about 1e-15 the double precision C=CrealMin+column*dCreal of
+	mandelbrot_seq.c can't resolve the pixels any more.
+
+	Perturbation: only one reference orbit Z_n (at the center) is calculated with
+	double-double precision (ddouble.h, ~32 decimal digits, i.e. radius >~1e-30).
+	Every pixel c=C+dc iterates the difference z_n=Z_n+dz_n in double precision
+		dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc
+	where only the (small) dz and dc have to be stored with a precision relative to the pixel spacing.
+	If |Z_n+dz_n| gets small compared to |dz_n|, the difference looses its relative precision ("glitch"):
+	- rebase (default): continue with dz=Z_n+dz_n relative to Z_0=0 (Zhuoran 2021),
+	  which also handles reference orbits escaping before maxiter
+	- glitch: detect glitches with Pauldelbrot's criterion |Z_n+dz_n|^2 < GLITCHTOL |Z_n|^2,
+	  calculate a new reference orbit at a glitched pixel and recalculate all glitched pixels
+	  (up to MAXREFERENCES times)
+
+	double exponents limit the pixel spacing to >~1e-300 anyway
+*/
+
+/* Defaults for command line arguments ===========================================================*/
+#define GLITCHTOL 1.E-6
+#define MAXREFERENCES 64
+/*================================================================================================*/
+
+#include<stdlib.h>	/* malloc(),free(),labs(),atol(),atof() */
+#include<stdio.h>	/* printf() */
+#include<string.h>	/* strcmp() */
+#include<unistd.h>	/* sysconf() */
+#include<pthread.h>
+
+#include "mandelbrot.h"
+#include "ddouble.h"
+
+#define GLITCHED ((Titer)-1)
+
+typedef struct {
+	double re, im;
+} Tcomplex;
+
+typedef struct {
+	Tdd Creal, Cimg;	/* reference point */
+	Tcomplex *Z;	/* Z_0..Z_len */
+	Titer len;	/* Z_len is the last point (maxiter or first escaped) */
+} Treference;
+
+typedef struct {
+	Tview view;	/* numcolumns, numrows, maxiter, Zabs2bound */
+	double spacing;
+	Tdd Creal, Cimg;	/* center */
+	int rebase;
+	int onlyglitched;	/* recalculate only the glitched pixels (secondary references) */
+
+	Titer *M;
+	Treference *ref;
+	double refdCreal, refdCimg;	/* reference point relative to center */
+
+	Tindex nextrow;	/* dynamic scheduling of rows */
+	unsigned long sumiter, numglitched, numrebased;
+} Tdeepzoom;
+
+
+void reference_orbit(Treference *ref, Tdd Creal, Tdd Cimg, Titer maxiter, double Zabs2bound)
+{	/* calculate Z_{n+1}=Z_n^2+C with double-double precision, store it rounded to double */
+	Tdd Zreal=dd_from_double(0.), Zimg=dd_from_double(0.), Zreal_tmp;
+	Titer n;
+	ref->Creal=Creal;
+	ref->Cimg=Cimg;
+	ref->Z[0].re=0.; ref->Z[0].im=0.;
+	for(n=0;n<maxiter;++n)
+	{
+		Zreal_tmp=dd_add(dd_sub(dd_sqr(Zreal),dd_sqr(Zimg)),Creal);
+		Zimg=dd_add(dd_mul_d(dd_mul(Zreal,Zimg),2.),Cimg);
+		Zreal=Zreal_tmp;
+		ref->Z[n+1].re=dd_to_double(Zreal);
+		ref->Z[n+1].im=dd_to_double(Zimg);
+		if(ref->Z[n+1].re*ref->Z[n+1].re+ref->Z[n+1].im*ref->Z[n+1].im>Zabs2bound)
+		{
+			++n;
+			break;
+		}
+	}
+	ref->len=n;
+}
+
+
+/* iterate pixel c=Cref+dc relative to the reference orbit
+   returns the number of iterations like mandelbrot_point() or GLITCHED */
+static inline Titer perturbation_point(const Treference *ref, double dCreal, double dCimg
+                                      ,Titer maxiter, double Zabs2bound, int rebase, unsigned long *numrebased)
+{
+	const Tcomplex *Z=ref->Z;
+	double dZreal=0., dZimg=0.;	/* z_0 = Z_0 = 0 */
+	Titer m=0, i;
+	for(i=0;i<maxiter;++i)
+	{	/* dz_{n+1} = (2 Z_n + dz_n) dz_n + dc */
+		double Treal=2.*Z[m].re+dZreal, Timg=2.*Z[m].im+dZimg;
+		double dZreal_tmp=Treal*dZreal-Timg*dZimg+dCreal;
+		dZimg=Treal*dZimg+Timg*dZreal+dCimg;
+		dZreal=dZreal_tmp;
+		++m;
+		double Zreal=Z[m].re+dZreal, Zimg=Z[m].im+dZimg;
+		double Zabs2=Zreal*Zreal+Zimg*Zimg;
+		if(Zabs2>Zabs2bound) break;
+		if(rebase)
+		{
+			if(Zabs2<dZreal*dZreal+dZimg*dZimg || (m==ref->len && i+1<maxiter))
+			{	/* continue relative to Z_0=0 */
+				dZreal=Zreal; dZimg=Zimg;
+				m=0;
+				++*numrebased;
+			}
+		}
+		else
+		{
+			if(Zabs2<GLITCHTOL*(Z[m].re*Z[m].re+Z[m].im*Z[m].im) || (m==ref->len && i+1<maxiter))
+				return GLITCHED;
+		}
+	}
+	return i;
+}
+
+void* deepzoom_worker(void *arg)
+{
+	Tdeepzoom *dz=(Tdeepzoom*)arg;
+	Tindex numcolumns=dz->view.numcolumns, numrows=dz->view.numrows;
+	Titer maxiter=dz->view.maxiter;
+	double Zabs2bound=dz->view.Zabs2bound;
+	/* pixel (column,row) relative to the center */
+	double column_center=(numcolumns-1)/2., row_center=(numrows-1)/2.;
+	unsigned long sumiter=0, numglitched=0, numrebased=0;
+	Tindex row, column;
+	while((row=__sync_fetch_and_add(&dz->nextrow,1))<numrows)
+	{
+		double dCimg=(row_center-row)*dz->spacing-dz->refdCimg;
+		Titer *Mact=dz->M+colrow2index(0,row,numcolumns);
+		for(column=0;column<numcolumns;++column,++Mact)
+		{
+			if(dz->onlyglitched && *Mact!=GLITCHED) continue;
+			double dCreal=(column-column_center)*dz->spacing-dz->refdCreal;
+			Titer i=perturbation_point(dz->ref,dCreal,dCimg,maxiter,Zabs2bound,dz->rebase,&numrebased);
+			*Mact=i;
+			if(i==GLITCHED)
+				++numglitched;
+			else
+				sumiter+=i;
+		}
+	}
+	__sync_add_and_fetch(&dz->sumiter,sumiter);
+	__sync_add_and_fetch(&dz->numglitched,numglitched);
+	__sync_add_and_fetch(&dz->numrebased,numrebased);
+	return NULL;
+}
+
+void deepzoom_pass(Tdeepzoom *dz, pthread_t *threads, long numthreads)
+{	/* calculate all (rebase mode or primary reference) or all glitched pixels */
+	long t;
+	dz->nextrow=0;
+	dz->numglitched=0;
+	for(t=0;t<numthreads;++t) pthread_create(&threads[t],NULL,deepzoom_worker,dz);
+	for(t=0;t<numthreads;++t) pthread_join(threads[t],NULL);
+}
+
+
+int main(int argc, char *argv[])
+{
+	Tindex numcolumns, numrows;
+	Titer maxiter;
+	Tdd Creal, Cimg;
+	double radius;
+	char filename_default[]="mandelbrot_deepzoom.pgm";
+	char *filename=filename_default;
+	long numthreads=sysconf(_SC_NPROCESSORS_ONLN);
+	int rebase=1;
+
+	if (argc<7)
+	{
+		printf("usage: %s <width> <height> <maxiter> <Creal center> <Cimg center> <radius> [<filename>] [<numthreads>] [rebase|glitch]\n",argv[0]);
+		exit(0);
+	}
+	numcolumns=labs(atol(argv[1]));
+	numrows=labs(atol(argv[2]));
+	maxiter=labs(atol(argv[3]));
+	dd_from_string(argv[4],&Creal);
+	dd_from_string(argv[5],&Cimg);
+	radius=fabs(atof(argv[6]));
+	if (argc>7) filename=argv[7];
+	if (argc>8) numthreads=labs(atol(argv[8]));
+	if (argc>9) rebase=strcmp(argv[9],"glitch");
+	if(numcolumns<1) numcolumns=1;
+	if(numrows<2) numrows=2;
+	if(numthreads<1) numthreads=1;
+	if(maxiter>65535) maxiter=65535;	/* PGM maxval */
+
+	Tdeepzoom dz;
+	dz.spacing=2.*radius/(numrows-1);
+	double halfwidth=dz.spacing*(numcolumns-1)/2.;
+	view_init(&dz.view,numcolumns,numrows,maxiter
+	         ,dd_to_double(Creal)-halfwidth,dd_to_double(Cimg)-radius
+	         ,dd_to_double(Creal)+halfwidth,dd_to_double(Cimg)+radius);
+	dz.Creal=Creal;
+	dz.Cimg=Cimg;
+	dz.rebase=rebase;
+	dz.sumiter=dz.numglitched=dz.numrebased=0;
+
+	printf("width x height:\t%lu x %lu\n",numcolumns,numrows);
+	printf("center:\t%.17g + %.17g i\n",dd_to_double(Creal),dd_to_double(Cimg));
+	printf("radius:\t%g\t(pixel spacing %g)\n",radius,dz.spacing);
+	printf("max. iterations:\t%u\n",maxiter);
+	printf("threads:\t%ld\n",numthreads);
+	printf("mode:\t%s\n",rebase?"rebase":"glitch");
+
+	unsigned long arraysize=numcolumns*numrows*sizeof(Titer);
+	dz.M=(Titer*)malloc(arraysize);
+	Treference ref;
+	ref.Z=(Tcomplex*)malloc((maxiter+1)*sizeof(Tcomplex));
+	pthread_t *threads=(pthread_t*)malloc(numthreads*sizeof(pthread_t));
+	if(!dz.M || !ref.Z || !threads)
+	{
+		printf("ERROR allocating memory (%lu Bytes)\n",arraysize);
+		exit(1);
+	}
+	dz.ref=&ref;
+
+/*------------------------------------------------------------------------------------------------*/
+	double time_start=gettime();
+	/* primary reference at the center */
+	reference_orbit(&ref,Creal,Cimg,maxiter,dz.view.Zabs2bound);
+	double time_ref=gettime()-time_start;
+	printf("reference orbit:\t%u iterations\n",ref.len);
+	dz.refdCreal=dz.refdCimg=0.;
+	dz.onlyglitched=0;
+	deepzoom_pass(&dz,threads,numthreads);
+
+	unsigned int numreferences=1;
+	while(!rebase && dz.numglitched>0 && numreferences<MAXREFERENCES)
+	{	/* new reference at a glitched pixel (the one in the middle of the glitched ones) */
+		unsigned long numglitched=dz.numglitched, k=0;
+		Tindex i, numelements=numcolumns*numrows;
+		for(i=0;i<numelements;++i)
+			if(dz.M[i]==GLITCHED && k++==numglitched/2) break;
+		Tindex row=i/numcolumns, column=i%numcolumns;
+		dz.refdCreal=(column-(numcolumns-1)/2.)*dz.spacing;
+		dz.refdCimg=((numrows-1)/2.-row)*dz.spacing;
+		double t0=gettime();
+		reference_orbit(&ref,dd_add_d(Creal,dz.refdCreal),dd_add_d(Cimg,dz.refdCimg)
+		               ,maxiter,dz.view.Zabs2bound);
+		time_ref+=gettime()-t0;
+		++numreferences;
+		dz.onlyglitched=1;
+		deepzoom_pass(&dz,threads,numthreads);
+		printf("reference %u at pixel (%lu,%lu):\t%u iterations, %lu -> %lu glitched pixels\n"
+		      ,numreferences,column,row,ref.len,numglitched,dz.numglitched);
+		if(dz.numglitched==numglitched && ref.len<maxiter)
+			break;	/* no progress */
+	}
+	double time_diff=gettime()-time_start;
+/*------------------------------------------------------------------------------------------------*/
+	printf("Time:\t%g\t(reference orbits %g)\n",time_diff,time_ref);
+	printf("total number of iterations:\t%lu\n",dz.sumiter);
+	if(time_diff>0.) printf("iterations/s:\t%g\n",dz.sumiter/time_diff);
+	if(rebase)
+		printf("rebased:\t%lu\n",dz.numrebased);
+	else
+	{
+		printf("references:\t%u\n",numreferences);
+		printf("glitched pixels:\t%lu\n",dz.numglitched);
+		Tindex i;
+		for(i=0;i<numcolumns*numrows;++i)
+			if(dz.M[i]==GLITCHED) dz.M[i]=maxiter;	/* remaining glitches */
+	}
+
+	writePGM(dz.M,maxiter,numcolumns,numrows,filename);
+	printf("PGM file:\t%s\n",filename);
+
+	free(threads);
+	free(ref.Z);
+	free(dz.M);
+
+	return 0;
+}
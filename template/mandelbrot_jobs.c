@@ -0,0 +1,448 @@
+/* mandelbrot_jobs.c
+   calculate many Mandelbrot images (render jobs) on a shared thread pool
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -Wall -g -pthread mandelbrot_jobs.c -o mandelbrot_jobs
+	gcc -march=native -O3 -pthread mandelbrot_jobs.c -o mandelbrot_jobs
+	gcc -march=native -O3 -pthread -DUSE_TRACE mandelbrot_jobs.c -o mandelbrot_jobs
+	// USE_TRACE: TRACEFILE=jobs.json ./mandelbrot_jobs ...  timeline of waits and tasks (trace.h)
+
+	mandelbrot_jobs [<jobfile>|-] [<numthreads>] [<latencyfile>]
+
+	e.g.
+	$ ./mandelbrot_jobs thumbnails.txt 8 latency.dat
+	$ generate_views | ./mandelbrot_jobs - 8
+
+	job file (default: stdin): one job per line (# starts a comment)
+		<width> <height> <maxiter> <CrealMin> <CimgMin> <CrealMax> <CimgMax> <filename> [<lane>]
+	lane 0 is the highest priority, default DEFAULT_LANE, lanes 0...NUMLANES-1.
+
+	The jobs are scheduled as tasks of about TASKPIXELS pixels as soon as they are read:
+	- jobs with more than TASKPIXELS pixels are split into row blocks, the worker finishing
+	  the last block writes the file
+	- jobs with at most TASKPIXELS/2 pixels are batched (per lane) until the batch would exceed
+	  TASKPIXELS, a batch is also passed on if a worker is idle, i.e. batches only form under load
+	- the workers always take the next task of the highest priority non-empty lane
+	  (strict priority, a lower lane only gets threads if the higher ones are empty)
+	The images of the jobs read but not yet written are limited to MAXINFLIGHT Bytes: before
+	allocating the next one the reader waits for the workers (after passing on the batches,
+	they hold memory, too), a single larger job is read when nothing else is in flight.
+	The latency of a job is the time from reading its line until its file is written.
+	<latencyfile> gets one line per job, the summary shows jobs/s and percentiles per lane.
+*/
+
+#include<stdlib.h>	/* malloc(),free(),labs(),atol(),qsort() */
+#include<stdio.h>	/* printf(),fopen(),fgets(),sscanf() */
+#include<string.h>	/* strcmp(),strchr() */
+#include<unistd.h>	/* sysconf() */
+#include<pthread.h>
+
+#include "mandelbrot.h"
+#include "trace.h"
+
+#define NUMLANES 3
+#define DEFAULT_LANE 1
+#define TASKPIXELS 65536
+#define FILENAMELEN 256
+#define MAXINFLIGHT (1UL<<30)	/* [Bytes] images allocated, not yet written */
+
+
+typedef struct Tjob {
+	Tview v;
+	char filename[FILENAMELEN];
+	unsigned int lane;
+	unsigned long line;
+	Titer *M;
+	unsigned long sumiter;	/* atomic */
+	unsigned int partsleft;	/* atomic */
+	double time_submit, time_done;
+	struct Tjob *nextinbatch;
+} Tjob;
+
+typedef struct Ttask {
+	Tjob *job;	/* batch: list of whole jobs */
+	int batch;
+	Tindex row0, row1;	/* part of a split job */
+	struct Ttask *next;
+} Ttask;
+
+typedef struct {
+	Ttask *head[NUMLANES], *tail[NUMLANES];
+	unsigned int idle;	/* waiting workers */
+	int closed;
+	unsigned long inflight;	/* Bytes of the images not yet written */
+	pthread_mutex_t mtx;
+	pthread_cond_t notempty, notfull;
+	unsigned long numtasks, numbatches, numparts, numwaits;
+} Tpool;
+
+typedef struct {
+	Tpool *pool;
+	double time_busy;
+} Tworker;
+
+
+void pool_push(Tpool *p, Ttask *t, unsigned int lane)
+{
+	t->next=NULL;
+	pthread_mutex_lock(&p->mtx);
+	if(p->tail[lane]) p->tail[lane]->next=t; else p->head[lane]=t;
+	p->tail[lane]=t;
+	++p->numtasks;
+	pthread_cond_signal(&p->notempty);
+	pthread_mutex_unlock(&p->mtx);
+}
+
+Ttask* pool_pop(Tpool *p)
+{	/* highest priority task, NULL if closed and empty */
+	Ttask *t=NULL;
+	unsigned int lane;
+	pthread_mutex_lock(&p->mtx);
+	for(;;)
+	{
+		for(lane=0;lane<NUMLANES && !p->head[lane];++lane);
+		if(lane<NUMLANES || p->closed) break;
+		++p->idle;
+		pthread_cond_wait(&p->notempty,&p->mtx);
+		--p->idle;
+	}
+	if(lane<NUMLANES)
+	{
+		t=p->head[lane];
+		p->head[lane]=t->next;
+		if(!p->head[lane]) p->tail[lane]=NULL;
+	}
+	pthread_mutex_unlock(&p->mtx);
+	return t;
+}
+
+Ttask* newtask(Tjob *job, int batch, Tindex row0, Tindex row1)
+{
+	Ttask *t=(Ttask*)malloc(sizeof(Ttask));
+	if(!t)
+	{
+		printf("ERROR allocating task\n");
+		exit(1);
+	}
+	t->job=job; t->batch=batch; t->row0=row0; t->row1=row1;
+	return t;
+}
+
+static inline unsigned long jobbytes(const Tjob *job)
+{
+	return job->v.numcolumns*job->v.numrows*sizeof(Titer);
+}
+
+void finishjob(Tpool *p, Tjob *job)
+{
+	writePGM(job->M,job->v.maxiter,job->v.numcolumns,job->v.numrows,job->filename);
+	free(job->M);
+	job->M=NULL;
+	job->time_done=gettime();
+	pthread_mutex_lock(&p->mtx);
+	p->inflight-=jobbytes(job);
+	pthread_cond_signal(&p->notfull);	/* only the reader waits */
+	pthread_mutex_unlock(&p->mtx);
+}
+
+void* job_worker(void *arg)
+{
+	Tworker *w=(Tworker*)arg;
+	Ttask *t;
+	for(;;)
+	{
+		TRACE_START(trace_wait);
+		t=pool_pop(w->pool);
+		TRACE_SPAN("wait",trace_wait,-1);	/* idle: empty pool */
+		if(!t) break;
+		TRACE_START(trace_task);
+#ifdef USE_TRACE
+		const char *trace_name=t->batch?"batch":"rows";
+		long trace_arg=t->batch?-1:(long)t->row0;
+#endif
+		double t0=gettime();
+		Tjob *job;
+		if(t->batch)
+		{
+			for(job=t->job;job;job=job->nextinbatch)
+			{
+				job->sumiter=mandelbrot_rows(&job->v,job->M,0,job->v.numrows);
+				finishjob(w->pool,job);
+			}
+		}
+		else
+		{
+			job=t->job;
+			__sync_add_and_fetch(&job->sumiter,mandelbrot_rows(&job->v,job->M,t->row0,t->row1));
+			if(__sync_sub_and_fetch(&job->partsleft,1)==0) finishjob(w->pool,job);
+		}
+		free(t);
+		w->time_busy+=gettime()-t0;
+		TRACE_SPAN(trace_name,trace_task,trace_arg);
+	}
+	return NULL;
+}
+
+
+/* batch of small jobs per lane, not yet in the pool */
+typedef struct {
+	Tjob *head, *tail;
+	Tindex pixels;
+} Tbatch;
+
+void batch_flush(Tpool *p, Tbatch *b, unsigned int lane)
+{
+	if(!b->head) return;
+	pool_push(p,newtask(b->head,1,0,0),lane);
+	__sync_add_and_fetch(&p->numbatches,1);
+	b->head=b->tail=NULL;
+	b->pixels=0;
+}
+
+void submit(Tpool *p, Tbatch *batches, Tjob *job)
+{
+	Tindex pixels=job->v.numcolumns*job->v.numrows;
+	Tbatch *b=&batches[job->lane];
+	if(pixels<=TASKPIXELS/2)
+	{
+		if(b->pixels+pixels>TASKPIXELS) batch_flush(p,b,job->lane);
+		job->partsleft=1;
+		job->nextinbatch=NULL;
+		if(b->tail) b->tail->nextinbatch=job; else b->head=job;
+		b->tail=job;
+		b->pixels+=pixels;
+	}
+	else
+	{
+		Tindex rowsperpart=(TASKPIXELS+job->v.numcolumns-1)/job->v.numcolumns, row;
+		job->partsleft=(job->v.numrows+rowsperpart-1)/rowsperpart;
+		if(job->partsleft>1) __sync_add_and_fetch(&p->numparts,job->partsleft);
+		for(row=0;row<job->v.numrows;row+=rowsperpart)
+			pool_push(p,newtask(job,0,row,(row+rowsperpart<job->v.numrows)?row+rowsperpart:job->v.numrows),job->lane);
+	}
+	/* do not hold back small jobs if there is nothing else to do */
+	unsigned int lane, idle;
+	pthread_mutex_lock(&p->mtx);
+	idle=p->idle;
+	pthread_mutex_unlock(&p->mtx);
+	if(idle>0)
+		for(lane=0;lane<NUMLANES;++lane) batch_flush(p,&batches[lane],lane);
+}
+
+/* account bytes for the next image, wait while the images in flight would exceed MAXINFLIGHT */
+void pool_reserve(Tpool *p, Tbatch *batches, unsigned long bytes)
+{
+	unsigned int lane;
+	pthread_mutex_lock(&p->mtx);
+	if(p->inflight>0 && p->inflight+bytes>MAXINFLIGHT)
+	{	/* the batched jobs only finish once they are in the pool */
+		pthread_mutex_unlock(&p->mtx);
+		for(lane=0;lane<NUMLANES;++lane) batch_flush(p,&batches[lane],lane);
+		pthread_mutex_lock(&p->mtx);
+		++p->numwaits;
+		TRACE_START(trace_reserve);
+		while(p->inflight>0 && p->inflight+bytes>MAXINFLIGHT) pthread_cond_wait(&p->notfull,&p->mtx);
+		TRACE_SPAN("reserve",trace_reserve,-1);
+	}
+	p->inflight+=bytes;
+	pthread_mutex_unlock(&p->mtx);
+}
+
+int compare_double(const void *a, const void *b)
+{
+	double da=*(const double*)a, db=*(const double*)b;
+	return (da>db)-(da<db);
+}
+
+static inline double percentile(const double *sorted, unsigned long n, double p)
+{	/* nearest rank */
+	unsigned long k=(unsigned long)(p/100.*n+0.999999);
+	if(k<1) k=1;
+	if(k>n) k=n;
+	return sorted[k-1];
+}
+
+
+int main(int argc, char *argv[])
+{
+	const char *jobfilename="-";
+	const char *latencyfilename=NULL;
+	long numthreads=sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (argc>1 && (!strcmp(argv[1],"-h") || !strcmp(argv[1],"--help")))
+	{
+		printf("usage: %s [<jobfile>|-] [<numthreads>] [<latencyfile>]\n",argv[0]);
+		printf("\tjob lines: <width> <height> <maxiter> <CrealMin> <CimgMin> <CrealMax> <CimgMax> <filename> [<lane>]\n");
+		exit(0);
+	}
+	if (argc>1) jobfilename=argv[1];
+	if (argc>2) numthreads=labs(atol(argv[2]));
+	if (argc>3) latencyfilename=argv[3];
+	if(numthreads<1) numthreads=1;
+	TRACE_INIT(getenv("TRACEFILE"));
+
+	FILE *jobfile=strcmp(jobfilename,"-")?fopen(jobfilename,"r"):stdin;
+	if(!jobfile)
+	{
+		printf("ERROR opening job file %s\n",jobfilename);
+		exit(2);
+	}
+
+	Tpool pool;
+	unsigned int lane;
+	for(lane=0;lane<NUMLANES;++lane) pool.head[lane]=pool.tail[lane]=NULL;
+	pool.idle=0;
+	pool.closed=0;
+	pool.inflight=0;
+	pool.numtasks=pool.numbatches=pool.numparts=pool.numwaits=0;
+	pthread_mutex_init(&pool.mtx,NULL);
+	pthread_cond_init(&pool.notempty,NULL);
+	pthread_cond_init(&pool.notfull,NULL);
+	Tbatch batches[NUMLANES];
+	for(lane=0;lane<NUMLANES;++lane)
+	{
+		batches[lane].head=batches[lane].tail=NULL;
+		batches[lane].pixels=0;
+	}
+
+	Tworker *workers=(Tworker*)malloc(numthreads*sizeof(Tworker));
+	pthread_t *threads=(pthread_t*)malloc(numthreads*sizeof(pthread_t));
+	unsigned long numjobs=0, maxjobs=1024, numline=0;
+	Tjob **jobs=(Tjob**)malloc(maxjobs*sizeof(Tjob*));
+	if(!workers || !threads || !jobs)
+	{
+		printf("ERROR allocating memory for %ld threads\n",numthreads);
+		exit(1);
+	}
+
+/*------------------------------------------------------------------------------------------------*/
+	double time_start=gettime();
+	long t;
+	for(t=0;t<numthreads;++t)
+	{
+		workers[t].pool=&pool;
+		workers[t].time_busy=0.;
+		pthread_create(&threads[t],NULL,job_worker,&workers[t]);
+	}
+	char line[1024];
+	while(fgets(line,sizeof(line),jobfile))
+	{
+		Tindex numcolumns, numrows;
+		Titer maxiter;
+		Tfloat CrealMin, CimgMin, CrealMax, CimgMax;
+		char filename[FILENAMELEN];
+		unsigned int joblane=DEFAULT_LANE;
+		char *comment=strchr(line,'#');
+		++numline;
+		if(comment) *comment='\0';
+		int n=sscanf(line,"%lu %lu %u %lf %lf %lf %lf %255s %u",&numcolumns,&numrows,&maxiter
+		            ,&CrealMin,&CimgMin,&CrealMax,&CimgMax,filename,&joblane);
+		if(n<=0) continue;	/* empty line */
+		if(n<8 || numcolumns<1 || numrows<1 || maxiter>65535 || joblane>=NUMLANES)
+		{
+			printf("ERROR in job file %s line %lu (skipped)\n",jobfilename,numline);
+			continue;
+		}
+		double time_read=gettime();
+		pool_reserve(&pool,batches,numcolumns*numrows*sizeof(Titer));
+		Tjob *job=(Tjob*)malloc(sizeof(Tjob));
+		if(job) job->M=(Titer*)malloc(numcolumns*numrows*sizeof(Titer));
+		if(numjobs==maxjobs)
+		{
+			maxjobs*=2;
+			jobs=(Tjob**)realloc(jobs,maxjobs*sizeof(Tjob*));
+		}
+		if(!job || !job->M || !jobs)
+		{
+			printf("ERROR allocating memory for job in line %lu\n",numline);
+			exit(1);
+		}
+		view_init(&job->v,numcolumns,numrows,maxiter,CrealMin,CimgMin,CrealMax,CimgMax);
+		strcpy(job->filename,filename);
+		job->lane=joblane;
+		job->line=numline;
+		job->sumiter=0;
+		job->time_submit=time_read;	/* including the wait in pool_reserve() */
+		jobs[numjobs++]=job;
+		submit(&pool,batches,job);
+	}
+	for(lane=0;lane<NUMLANES;++lane) batch_flush(&pool,&batches[lane],lane);
+	pthread_mutex_lock(&pool.mtx);
+	pool.closed=1;
+	pthread_cond_broadcast(&pool.notempty);
+	pthread_mutex_unlock(&pool.mtx);
+	double time_busy=0.;
+	for(t=0;t<numthreads;++t)
+	{
+		pthread_join(threads[t],NULL);
+		time_busy+=workers[t].time_busy;
+	}
+	double time_diff=gettime()-time_start;
+/*------------------------------------------------------------------------------------------------*/
+	if(jobfile!=stdin) fclose(jobfile);
+
+	unsigned long k, sumiter=0, sumpixels=0;
+	unsigned long lanejobs[NUMLANES]={0};
+	double *latency=(double*)malloc((numjobs+1)*sizeof(double));
+	FILE *latencyfile=NULL;
+	if(latencyfilename)
+	{
+		latencyfile=fopen(latencyfilename,"w");
+		if(!latencyfile)
+		{
+			printf("ERROR opening file %s\n",latencyfilename);
+			exit(2);
+		}
+		fprintf(latencyfile,"# line\tlane\twidth\theight\tmaxiter\titerations\tlatency[s]\tfilename\n");
+	}
+	for(k=0;k<numjobs;++k)
+	{
+		Tjob *job=jobs[k];
+		sumiter+=job->sumiter;
+		sumpixels+=job->v.numcolumns*job->v.numrows;
+		++lanejobs[job->lane];
+		if(latencyfile)
+			fprintf(latencyfile,"%lu\t%u\t%lu\t%lu\t%u\t%lu\t%g\t%s\n",job->line,job->lane,job->v.numcolumns
+			       ,job->v.numrows,job->v.maxiter,job->sumiter,job->time_done-job->time_submit,job->filename);
+	}
+	if(latencyfile) fclose(latencyfile);
+
+	printf("jobs:\t%lu\n",numjobs);
+	printf("threads:\t%ld\n",numthreads);
+	printf("tasks:\t%lu (%lu batches of small jobs, %lu parts of split jobs)\n"
+	      ,pool.numtasks,pool.numbatches,pool.numparts);
+	printf("reader waits:\t%lu (images in flight > %lu MB)\n",pool.numwaits,MAXINFLIGHT>>20);
+	printf("Time:\t%g\n",time_diff);
+	if(time_diff>0.)
+	{
+		printf("jobs/s:\t%g\n",numjobs/time_diff);
+		printf("pixels/s:\t%g\n",sumpixels/time_diff);
+		printf("FlOp/s:\t%g\n",sumiter*10./time_diff);
+		printf("thread utilization:\t%g%%\n",100.*time_busy/(numthreads*time_diff));
+	}
+	printf("total number of iterations:\t%lu (%lu FlOp)\n",sumiter,sumiter*10);
+	printf("# lane\tjobs\tlatency[ms](p50,p99,max)\n");
+	for(lane=0;lane<NUMLANES;++lane)
+	{
+		unsigned long n=0;
+		if(!lanejobs[lane]) continue;
+		for(k=0;k<numjobs;++k)
+			if(jobs[k]->lane==lane) latency[n++]=jobs[k]->time_done-jobs[k]->time_submit;
+		qsort(latency,n,sizeof(double),compare_double);
+		printf("%u\t%lu\t%g\t%g\t%g\n",lane,n,percentile(latency,n,50.)*1.E3
+		      ,percentile(latency,n,99.)*1.E3,latency[n-1]*1.E3);
+	}
+
+	TRACE_WRITE();
+
+	free(latency);
+	for(k=0;k<numjobs;++k) free(jobs[k]);
+	free(jobs);
+	free(threads);
+	free(workers);
+	pthread_cond_destroy(&pool.notfull);
+	pthread_cond_destroy(&pool.notempty);
+	pthread_mutex_destroy(&pool.mtx);
+
+	return 0;
+}
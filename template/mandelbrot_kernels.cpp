@@ -0,0 +1,708 @@
+/* mandelbrot_kernels.cpp
+   calculate Mandelbrot/Multibrot/Julia sets with templated escape-time kernels,
+   the floating point precision (float, double, double-double) is chosen per view,
+   alternatively with 64 bit fixed-point integers
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	g++ -std=c++17 -Wall -g mandelbrot_kernels.cpp -o mandelbrot_kernels
+	g++ -std=c++17 -march=native -O3 -fopenmp mandelbrot_kernels.cpp -o mandelbrot_kernels
+	// no -Ofast/-ffast-math (double-double arithmetic, see ddouble.h)
+
+	mandelbrot_kernels [<width> <height>] [<maxiter>] [<CrealMin> <CimgMin> <CrealMax> <CimgMax>] [<filename>] [auto|float|double|dd|fixed] [validate|bench]
+	                   [d=<power>] [julia=<Creal>,<Cimg>] [k=<check interval>]
+
+	e.g.
+	$ ./mandelbrot_kernels 1920 1080 255 -2 -1 1.5555556 1 mandelbrot3.pgm
+	$ ./mandelbrot_kernels 1280 960 1000 -0.7436438870371 0.1318259042052 -0.7436438870369 0.1318259042054 m.pgm auto validate
+	$ ./mandelbrot_kernels 1280 960 255 -1.6 -1.2 1.6 1.2 julia.pgm julia=-0.8,0.156
+	$ ./mandelbrot_kernels 1280 960 255 -1.5 -1.5 1.5 1.5 multibrot3.pgm d=3 k=16
+	$ ./mandelbrot_kernels 1280 960 1000 -0.75 0.1 -0.74 0.11 m.pgm fixed bench
+
+	auto (default) derives the required mantissa bits from pixel spacing and coordinate magnitude
+		bits = log2(max|C| / spacing) + GUARDBITS
+	and takes the smallest of float (24), double (53) or double-double (~106) providing them.
+	float gives twice the SIMD lanes of double, double-double is ~10-20x slower than double.
+	The kernel iterates LANES pixels in lock-step, such that the compiler can vectorize the lanes.
+	validate calculates the view additionally with the next higher precision and reports the differences.
+
+	The kernel is a template on the precision, the power d of z^d+c, Mandelbrot (z_0=0, c=pixel)
+	vs. Julia (z_0=pixel, c fixed) and the check interval k: k iterations are done without
+	escape test, if a lane escaped in between, the k iterations are rolled back and repeated
+	with a test per iteration (escaped lanes are parked at the fixed point z=c=0).
+	A dispatch table holds the instantiations for d=2..MAXPOWER and k=1,4,8,16, other powers
+	use the generic kernel (d=0, exponent at runtime). k=0 (default) chooses k=8 for double and
+	k=1 for float (the 16 lane float test is cheap already, measured on Sapphire Rapids) and
+	dd (the test is negligible compared to the arithmetic).
+
+	fixed: 64 bit fixed-point numbers with 128 bit intermediate products (k=1 only, escaped lanes
+	keep iterating and wrap around modulo 2^64, the sums are done unsigned, i.e. defined).
+	The number of fractional bits is derived from the view: the integer part has to
+	hold (R^d+|c|)^2 with the escape radius R=max(2,|c|) (Julia: also the largest |pixel| of the
+	view, that is z_0), i.e. 57 fractional bits for z^2+c.
+	Integer arithmetic gives bit-identical images for any compiler and flags (also -Ofast), pixel
+	coordinates are interpolated with integers, too. The precision is never chosen by auto.
+	bench renders the view with float, double and fixed (best of BENCHREPEAT) and compares throughput.
+
+	-DNOMAIN: no main(), the dispatch table through the C interface of mandelbrot_kernels.h
+	(validate.c compares all kernels with a per pixel reference)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "mandelbrot.h"
+#include "mandelbrot_kernels.h"
+#include "ddouble.h"
+
+constexpr int GUARDBITS = 8;
+constexpr int MAXPOWER = 6;
+constexpr int BENCHREPEAT = 3;
+#if defined(__AVX512F__)
+constexpr int VECBYTES = 64;
+#elif defined(__AVX__)
+constexpr int VECBYTES = 32;
+#else
+constexpr int VECBYTES = 16;
+#endif
+
+/* double-double with operators for the templated kernel ========================================*/
+struct DDouble {
+  Tdd v;
+  DDouble() = default;
+  DDouble(double a) : v(dd_from_double(a)) {}
+  explicit DDouble(Tdd a) : v(a) {}
+  friend DDouble operator+(DDouble a, DDouble b) { return DDouble(dd_add(a.v, b.v)); }
+  friend DDouble operator-(DDouble a, DDouble b) { return DDouble(dd_sub(a.v, b.v)); }
+  friend DDouble operator*(DDouble a, DDouble b) { return DDouble(dd_mul(a.v, b.v)); }
+  friend DDouble operator*(int a, DDouble b) { return DDouble(dd_mul_d(b.v, a)); }
+  friend bool operator<=(DDouble a, DDouble b) { return a.v.hi < b.v.hi || (a.v.hi == b.v.hi && a.v.lo <= b.v.lo); }
+};
+
+/* 64 bit fixed-point with fracbits fractional bits */
+struct Fixed {
+  int64_t v;
+  static inline int fracbits = 57;
+  Fixed() = default;
+  Fixed(double a) : v(static_cast<int64_t>(std::llround(std::ldexp(a, fracbits)))) {}
+  static Fixed raw(int64_t a) { Fixed r; r.v = a; return r; }
+  /* sums wrap around modulo 2^64 (uint64_t, no signed overflow), only escaped lanes get there */
+  static Fixed wrap(uint64_t a) { return raw(static_cast<int64_t>(a)); }
+  friend Fixed operator+(Fixed a, Fixed b) { return wrap(static_cast<uint64_t>(a.v) + static_cast<uint64_t>(b.v)); }
+  friend Fixed operator-(Fixed a, Fixed b) { return wrap(static_cast<uint64_t>(a.v) - static_cast<uint64_t>(b.v)); }
+  friend Fixed operator*(Fixed a, Fixed b) {  /* 128 bit product, truncated (arithmetic shift) */
+    return raw(static_cast<int64_t>((static_cast<__int128>(a.v) * b.v) >> fracbits));
+  }
+  friend Fixed operator*(int a, Fixed b) { return wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b.v)); }
+  friend bool operator<=(Fixed a, Fixed b) { return a.v <= b.v; }
+
+  static void setscale(double Rmax, double cmax, int power) {
+    /* largest value: |z_{i+1}|^2 <= (R^d+|c|)^2 for |z_i|<=R, +1 sign bit */
+    double zmax = std::pow(Rmax, power) + cmax;
+    int intbits = static_cast<int>(std::ceil(std::log2(zmax * zmax))) + 1;
+    fracbits = std::max(1, 63 - intbits);
+  }
+
+  /* parse a decimal number with integer arithmetic only (no dependency on FP flags),
+     returns the number of characters used like dd_from_string() */
+  static int parse(const char* s, Fixed& a) {
+    const char* p = s;
+    bool negative = false;
+    const __int128 one = static_cast<__int128>(1) << fracbits;
+    __int128 r = 0;
+    while (isspace(static_cast<unsigned char>(*p))) ++p;
+    if (*p == '-' || *p == '+') negative = (*p++ == '-');
+    for (; isdigit(static_cast<unsigned char>(*p)); ++p) r = 10 * r + (*p - '0') * one;
+    if (*p == '.') {  /* fraction from the last digit: f = (d_i + f)/10 */
+      const char* first = ++p;
+      while (isdigit(static_cast<unsigned char>(*p))) ++p;
+      __int128 f = 0;
+      for (const char* d = p - 1; d >= first; --d) f = ((*d - '0') * one + f) / 10;
+      r += f;
+    }
+    if (*p == 'e' || *p == 'E') {
+      int e = 0;
+      ++p;
+      bool enegative = false;
+      if (*p == '-' || *p == '+') enegative = (*p++ == '-');
+      for (; isdigit(static_cast<unsigned char>(*p)); ++p) e = 10 * e + (*p - '0');
+      for (; e > 0; --e) r = enegative ? r / 10 : r * 10;
+    }
+    a.v = static_cast<int64_t>(negative ? -r : r);
+    return static_cast<int>(p - s);
+  }
+
+  static Fixed interpolate(Fixed a, Fixed b, Tindex k, Tindex n) {  /* a+(b-a)*k/(n-1) */
+    if (n < 2) return a;
+    return raw(a.v + static_cast<int64_t>(static_cast<__int128>(b.v - a.v) * k / static_cast<__int128>(n - 1)));
+  }
+};
+
+/* a+(b-a)*k/(n-1) with double-double precision */
+inline Tdd dd_interpolate(Tdd a, Tdd b, Tindex k, Tindex n) {
+  if (n < 2) return a;
+  return dd_add(a, dd_div_d(dd_mul_d(dd_sub(b, a), k), n - 1));
+}
+
+template <typename T> struct Precision;
+template <> struct Precision<float> {
+  static constexpr const char* name = "float";
+  static constexpr int bits = 24;
+  static constexpr int lanes = VECBYTES / sizeof(float);
+  using Tcount = int32_t;
+  static float from(Tdd a) { return static_cast<float>(dd_to_double(a)); }
+};
+template <> struct Precision<double> {
+  static constexpr const char* name = "double";
+  static constexpr int bits = 53;
+  static constexpr int lanes = VECBYTES / sizeof(double);
+  using Tcount = int64_t;
+  static double from(Tdd a) { return dd_to_double(a); }
+};
+template <> struct Precision<DDouble> {
+  static constexpr const char* name = "dd";
+  static constexpr int bits = 106;
+  static constexpr int lanes = 1;
+  using Tcount = int64_t;
+  static DDouble from(Tdd a) { return DDouble(a); }
+};
+template <> struct Precision<Fixed> {
+  static constexpr const char* name = "fixed";
+  static constexpr int bits = 63;  /* at most, actually Fixed::fracbits */
+  static constexpr int lanes = 2;  /* no SIMD, but two independent chains */
+  using Tcount = int64_t;
+  static Fixed from(Tdd a) {  /* depends on FP flags, see Fixed::parse() */
+    double h = std::ldexp(a.hi, Fixed::fracbits), hfloor = std::floor(h);
+    return Fixed::raw(static_cast<int64_t>(hfloor) + std::llround((h - hfloor) + std::ldexp(a.lo, Fixed::fracbits)));
+  }
+};
+
+enum class Tprec { Float, Double, DD, Fixed };
+
+/* view with coordinates in double-double, such that they survive the command line */
+struct ViewDD {
+  Tindex numcolumns, numrows;
+  Tdd CrealMin, CimgMin, CrealMax, CimgMax;
+  Fixed FCrealMin, FCimgMin, FCrealMax, FCimgMax;  /* parsed with Fixed::parse() */
+  Titer maxiter;
+  double Zabs2bound;
+
+  template <typename T> T Creal(Tindex column) const {
+    if constexpr (std::is_same_v<T, Fixed>)
+      return Fixed::interpolate(FCrealMin, FCrealMax, column, numcolumns);
+    else
+      return Precision<T>::from(dd_interpolate(CrealMin, CrealMax, column, numcolumns));
+  }
+  template <typename T> T Cimg(Tindex row) const {  /* row 0 is CimgMax */
+    if constexpr (std::is_same_v<T, Fixed>)
+      return Fixed::interpolate(FCimgMax, FCimgMin, row, numrows);
+    else
+      return Precision<T>::from(dd_interpolate(CimgMax, CimgMin, row, numrows));
+  }
+  double spacing() const {
+    double dr = numcolumns > 1 ? dd_to_double(dd_sub(CrealMax, CrealMin)) / (numcolumns - 1) : 0.;
+    double di = numrows > 1 ? dd_to_double(dd_sub(CimgMax, CimgMin)) / (numrows - 1) : 0.;
+    return std::max(std::fabs(dr), std::fabs(di));
+  }
+  double magnitude() const {
+    return std::max({std::fabs(dd_to_double(CrealMin)), std::fabs(dd_to_double(CrealMax)),
+                     std::fabs(dd_to_double(CimgMin)), std::fabs(dd_to_double(CimgMax)), 1.});
+  }
+};
+/*================================================================================================*/
+
+
+/* kernel parameters not being template parameters */
+struct Tparams {
+  int power;  /* runtime exponent for the generic kernel (D=0) */
+  Tdd Jreal, Jimg;  /* Julia constant c */
+  Fixed FJreal, FJimg;
+
+  template <typename T> T Creal() const {
+    if constexpr (std::is_same_v<T, Fixed>) return FJreal; else return Precision<T>::from(Jreal);
+  }
+  template <typename T> T Cimg() const {
+    if constexpr (std::is_same_v<T, Fixed>) return FJimg; else return Precision<T>::from(Jimg);
+  }
+};
+
+/* Z = Z^D (D>0) or Z^power (D=0) */
+template <int D, typename T>
+inline void zpow(T& Zreal, T& Zimg, int power) {
+  if constexpr (D == 2) {
+    T Zreal_tmp = Zreal * Zreal - Zimg * Zimg;
+    Zimg = 2 * Zreal * Zimg;  /* int factor: exact for all types, no conversion in the loop */
+    Zreal = Zreal_tmp;
+  } else {
+    const int n = (D > 0) ? D : power;
+    T Preal = Zreal, Pimg = Zimg;
+    for (int k = 1; k < n; ++k) {
+      T Preal_tmp = Preal * Zreal - Pimg * Zimg;
+      Pimg = Preal * Zimg + Pimg * Zreal;
+      Preal = Preal_tmp;
+    }
+    Zreal = Preal;
+    Zimg = Pimg;
+  }
+}
+
+constexpr int flop_per_iter(int power) {
+  /* z^2+c like mandelbrot_seq.c: 7, otherwise (d-1) complex multiplications+2; |z|^2: 3 */
+  return (power == 2) ? 10 : 6 * (power - 1) + 2 + 3;
+}
+
+
+/* iterate L pixels (one row, consecutive columns) in lock-step
+   same iteration count as mandelbrot_point(): the number of iterations before |z_{i+1}|^2 > bound,
+   once |z| exceeds the escape radius the orbit grows monotonically (or becomes inf/NaN) */
+template <typename T, int L, int D, int K>
+void escape_lanes(const T* Zreal0, const T* Zimg0, const T* Creal0, const T* Cimg0, int power, Titer maxiter,
+                  T Zabs2bound, Titer* M) {
+  using Tcount = typename Precision<T>::Tcount;  /* same width as T for the vectorizer */
+  T Zreal[L], Zimg[L], Creal[L], Cimg[L];  /* local copies, no aliasing */
+  Tcount iter[L], active[L];
+  for (int l = 0; l < L; ++l) {
+    Zreal[l] = Zreal0[l]; Zimg[l] = Zimg0[l];
+    Creal[l] = Creal0[l]; Cimg[l] = Cimg0[l];
+    iter[l] = 0;
+    active[l] = 1;
+  }
+  Titer i = 0;
+  if constexpr (K > 1) {
+    T Zreal_save[L], Zimg_save[L];
+    for (; i + K <= maxiter; i += K) {
+      for (int l = 0; l < L; ++l) {
+        Zreal_save[l] = Zreal[l];
+        Zimg_save[l] = Zimg[l];
+      }
+      for (int k = 0; k < K; ++k) {  /* no escape test, no dependency on a branch */
+        for (int l = 0; l < L; ++l) {
+          zpow<D>(Zreal[l], Zimg[l], power);
+          Zreal[l] = Zreal[l] + Creal[l];
+          Zimg[l] = Zimg[l] + Cimg[l];
+        }
+      }
+      Tcount numinside = 0;
+      for (int l = 0; l < L; ++l) numinside += Zreal[l] * Zreal[l] + Zimg[l] * Zimg[l] <= Zabs2bound;
+      if (numinside == L) {
+        for (int l = 0; l < L; ++l) iter[l] += K * active[l];
+        continue;
+      }
+      /* overshoot: roll back and repeat the K iterations with an escape test per iteration */
+      Tcount numactive = 0;
+      for (int l = 0; l < L; ++l) {
+        Zreal[l] = Zreal_save[l];
+        Zimg[l] = Zimg_save[l];
+      }
+      for (int k = 0; k < K; ++k) {
+        for (int l = 0; l < L; ++l) {
+          zpow<D>(Zreal[l], Zimg[l], power);
+          Zreal[l] = Zreal[l] + Creal[l];
+          Zimg[l] = Zimg[l] + Cimg[l];
+          active[l] &= Zreal[l] * Zreal[l] + Zimg[l] * Zimg[l] <= Zabs2bound;
+          iter[l] += active[l];
+        }
+      }
+      for (int l = 0; l < L; ++l) {
+        if (!active[l]) {  /* park at the fixed point 0 */
+          Zreal[l] = 0.; Zimg[l] = 0.;
+          Creal[l] = 0.; Cimg[l] = 0.;
+        }
+        numactive += active[l];
+      }
+      if (numactive == 0) {
+        i = maxiter;
+        break;
+      }
+    }
+  }
+  for (; i < maxiter; ++i) {  /* K==1 or the rest */
+    Tcount numactive = 0;
+    for (int l = 0; l < L; ++l) {
+      zpow<D>(Zreal[l], Zimg[l], power);
+      Zreal[l] = Zreal[l] + Creal[l];
+      Zimg[l] = Zimg[l] + Cimg[l];
+      active[l] &= Zreal[l] * Zreal[l] + Zimg[l] * Zimg[l] <= Zabs2bound;
+      iter[l] += active[l];
+      numactive += active[l];
+    }
+    if (numactive == 0) break;
+  }
+  for (int l = 0; l < L; ++l) M[l] = static_cast<Titer>(iter[l]);
+}
+
+double escapebound(const ViewDD& v, const Tparams& par, bool julia) {
+  double Zabs2bound = v.Zabs2bound;
+  if (julia) {  /* escape radius max(2,|c|) */
+    double Jreal = dd_to_double(par.Jreal), Jimg = dd_to_double(par.Jimg);
+    Zabs2bound = std::max(Zabs2bound, Jreal * Jreal + Jimg * Jimg);
+  }
+  return Zabs2bound;
+}
+
+template <typename T, int D, bool JULIA, int K>
+unsigned long render(const ViewDD& v, const Tparams& par, Titer* M) {
+  constexpr int L = Precision<T>::lanes;
+  const T bound = T(escapebound(v, par, JULIA));
+  unsigned long sumiter = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+ : sumiter)
+#endif
+  for (Tindex row = 0; row < v.numrows; ++row) {
+    T Zreal[L], Zimg[L], Creal[L], Cimg[L];
+    Titer iter[L];
+    const T Prow = v.Cimg<T>(row);
+    Titer* Mrow = M + colrow2index(0, row, v.numcolumns);
+    for (Tindex column = 0; column < v.numcolumns; column += L) {
+      const Tindex n = std::min<Tindex>(L, v.numcolumns - column);
+      for (int l = 0; l < L; ++l) {  /* the tail repeats the last column */
+        T Pcolumn = v.Creal<T>(column + std::min<Tindex>(l, n - 1));
+        if (JULIA) {
+          Zreal[l] = Pcolumn; Zimg[l] = Prow;
+          Creal[l] = par.Creal<T>(); Cimg[l] = par.Cimg<T>();
+        } else {
+          Zreal[l] = 0.; Zimg[l] = 0.;
+          Creal[l] = Pcolumn; Cimg[l] = Prow;
+        }
+      }
+      escape_lanes<T, L, D, K>(Zreal, Zimg, Creal, Cimg, par.power, v.maxiter, bound, iter);
+      for (Tindex l = 0; l < n; ++l) {
+        Mrow[column + l] = iter[l];
+        sumiter += iter[l];
+      }
+    }
+  }
+  return sumiter;
+}
+
+
+/* dispatch table ===============================================================================*/
+using Trender = unsigned long (*)(const ViewDD&, const Tparams&, Titer*);
+
+struct Tkernel {
+  Tprec prec;
+  int power;  /* 0: generic */
+  bool julia;
+  int check;
+  Trender render;
+};
+
+template <typename T> constexpr Tprec precof();
+template <> constexpr Tprec precof<float>() { return Tprec::Float; }
+template <> constexpr Tprec precof<double>() { return Tprec::Double; }
+template <> constexpr Tprec precof<DDouble>() { return Tprec::DD; }
+template <> constexpr Tprec precof<Fixed>() { return Tprec::Fixed; }
+
+template <typename T, bool JULIA, int K, int... D>
+void addkernels(std::vector<Tkernel>& table, std::integer_sequence<int, D...>) {
+  (table.push_back({precof<T>(), D, JULIA, K, &render<T, D, JULIA, K>}), ...);
+}
+
+template <typename T, bool JULIA, int... K>
+void addkernels(std::vector<Tkernel>& table) {
+  /* powers 0 (generic), 2..MAXPOWER */
+  (addkernels<T, JULIA, K>(table, std::integer_sequence<int, 0, 2, 3, 4, 5, MAXPOWER>{}), ...);
+}
+
+const std::vector<Tkernel>& kerneltable() {
+  static std::vector<Tkernel> table;
+  if (table.empty()) {
+    addkernels<float, false, 1, 4, 8, 16>(table);
+    addkernels<float, true, 1, 4, 8, 16>(table);
+    addkernels<double, false, 1, 4, 8, 16>(table);
+    addkernels<double, true, 1, 4, 8, 16>(table);
+    addkernels<DDouble, false, 1, 4, 8, 16>(table);
+    addkernels<DDouble, true, 1, 4, 8, 16>(table);
+    addkernels<Fixed, false, 1>(table);  /* no overshoot, escaped lanes wrap around (unsigned) */
+    addkernels<Fixed, true, 1>(table);
+  }
+  return table;
+}
+
+const Tkernel& findkernel(Tprec prec, int power, bool julia, int check) {
+  /* exact power or generic, largest instantiated check interval <= check */
+  const Tkernel* best = nullptr;
+  for (const auto& k : kerneltable()) {
+    if (k.prec != prec || k.julia != julia || (k.power != power && k.power != 0) || k.check > check) continue;
+    if (!best || (k.power != 0 && best->power == 0) || (k.power == best->power && k.check > best->check))
+      best = &k;
+  }
+  return *best;
+}
+/*================================================================================================*/
+
+const char* precname(Tprec prec) {
+  switch (prec) {
+    case Tprec::Float: return Precision<float>::name;
+    case Tprec::Double: return Precision<double>::name;
+    case Tprec::Fixed: return Precision<Fixed>::name;
+    default: return Precision<DDouble>::name;
+  }
+}
+
+int requiredbits(const ViewDD& v) {
+  double spacing = v.spacing();
+  if (spacing <= 0.) return Precision<DDouble>::bits;
+  return static_cast<int>(std::ceil(std::log2(v.magnitude() / spacing))) + GUARDBITS;
+}
+
+Tindex countdiff(const Titer* M, const Titer* Mref, Tindex numelements, Titer& maxdiff) {
+  Tindex numdiff = 0;
+  maxdiff = 0;
+  for (Tindex i = 0; i < numelements; ++i) {
+    if (M[i] != Mref[i]) {
+      ++numdiff;
+      maxdiff = std::max(maxdiff, M[i] > Mref[i] ? M[i] - Mref[i] : Mref[i] - M[i]);
+    }
+  }
+  return numdiff;
+}
+
+Tprec select_precision(const ViewDD& v) {
+  int bits = requiredbits(v);
+  if (bits <= Precision<float>::bits) return Tprec::Float;
+  if (bits <= Precision<double>::bits) return Tprec::Double;
+  return Tprec::DD;
+}
+
+/* fixed-point scaling from the view bounds, then the view and Julia c as fixed
+   (numbers: CrealMin, CimgMin, CrealMax, CimgMax, Jreal, Jimg as given) */
+void fixedview(ViewDD& v, Tparams& par, bool julia, const char* const numbers[6]) {
+  double Rmax = std::sqrt(v.Zabs2bound), cmax = std::hypot(v.magnitude(), v.magnitude());
+  if (julia) {  /* z_0 is the pixel: the view bounds have to fit, too */
+    cmax = std::hypot(dd_to_double(par.Jreal), dd_to_double(par.Jimg));
+    Rmax = std::max({Rmax, cmax, std::hypot(v.magnitude(), v.magnitude())});
+  }
+  Fixed::setscale(Rmax, cmax, par.power);
+  Fixed::parse(numbers[0], v.FCrealMin);
+  Fixed::parse(numbers[1], v.FCimgMin);
+  Fixed::parse(numbers[2], v.FCrealMax);
+  Fixed::parse(numbers[3], v.FCimgMax);
+  Fixed::parse(numbers[4], par.FJreal);
+  Fixed::parse(numbers[5], par.FJimg);
+}
+
+
+/* C interface (mandelbrot_kernels.h) ===========================================================*/
+static void mbkview2viewdd(const Tmbkview* m, ViewDD& v, Tparams& par) {
+  const char* numbers[6] = {m->CrealMin, m->CimgMin, m->CrealMax, m->CimgMax
+                           ,m->julia ? m->Jreal : "0", m->julia ? m->Jimg : "0"};
+  v.numcolumns = m->numcolumns;
+  v.numrows = m->numrows;
+  v.maxiter = m->maxiter;
+  v.Zabs2bound = 2. * 2.;
+  dd_from_string(numbers[0], &v.CrealMin);
+  dd_from_string(numbers[1], &v.CimgMin);
+  dd_from_string(numbers[2], &v.CrealMax);
+  dd_from_string(numbers[3], &v.CimgMax);
+  par.power = std::max(1, m->power);
+  dd_from_string(numbers[4], &par.Jreal);
+  dd_from_string(numbers[5], &par.Jimg);
+  fixedview(v, par, m->julia, numbers);  /* sets Fixed::fracbits for the next render */
+}
+
+extern "C" unsigned int mbkernels_num(void) { return static_cast<unsigned int>(kerneltable().size()); }
+
+extern "C" Tmbkernelinfo mbkernels_info(unsigned int k) {
+  const Tkernel& kernel = kerneltable()[k];
+  return {precname(kernel.prec), kernel.power, kernel.julia, kernel.check};
+}
+
+extern "C" void mbkernels_view(Tmbkview* m, double* Creal, double* Cimg) {
+  ViewDD v;
+  Tparams par;
+  mbkview2viewdd(m, v, par);
+  m->Jrealvalue = dd_to_double(par.Jreal);
+  m->Jimgvalue = dd_to_double(par.Jimg);
+  m->Zabs2bound = escapebound(v, par, m->julia);
+  m->fracbits = Fixed::fracbits;
+  if (Creal)
+    for (Tindex column = 0; column < v.numcolumns; ++column) Creal[column] = v.Creal<double>(column);
+  if (Cimg)
+    for (Tindex row = 0; row < v.numrows; ++row) Cimg[row] = v.Cimg<double>(row);
+}
+
+extern "C" unsigned long mbkernels_render(unsigned int k, const Tmbkview* m, Titer* M) {
+  ViewDD v;
+  Tparams par;
+  mbkview2viewdd(m, v, par);
+  return kerneltable()[k].render(v, par, M);
+}
+/*================================================================================================*/
+
+
+#ifndef NOMAIN
+int main(int argc, char* argv[]) {
+  ViewDD v;
+  v.numcolumns = 400;
+  v.numrows = 400;
+  v.CrealMin = dd_from_double(-2.); v.CimgMin = dd_from_double(-2.);
+  v.CrealMax = dd_from_double(2.); v.CimgMax = dd_from_double(2.);
+  v.maxiter = 255;  /* <= 65535 */
+  v.Zabs2bound = 2. * 2.;
+  std::string filename = "mandelbrot.pgm";
+  std::string precarg = "auto";
+  bool validate = false, bench = false;
+  Tparams par;
+  par.power = 2;
+  par.Jreal = par.Jimg = dd_from_double(0.);
+  bool julia = false;
+  int check = 0;
+  const char* numbers[6] = {"-2", "-2", "2", "2", "0", "0"};  /* view, Julia c: for Fixed::parse() */
+
+  /* <key>=<value> options may follow (or precede) the positional arguments */
+  std::vector<char*> args;
+  for (int a = 0; a < argc; ++a) {
+    char* eq = strchr(argv[a], '=');
+    if (a == 0 || !eq) {
+      args.push_back(argv[a]);
+    } else if (!strncmp(argv[a], "d=", 2)) {
+      par.power = std::max(1, atoi(eq + 1));
+    } else if (!strncmp(argv[a], "julia=", 6)) {
+      julia = true;
+      int n = dd_from_string(eq + 1, &par.Jreal);
+      numbers[4] = eq + 1;
+      if (eq[1 + n] == ',') {
+        dd_from_string(eq + 2 + n, &par.Jimg);
+        numbers[5] = eq + 2 + n;
+      }
+    } else if (!strncmp(argv[a], "k=", 2)) {
+      check = std::max(0, atoi(eq + 1));
+    } else {
+      std::cout << "unknown option " << argv[a] << "\n";
+      return 1;
+    }
+  }
+  int nargs = static_cast<int>(args.size());
+
+  if (nargs > 1) {
+    if (nargs > 2) {
+      v.numcolumns = labs(atol(args[1]));
+      v.numrows = labs(atol(args[2]));
+    } else {
+      std::cout << "usage: " << argv[0] << " [<width> <height>] [<maxiter>] [<CrealMin> <CimgMin> <CrealMax> <CimgMax>]"
+                << " [<filename>] [auto|float|double|dd|fixed] [validate|bench] [d=<power>] [julia=<Creal>,<Cimg>] [k=<check interval>]\n";
+      return 0;
+    }
+    if (nargs > 3) v.maxiter = labs(atol(args[3]));
+    if (nargs > 7) {
+      dd_from_string(args[4], &v.CrealMin);
+      dd_from_string(args[5], &v.CimgMin);
+      dd_from_string(args[6], &v.CrealMax);
+      dd_from_string(args[7], &v.CimgMax);
+      for (int c = 0; c < 4; ++c) numbers[c] = args[4 + c];
+    }
+    if (nargs > 8) filename = args[8];
+    if (nargs > 9) precarg = args[9];
+    if (nargs > 10) {
+      validate = !strcmp(args[10], "validate");
+      bench = !strcmp(args[10], "bench");
+    }
+  }
+  if (v.maxiter > 65535) v.maxiter = 65535;  /* PGM maxval */
+
+  Tprec prec = select_precision(v);
+  if (precarg == "float") prec = Tprec::Float;
+  else if (precarg == "double") prec = Tprec::Double;
+  else if (precarg == "dd") prec = Tprec::DD;
+  else if (precarg == "fixed") prec = Tprec::Fixed;
+  fixedview(v, par, julia, numbers);
+  auto kernelcheck = [check](Tprec p) { return check > 0 ? check : (p == Tprec::Double ? 8 : 1); };
+  const Tkernel& kernel = findkernel(prec, par.power, julia, kernelcheck(prec));
+  const int flop = flop_per_iter(par.power);
+
+  Tindex numelements = v.numcolumns * v.numrows;
+  std::cout << "width x height:\t" << v.numcolumns << " x " << v.numrows << "\n";
+  std::cout << "C Range:\t" << dd_to_double(v.CrealMin) << " + " << dd_to_double(v.CimgMin) << " i\t-\t"
+            << dd_to_double(v.CrealMax) << " + " << dd_to_double(v.CimgMax) << " i\n";
+  std::cout << "max. iterations:\t" << v.maxiter << "\n";
+  std::cout << "pixel spacing:\t" << v.spacing() << "\t(" << requiredbits(v) << " mantissa bits required)\n";
+  std::cout << "precision:\t" << precname(prec) << (precarg == "auto" ? " (auto)" : "");
+  if (prec == Tprec::Fixed) std::cout << " (" << Fixed::fracbits << " fractional bits)";
+  std::cout << "\n";
+  if (prec == Tprec::Fixed && requiredbits(v) > Fixed::fracbits)
+    std::cout << "WARNING: view needs more fractional bits than fixed provides\n";
+  if (requiredbits(v) > Precision<DDouble>::bits)
+    std::cout << "WARNING: view needs more than double-double precision, use mandelbrot_deepzoom\n";
+  std::cout << "kernel:\t" << (julia ? "Julia" : "Mandelbrot") << " z^" << par.power << "+c";
+  if (julia) std::cout << " (c=" << dd_to_double(par.Jreal) << " + " << dd_to_double(par.Jimg) << " i)";
+  std::cout << ", check interval " << kernel.check << (kernel.power == 0 ? ", generic power" : "") << "\n";
+
+  Titer* M = (Titer*)malloc(numelements * sizeof(Titer));
+  if (!M) {
+    std::cout << "ERROR allocating memory (" << numelements * sizeof(Titer) << " Bytes)\n";
+    return 1;
+  }
+
+/*------------------------------------------------------------------------------------------------*/
+  auto start = std::chrono::steady_clock::now();
+  unsigned long sumiter = kernel.render(v, par, M);
+  auto end = std::chrono::steady_clock::now();
+/*------------------------------------------------------------------------------------------------*/
+  double time_diff = std::chrono::duration<double>(end - start).count();
+  std::cout << "Time:\t" << time_diff << "\n";
+  std::cout << "total number of iterations:\t" << sumiter << " (" << sumiter * flop << " FlOp)\n";
+  if (time_diff > 0.) std::cout << "FlOp/s:\t" << sumiter * static_cast<double>(flop) / time_diff << "\n";
+
+  if (validate) {
+    if (prec == Tprec::DD) {
+      std::cout << "validate:\tno precision higher than dd available\n";
+    } else {
+      Tprec higher = (prec == Tprec::Float) ? Tprec::Double : Tprec::DD;  /* fixed: up to 62 bits */
+      Titer* Mref = (Titer*)malloc(numelements * sizeof(Titer));
+      if (!Mref) {
+        std::cout << "ERROR allocating memory (" << numelements * sizeof(Titer) << " Bytes)\n";
+        return 1;
+      }
+      findkernel(higher, par.power, julia, kernelcheck(higher)).render(v, par, Mref);
+      Titer maxdiff;
+      Tindex numdiff = countdiff(M, Mref, numelements, maxdiff);
+      std::cout << "validate (" << precname(higher) << "):\t" << numdiff << " pixels differ ("
+                << 100. * numdiff / numelements << "%), max. difference " << maxdiff << " iterations\n";
+      free(Mref);
+    }
+  }
+
+  if (bench) {  /* throughput of float, double and fixed, differences relative to double */
+    Titer* Mbench[3];
+    const Tprec precs[3] = {Tprec::Double, Tprec::Float, Tprec::Fixed};
+    double time_double = 0.;
+    std::cout << "# precision\tcheck\ttime[s]\titerations/s\tFlOp/s\tspeedup\tpixels differing from double\n";
+    for (int b = 0; b < 3; ++b) {
+      Mbench[b] = (Titer*)malloc(numelements * sizeof(Titer));
+      if (!Mbench[b]) {
+        std::cout << "ERROR allocating memory (" << numelements * sizeof(Titer) << " Bytes)\n";
+        return 1;
+      }
+      const Tkernel& k = findkernel(precs[b], par.power, julia, kernelcheck(precs[b]));
+      double time_best = 0.;
+      unsigned long sumiter_bench = 0;
+      for (int r = 0; r < BENCHREPEAT; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        sumiter_bench = k.render(v, par, Mbench[b]);
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || t < time_best) time_best = t;
+      }
+      if (b == 0) time_double = time_best;
+      Titer maxdiff;
+      Tindex numdiff = countdiff(Mbench[b], Mbench[0], numelements, maxdiff);
+      std::cout << precname(precs[b]) << "\t" << k.check << "\t" << time_best << "\t" << sumiter_bench / time_best
+                << "\t" << sumiter_bench * static_cast<double>(flop) / time_best << "\t" << time_double / time_best
+                << "\t" << numdiff << "\n";
+    }
+    for (int b = 0; b < 3; ++b) free(Mbench[b]);
+  }
+
+  writePGM(M, v.maxiter, v.numcolumns, v.numrows, filename.c_str());
+  std::cout << "PGM file:\t" << filename << "\n";
+
+  free(M);
+  return 0;
+}
+#endif
@@ -0,0 +1,59 @@
+/* mandelbrot_kernels.h
+   C interface to the dispatch table of mandelbrot_kernels.cpp (validate.c)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	g++ -std=c++17 -march=native -O3 -fopenmp -DNOMAIN -c mandelbrot_kernels.cpp -o mandelbrot_kernels.o
+	gcc ... program.c mandelbrot_kernels.o ... -lm -lstdc++
+
+	Tmbkview v={numcolumns,numrows,maxiter,power,julia,"-2","-1.5","1","1.5","-0.8","0.156"};
+	mbkernels_view(&v,Creal,Cimg);	// once per view: outputs and pixel coordinates
+	for(k=0;k<mbkernels_num();++k)
+	{
+		Tmbkernelinfo info=mbkernels_info(k);	// kernels with info.julia==v.julia and
+		sumiter=mbkernels_render(k,&v,M);	// info.power==v.power or 0 (generic) only
+	}
+
+	The coordinates are parsed like the command line of mandelbrot_kernels (double-double,
+	fixed: Fixed::parse() with the scaling of the view). The outputs are what the kernels
+	actually use: the pixel coordinates as double (float: converted from these), Julia c,
+	the escape bound and the fractional bits of fixed.
+*/
+
+#ifndef MANDELBROT_KERNELS_H
+#define MANDELBROT_KERNELS_H
+
+#include "mandelbrot.h"	/* Tindex, Titer */
+
+typedef struct {
+	Tindex numcolumns, numrows;
+	Titer maxiter;	/* <= 65535 */
+	int power;	/* z^power+c */
+	int julia;	/* 0: Mandelbrot, 1: Julia with c=Jreal+Jimg*i */
+	const char *CrealMin, *CimgMin, *CrealMax, *CimgMax, *Jreal, *Jimg;	/* decimal numbers */
+	/* set by mbkernels_view() */
+	double Jrealvalue, Jimgvalue;	/* Julia c as double */
+	double Zabs2bound;	/* escape bound, Julia: max(2,|c|)^2 */
+	int fracbits;	/* fixed */
+} Tmbkview;
+
+typedef struct {
+	const char *prec;	/* float, double, dd, fixed */
+	int power;	/* 0: generic (runtime exponent) */
+	int julia;
+	int check;	/* check interval K */
+} Tmbkernelinfo;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned int mbkernels_num(void);
+Tmbkernelinfo mbkernels_info(unsigned int k);
+/* outputs of v, Creal[numcolumns] and Cimg[numrows] (row 0 is CimgMax) if not NULL */
+void mbkernels_view(Tmbkview *v, double *Creal, double *Cimg);
+/* render v with kernel k to M (numcolumns*numrows), returns the sum of the iterations */
+unsigned long mbkernels_render(unsigned int k, const Tmbkview *v, Titer *M);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_KERNELS_H */
@@ -0,0 +1,259 @@
+/* mandelbrot_loadgen.c
+   load generator for mandelbrot_server: latency percentiles and throughput
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -Wall -g -pthread mandelbrot_loadgen.c -o mandelbrot_loadgen
+	gcc -O2 -pthread mandelbrot_loadgen.c -o mandelbrot_loadgen
+
+	mandelbrot_loadgen <socketpath>|<port> [<numclients>] [<requests per client>] [<maxzoom>] [<maxiter>] [<seed>]
+
+	e.g.
+	$ ./mandelbrot_server /tmp/mandelbrot.sock 8 4096 &
+	$ ./mandelbrot_loadgen /tmp/mandelbrot.sock 32 200 6 1000
+
+	Each client (thread) opens one connection and sends its requests one after another
+	(closed loop, the next request after the response). The zoom level is uniformly
+	distributed in 0..<maxzoom>, x and y are uniform at that level, i.e. low zoom levels
+	are requested repeatedly (cache hits, concurrent duplicates) and high ones rarely.
+	The latencies of the successful requests (P5 response) are sorted for the percentiles,
+	failed requests only count as errors. The server statistics
+	(stats request) are printed at the end.
+*/
+
+#include<stdlib.h>	/* malloc(),free(),labs(),atol(),qsort(),rand_r() */
+#include<stdio.h>	/* printf() */
+#include<string.h>	/* memcpy(),memmove(),strspn() */
+#include<errno.h>
+#include<unistd.h>	/* read(),write(),close() */
+#include<sys/socket.h>
+#include<sys/un.h>	/* sockaddr_un */
+#include<netinet/in.h>	/* sockaddr_in */
+#include<arpa/inet.h>	/* htons(),htonl() */
+#include<pthread.h>
+
+#include "mandelbrot.h"	/* gettime() */
+
+#define MAXRESPONSE (128+2*4096*4096)
+
+typedef struct {
+	const char *address;
+	unsigned int id, seed;
+	unsigned long numrequests, errors, bytes;
+	unsigned long numsamples;	/* latencies recorded (successful requests) */
+	unsigned int maxzoom, maxiter;
+	double *latency;	/* [s] per successful request, numsamples */
+} Tclient;
+
+int connect_socket(const char *address)
+{	/* numeric: TCP port on the loopback interface, otherwise UNIX domain socket path */
+	int fd;
+	if(address[0] && strspn(address,"0123456789")==strlen(address))
+	{
+		struct sockaddr_in a;
+		fd=socket(AF_INET,SOCK_STREAM,0);
+		memset(&a,0,sizeof(a));
+		a.sin_family=AF_INET;
+		a.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+		a.sin_port=htons(atoi(address));
+		if(fd<0 || connect(fd,(struct sockaddr*)&a,sizeof(a))) return -1;
+	}
+	else
+	{
+		struct sockaddr_un a;
+		fd=socket(AF_UNIX,SOCK_STREAM,0);
+		memset(&a,0,sizeof(a));
+		a.sun_family=AF_UNIX;
+		strncpy(a.sun_path,address,sizeof(a.sun_path)-1);
+		if(fd<0 || connect(fd,(struct sockaddr*)&a,sizeof(a))) return -1;
+	}
+	return fd;
+}
+
+int recvall(int fd, void *buf, size_t size)
+{
+	char *b=(char*)buf;
+	while(size>0)
+	{
+		ssize_t n=recv(fd,b,size,0);
+		if(n<0 && errno==EINTR) continue;
+		if(n<=0) return -1;
+		b+=n; size-=n;
+	}
+	return 0;
+}
+
+/* send request line, receive "OK <size>\n<data>", returns the size or -1 */
+long request(int fd, const char *line, unsigned char *buf, size_t bufsize)
+{
+	char header[64];
+	size_t n=0, len=strlen(line);
+	if(send(fd,line,len,MSG_NOSIGNAL)!=(ssize_t)len) return -1;
+	do
+	{	/* header is short, read it Byte by Byte */
+		if(recvall(fd,header+n,1)) return -1;
+	} while(header[n++]!='\n' && n<sizeof(header)-1);
+	header[n]='\0';
+	unsigned long size;
+	if(sscanf(header,"OK %lu",&size)!=1 || size>bufsize) return -1;
+	if(recvall(fd,buf,size)) return -1;
+	return (long)size;
+}
+
+void* client(void *arg)
+{
+	Tclient *c=(Tclient*)arg;
+	unsigned char *buf=(unsigned char*)malloc(MAXRESPONSE);
+	int fd=connect_socket(c->address);
+	unsigned long r;
+	if(!buf || fd<0)
+	{
+		printf("ERROR client %u: no connection to %s\n",c->id,c->address);
+		c->errors=c->numrequests;
+		free(buf);
+		return NULL;
+	}
+	for(r=0;r<c->numrequests;++r)
+	{
+		char line[128];
+		unsigned int z=rand_r(&c->seed)%(c->maxzoom+1);
+		unsigned long x=((unsigned long)rand_r(&c->seed)<<31|rand_r(&c->seed))%(1UL<<z);
+		unsigned long y=((unsigned long)rand_r(&c->seed)<<31|rand_r(&c->seed))%(1UL<<z);
+		snprintf(line,sizeof(line),"%u %lu %lu %u\n",z,x,y,c->maxiter);
+		double t0=gettime();
+		long size=request(fd,line,buf,MAXRESPONSE);
+		double t=gettime()-t0;
+		if(size<2 || buf[0]!='P' || buf[1]!='5')
+		{
+			++c->errors;
+			if(size<0)
+			{	/* connection lost */
+				close(fd);
+				fd=connect_socket(c->address);
+				if(fd<0)
+				{
+					c->errors+=c->numrequests-r-1;
+					break;
+				}
+			}
+		}
+		else
+		{
+			c->bytes+=size;
+			c->latency[c->numsamples++]=t;
+		}
+	}
+	if(fd>=0) close(fd);
+	free(buf);
+	return NULL;
+}
+
+int compare_double(const void *a, const void *b)
+{
+	double da=*(const double*)a, db=*(const double*)b;
+	return (da>db)-(da<db);
+}
+
+static inline double percentile(const double *sorted, unsigned long n, double p)
+{	/* nearest rank */
+	unsigned long k=(unsigned long)(p/100.*n+0.999999);
+	if(k<1) k=1;
+	if(k>n) k=n;
+	return sorted[k-1];
+}
+
+
+int main(int argc, char *argv[])
+{
+	const char *address;
+	unsigned int numclients=16, maxzoom=6, maxiter=256, seed=1;
+	unsigned long requestsperclient=100;
+
+	if (argc<2)
+	{
+		printf("usage: %s <socketpath>|<port> [<numclients>] [<requests per client>] [<maxzoom>] [<maxiter>] [<seed>]\n",argv[0]);
+		exit(0);
+	}
+	address=argv[1];
+	if (argc>2) numclients=labs(atol(argv[2]));
+	if (argc>3) requestsperclient=labs(atol(argv[3]));
+	if (argc>4) maxzoom=labs(atol(argv[4]));
+	if (argc>5) maxiter=labs(atol(argv[5]));
+	if (argc>6) seed=labs(atol(argv[6]));
+	if(numclients<1) numclients=1;
+	if(requestsperclient<1) requestsperclient=1;
+	if(maxzoom>30) maxzoom=30;
+	if(maxiter<1) maxiter=1;
+
+	printf("server:\t%s\n",address);
+	printf("clients:\t%u x %lu requests\n",numclients,requestsperclient);
+	printf("zoom levels:\t0...%u\tmaxiter: %u\n",maxzoom,maxiter);
+
+	unsigned long numrequests=numclients*requestsperclient;
+	Tclient *clients=(Tclient*)malloc(numclients*sizeof(Tclient));
+	pthread_t *threads=(pthread_t*)malloc(numclients*sizeof(pthread_t));
+	double *latency=(double*)malloc(numrequests*sizeof(double));
+	if(!clients || !threads || !latency)
+	{
+		printf("ERROR allocating memory for %lu requests\n",numrequests);
+		exit(1);
+	}
+
+/*------------------------------------------------------------------------------------------------*/
+	double time_start=gettime();
+	unsigned int i;
+	for(i=0;i<numclients;++i)
+	{
+		Tclient *c=&clients[i];
+		c->address=address;
+		c->id=i;
+		c->seed=seed*7919+i;
+		c->numrequests=requestsperclient;
+		c->errors=c->bytes=c->numsamples=0;
+		c->maxzoom=maxzoom;
+		c->maxiter=maxiter;
+		c->latency=latency+i*requestsperclient;
+		pthread_create(&threads[i],NULL,client,c);
+	}
+	for(i=0;i<numclients;++i) pthread_join(threads[i],NULL);
+	double time_diff=gettime()-time_start;
+/*------------------------------------------------------------------------------------------------*/
+
+	unsigned long errors=0, bytes=0, numsamples=0;
+	for(i=0;i<numclients;++i)
+	{	/* gather the recorded latencies of the clients at the front */
+		errors+=clients[i].errors;
+		bytes+=clients[i].bytes;
+		memmove(latency+numsamples,clients[i].latency,clients[i].numsamples*sizeof(double));
+		numsamples+=clients[i].numsamples;
+	}
+	qsort(latency,numsamples,sizeof(double),compare_double);
+	printf("Time:\t%g\n",time_diff);
+	printf("requests:\t%lu (%lu errors)\n",numrequests,errors);
+	printf("tiles/s:\t%g\n",(numrequests-errors)/time_diff);
+	printf("MB/s:\t%g\n",bytes/time_diff/1.E6);
+	if(numsamples>0)
+		printf("latency [ms]:\tp50 %g\tp90 %g\tp99 %g\tmax %g\t(%lu successful requests)\n"
+		      ,percentile(latency,numsamples,50.)*1.E3,percentile(latency,numsamples,90.)*1.E3
+		      ,percentile(latency,numsamples,99.)*1.E3,latency[numsamples-1]*1.E3,numsamples);
+	else
+		printf("latency [ms]:\tno successful requests\n");
+
+	int fd=connect_socket(address);
+	if(fd>=0)
+	{
+		unsigned char stats[256];
+		long n=request(fd,"stats\n",stats,sizeof(stats)-1);
+		if(n>0)
+		{
+			stats[n]='\0';
+			printf("server:\t%s",(char*)stats);
+		}
+		close(fd);
+	}
+
+	free(latency);
+	free(threads);
+	free(clients);
+
+	return 0;
+}
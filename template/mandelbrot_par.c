@@ -0,0 +1,167 @@
+/* mandelbrot_par.c
+   calculate Mandelbrot set  (OpenMP version of mandelbrot_seq.c with per-thread statistics)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -Wall -g -fopenmp mandelbrot_par.c -o mandelbrot_par
+	gcc -march=native -O3 -fopenmp mandelbrot_par.c -o mandelbrot_par
+	gcc -march=native -O3 -fopenmp -pthread -DUSE_TRACE mandelbrot_par.c -o mandelbrot_par
+
+	mandelbrot_par [<width> <height>] [<maxiter>] [<CrealMin> <CimgMin> <CrealMax> <CimgMax>] [<filename>]
+
+	e.g.
+	$ OMP_NUM_THREADS=8 ./mandelbrot_par 1920 1080 255 -2 -1 1.5555556 1 mandelbrot3.pgm
+	$ OMP_NUM_THREADS=8 OMP_SCHEDULE=static ./mandelbrot_par 1920 1080 255 -2 -1 1.5555556 1
+	$ OMP_NUM_THREADS=8 TRACEFILE=mandelbrot_par.json ./mandelbrot_par 1920 1080	// USE_TRACE
+
+	The rows are distributed with schedule(runtime), i.e. OMP_SCHEDULE (default dynamic,1).
+	C is computed from the pixel index (see mandelbrot.h), not summed up as in mandelbrot_seq.c,
+	such that the rows are independent.
+	Each thread counts its iterations in a private variable inside the kernel loop and stores
+	it once in its own (cache line padded) statistics entry. These are reduced after the
+	parallel region, i.e. there is no extra pass over M and the total is an unsigned long for
+	any image size. The table lists rows, iterations, time and FlOp/s per thread.
+	USE_TRACE: timeline (trace.h) of the fork (region start per thread), each row and the wait in
+	the final barrier, i.e. stragglers and the load imbalance of the schedule.
+*/
+
+#include<stdlib.h>	/* malloc(),free(),labs(),atol(),atof() */
+#include<stdio.h>	/* printf() */
+#include<string.h>	/* memset() */
+#ifdef _OPENMP
+#include<omp.h>
+#endif
+
+#include "mandelbrot.h"
+#include "trace.h"
+
+#define CACHELINESIZE 64
+
+typedef struct {
+	unsigned long sumiter, rows;
+	double time;
+	char padding[CACHELINESIZE-2*sizeof(unsigned long)-sizeof(double)];	/* no false sharing */
+} Tthreadstat;
+
+
+int main(int argc, char *argv[])
+{
+	Tindex numcolumns=400;
+	Tindex numrows=400;
+	Tfloat CrealMin=-2., CimgMin=-2.;
+	Tfloat CrealMax=2., CimgMax=2.;
+	Titer maxiter=255;	/* <= 65535 */
+	char filename_default[]="mandelbrot.pgm";
+	char* filename=filename_default;
+
+	if (argc>1)
+	{
+		if (argc>2)
+		{
+			numcolumns=labs(atol(argv[1]));
+			numrows=labs(atol(argv[2]));
+		}
+		else
+		{
+			printf("usage: %s [<width> <height>] [<maxiter>] [<CrealMin> <CimgMin> <CrealMax> <CimgMax>] [<filename>]\n",argv[0]);
+			exit(0);
+		}
+		if (argc>3) maxiter=labs(atol(argv[3]));
+		if (argc>7)
+		{
+			CrealMin=atof(argv[4]);
+			CimgMin=atof(argv[5]);
+			CrealMax=atof(argv[6]);
+			CimgMax=atof(argv[7]);
+		}
+		if (argc>8) filename=argv[8];
+	}
+	if(maxiter>65535) maxiter=65535;
+	TRACE_INIT(getenv("TRACEFILE"));
+
+	int numthreads=1;
+#ifdef _OPENMP
+	numthreads=omp_get_max_threads();
+#endif
+	Tview v;
+	view_init(&v,numcolumns,numrows,maxiter,CrealMin,CimgMin,CrealMax,CimgMax);
+
+	printf("width x height:\t%lu x %lu\n",numcolumns,numrows);
+	printf("C Range:\t%g + %g i\t-\t%g + %g i\n",CrealMin,CimgMin,CrealMax,CimgMax);
+	printf("max. iterations:\t%u\n",maxiter);
+	printf("threads:\t%d\n",numthreads);
+
+	unsigned long arraysize=numcolumns*numrows*sizeof(Titer);
+	Titer *M=(Titer*)malloc(arraysize);
+	Tthreadstat *stat=(Tthreadstat*)aligned_alloc(CACHELINESIZE,numthreads*sizeof(Tthreadstat));
+	if(!M || !stat)
+	{
+		printf("ERROR allocating memory (%lu Bytes)\n",arraysize);
+		exit(1);
+	}
+	memset(stat,0,numthreads*sizeof(Tthreadstat));
+	int teamsize=1;	/* actual team, <=numthreads (e.g. OMP_DYNAMIC) */
+	Tfloat dCreal=view_dCreal(&v), dCimg=view_dCimg(&v);
+
+/*------------------------------------------------------------------------------------------------*/
+	double time_start=gettime();
+	TRACE_START(trace_fork);
+#pragma omp parallel
+	{
+		int t=0;
+#ifdef _OPENMP
+		t=omp_get_thread_num();
+		if(t==0) teamsize=omp_get_num_threads();
+#endif
+		TRACE_SPAN("fork",trace_fork,t);
+		TRACE_THREADNAME("omp",t);
+		double time_thread=gettime();
+		unsigned long sumiter=0, rows=0;	/* private */
+		Tindex row, column;
+#pragma omp for schedule(runtime) nowait
+		for(row=0;row<numrows;++row)
+		{
+			TRACE_START(trace_row);
+			Tfloat Cimg=CimgMax+row*dCimg;
+			Titer *Mact=M+colrow2index(0,row,numcolumns);
+			for(column=0;column<numcolumns;++column)
+			{
+				Titer i=mandelbrot_point(CrealMin+column*dCreal,Cimg,maxiter,v.Zabs2bound);
+				Mact[column]=i;
+				sumiter+=i;
+			}
+			++rows;
+			TRACE_SPAN("row",trace_row,(long)row);
+		}
+		stat[t].sumiter=sumiter;
+		stat[t].rows=rows;
+		stat[t].time=gettime()-time_thread;
+#ifdef USE_TRACE
+		TRACE_START(trace_barrier);
+#pragma omp barrier
+		TRACE_SPAN("barrier",trace_barrier,-1);
+#endif
+	}
+	double time_diff=gettime()-time_start;
+/*------------------------------------------------------------------------------------------------*/
+	printf("Time:\t%g\n",time_diff);
+
+	unsigned long sumiter=0;
+	int t;
+	if(teamsize<numthreads) printf("team:\t%d threads\n",teamsize);
+	printf("# thread\trows\titerations\ttime[s]\tFlOp/s\tshare[%%]\n");
+	for(t=0;t<teamsize;++t) sumiter+=stat[t].sumiter;
+	for(t=0;t<teamsize;++t)
+		printf("%d\t%lu\t%lu\t%g\t%g\t%g\n",t,stat[t].rows,stat[t].sumiter,stat[t].time
+		      ,stat[t].time>0.?stat[t].sumiter*10./stat[t].time:0.,sumiter>0?100.*stat[t].sumiter/sumiter:0.);
+	printf("total number of iterations:\t%lu (%lu FlOp)\n",sumiter,sumiter*10);
+	if(time_diff>0.) printf("FlOp/s:\t%g\n",sumiter*10./time_diff);
+
+	writePGM(M,maxiter,numcolumns,numrows,filename);
+	printf("PGM file:\t%s\n",filename);
+	TRACE_WRITE();
+
+	free(stat);
+	free(M);
+
+	return 0;
+}
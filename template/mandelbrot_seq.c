@@ -166,6 +166,7 @@ int main(int argc, char *argv[])
 	if(numcolumns>1) dCreal=(CrealMax-CrealMin)/(numcolumns-1);
 	Tfloat dCimg=0.;
 	if(numrows>1) dCimg=(CimgMin-CimgMax)/(numrows-1);
+	unsigned long sumiter=0;	/* accumulated in the kernel, no extra pass over M */
 	
 /*------------------------------------------------------------------------------------------------*/	
 #ifdef USE_CLOCK
@@ -194,6 +195,7 @@ int main(int argc, char *argv[])
 				if(Zabs2>Zabs2bound) break;
 			}
 			*(Mact++)=i;	/* *Mact=i; ++Mact; */
+			sumiter+=i;
 			/*M[colrow2index(column,row,numcolumns)]=i;*/
 			Creal+=dCreal;
 		}
@@ -212,11 +214,6 @@ int main(int argc, char *argv[])
 #endif
 /*------------------------------------------------------------------------------------------------*/
 	
-	unsigned long sumiter=0;
-	for(i=0;i<numelements;++i)
-	{
-		sumiter+=M[i];
-	}
 	printf("total number of iterations:\t%lu (%lu FlOp)\n",sumiter,sumiter*10);
 	if(time_diff>0.) printf("FlOp/s:\t%g\n",sumiter*10./time_diff);
 	
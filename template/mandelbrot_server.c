@@ -0,0 +1,607 @@
+/* mandelbrot_server.c
+   serve Mandelbrot map tiles (binary PGM) on a local socket
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -Wall -g -pthread mandelbrot_server.c -o mandelbrot_server
+	gcc -march=native -O3 -pthread mandelbrot_server.c -o mandelbrot_server
+
+	mandelbrot_server <socketpath>|<port> [<numthreads>] [<cachetiles>] [<tilesize>]
+
+	e.g.
+	$ ./mandelbrot_server /tmp/mandelbrot.sock 8 4096 &
+	$ ./mandelbrot_loadgen /tmp/mandelbrot.sock 32 200
+	$ ./mandelbrot_server 8080 &	(TCP, listens on 127.0.0.1 only)
+	stop with SIGINT/SIGTERM (prints the cache statistics)
+
+	protocol: one request per line, any number of requests per connection
+		<z> <x> <y> <maxiter>\n  ->  OK <size>\n + <size> Bytes binary PGM (P5)
+		stats\n                  ->  OK <size>\n + <size> Bytes text
+		otherwise                ->  ERR <message>\n
+	At zoom level z (0<=z<=MAXZOOM) the square -2..2 x -2..2 is divided into 2^z x 2^z tiles of
+	<tilesize> x <tilesize> pixels, x increases with Creal, y downwards (y=0 starts at Cimg=2).
+
+	The main thread polls the listening socket and the idle connections. A readable connection
+	is queued for the <numthreads> workers (bounded pool), which read and answer one request and
+	hand the connection back. A tile is computed by one worker with the kernel of
+	mandelbrot_seq.c (see mandelbrot.h) and encoded once:
+	- the LRU cache keeps the last <cachetiles> encoded tiles
+	- a request for a tile that is being computed (in flight) waits for that result
+	  (coalescing) instead of computing it again
+	Entries are reference counted, i.e. an evicted tile is freed after the last send.
+	At most MAXCONNECTIONS connections are open (idle, queued or in service), further ones wait
+	in the listen backlog. So the ready queue never fills up and the pipe handing connections
+	back (MAXCONNECTIONS pointers, below the 64 KiB pipe capacity) never blocks a worker.
+*/
+
+#include<stdlib.h>	/* malloc(),free(),labs(),atol(),strtoul() */
+#include<stdio.h>	/* printf(),snprintf() */
+#include<string.h>	/* memchr(),memmove(),strspn(),strcmp() */
+#include<errno.h>
+#include<signal.h>	/* sigaction() */
+#include<unistd.h>	/* sysconf(),pipe(),read(),write(),close(),unlink() */
+#include<poll.h>
+#include<sys/socket.h>
+#include<sys/un.h>	/* sockaddr_un */
+#include<netinet/in.h>	/* sockaddr_in */
+#include<arpa/inet.h>	/* htons(),htonl() */
+#include<pthread.h>
+
+#include "mandelbrot.h"
+#include "queue.h"
+
+#define DEFAULT_TILESIZE 256
+#define DEFAULT_CACHETILES 1024
+#define MAXZOOM 40
+#define MAXCONNECTIONS 1024
+#define MAXREQUESTLEN 128
+
+
+/* tile cache ===================================================================================*/
+typedef struct {
+	unsigned long x, y;
+	unsigned int z, maxiter;
+} Ttilekey;
+
+typedef struct Tentry {
+	Ttilekey key;
+	int ready, evicted;
+	unsigned int refcount;	/* requests using the entry */
+	unsigned char *buf;	/* encoded tile */
+	size_t size;
+	struct Tentry *hnext;	/* hash bucket chain */
+	struct Tentry *prev, *next;	/* LRU list, head is the most recently used */
+} Tentry;
+
+typedef struct {
+	Tentry **buckets;
+	unsigned long numbuckets, count, capacity;
+	Tentry *head, *tail;
+	pthread_mutex_t mtx;
+	pthread_cond_t ready;	/* an in-flight tile is done */
+	unsigned long hits, misses, coalesced, evictions;
+} Tcache;
+
+void cache_init(Tcache *c, unsigned long capacity)
+{
+	c->capacity=capacity;
+	c->numbuckets=2*capacity+1;
+	c->buckets=(Tentry**)calloc(c->numbuckets,sizeof(Tentry*));
+	if(!c->buckets)
+	{
+		printf("ERROR allocating cache\n");
+		exit(1);
+	}
+	c->count=0;
+	c->head=c->tail=NULL;
+	c->hits=c->misses=c->coalesced=c->evictions=0;
+	pthread_mutex_init(&c->mtx,NULL);
+	pthread_cond_init(&c->ready,NULL);
+}
+
+static inline unsigned long key_hash(const Tcache *c, Ttilekey k)
+{
+	unsigned long h=k.x*0x9e3779b97f4a7c15UL;
+	h^=k.y+0x7f4a7c159e3779b9UL+(h<<6)+(h>>2);
+	h^=((unsigned long)k.z<<32|k.maxiter)+(h<<6)+(h>>2);
+	return h%c->numbuckets;
+}
+
+static inline int key_equal(Ttilekey a, Ttilekey b)
+{
+	return a.x==b.x && a.y==b.y && a.z==b.z && a.maxiter==b.maxiter;
+}
+
+static inline void lru_unlink(Tcache *c, Tentry *e)
+{
+	if(e->prev) e->prev->next=e->next; else c->head=e->next;
+	if(e->next) e->next->prev=e->prev; else c->tail=e->prev;
+	e->prev=e->next=NULL;
+}
+
+static inline void lru_pushfront(Tcache *c, Tentry *e)
+{
+	e->prev=NULL;
+	e->next=c->head;
+	if(c->head) c->head->prev=e; else c->tail=e;
+	c->head=e;
+}
+
+static inline void entry_free(Tentry *e)
+{
+	free(e->buf);
+	free(e);
+}
+
+/* the following functions are called with c->mtx locked */
+Tentry* cache_find(Tcache *c, Ttilekey k)
+{
+	Tentry *e;
+	for(e=c->buckets[key_hash(c,k)];e;e=e->hnext)
+		if(key_equal(e->key,k)) return e;
+	return NULL;
+}
+
+Tentry* cache_insert(Tcache *c, Ttilekey k)
+{	/* new in-flight entry, referenced by the caller */
+	Tentry *e=(Tentry*)calloc(1,sizeof(Tentry));
+	if(!e)
+	{
+		printf("ERROR allocating cache entry\n");
+		exit(1);
+	}
+	unsigned long b=key_hash(c,k);
+	e->key=k;
+	e->refcount=1;
+	e->hnext=c->buckets[b];
+	c->buckets[b]=e;
+	lru_pushfront(c,e);
+	++c->count;
+	return e;
+}
+
+void cache_evict(Tcache *c)
+{	/* least recently used ready tiles, in use tiles are only removed from the cache */
+	Tentry *e=c->tail;
+	while(c->count>c->capacity && e)
+	{
+		Tentry *prev=e->prev;
+		if(e->ready)
+		{
+			Tentry **p=&c->buckets[key_hash(c,e->key)];
+			while(*p!=e) p=&(*p)->hnext;
+			*p=e->hnext;
+			lru_unlink(c,e);
+			--c->count;
+			++c->evictions;
+			e->evicted=1;
+			if(e->refcount==0) entry_free(e);
+		}
+		e=prev;
+	}
+}
+
+void entry_release(Tentry *e)
+{
+	if(--e->refcount==0 && e->evicted) entry_free(e);
+}
+
+void cache_destroy(Tcache *c)
+{
+	while(c->head)
+	{
+		Tentry *e=c->head;
+		lru_unlink(c,e);
+		entry_free(e);
+	}
+	free(c->buckets);
+	pthread_cond_destroy(&c->ready);
+	pthread_mutex_destroy(&c->mtx);
+}
+
+
+/* server =======================================================================================*/
+typedef struct {
+	int fd;
+	size_t len;	/* Bytes in buf */
+	char buf[MAXREQUESTLEN];
+} Tconnection;
+
+typedef struct {
+	Tindex tilesize;
+	Tcache cache;
+	Tqueue ready;	/* readable connections */
+	int wakeup[2];	/* pipe: connections handed back to the poll loop */
+	unsigned long requests;	/* atomic */
+	unsigned long numopen;	/* atomic: idle, queued and in service connections, <=MAXCONNECTIONS */
+} Tserver;
+
+typedef struct {
+	Tserver *s;
+	Titer *M;	/* tilesize x tilesize */
+	unsigned long tiles;	/* computed by this worker */
+	double time_compute;
+} Tworker;
+
+static volatile sig_atomic_t stop=0;
+
+static void stophandler(int sig)
+{
+	(void)sig;
+	stop=1;
+}
+
+int sendall(int fd, const void *buf, size_t size)
+{
+	const char *b=(const char*)buf;
+	while(size>0)
+	{
+		ssize_t n=send(fd,b,size,MSG_NOSIGNAL);
+		if(n<0)
+		{
+			if(errno==EINTR) continue;
+			return -1;
+		}
+		b+=n; size-=n;
+	}
+	return 0;
+}
+
+int sendresponse(int fd, const void *buf, size_t size)
+{
+	char header[32];
+	int n=snprintf(header,sizeof(header),"OK %lu\n",(unsigned long)size);
+	if(sendall(fd,header,n)) return -1;
+	return sendall(fd,buf,size);
+}
+
+size_t render_tile(Tworker *w, Ttilekey k, unsigned char **buf)
+{	/* calculate and encode a tile, returns the PGM size */
+	Tindex tilesize=w->s->tilesize;
+	Tview v;
+	Tfloat span=4./(double)(1UL<<k.z), pixel=span/tilesize;
+	Tfloat CrealMin=-2.+k.x*span, CimgMax=2.-k.y*span;
+	view_init(&v,tilesize,tilesize,k.maxiter,CrealMin,CimgMax-span+pixel,CrealMin+span-pixel,CimgMax);
+	double t0=gettime();
+	mandelbrot_rows(&v,w->M,0,tilesize);
+	w->time_compute+=gettime()-t0;
+	++w->tiles;
+	*buf=(unsigned char*)malloc(sizePGM5(k.maxiter,tilesize,tilesize));
+	if(!*buf)
+	{
+		printf("ERROR allocating tile\n");
+		exit(1);
+	}
+	char comment[64];
+	snprintf(comment,sizeof(comment),"tile %u/%lu/%lu maxiter %u",k.z,k.x,k.y,k.maxiter);
+	return encodePGM5(w->M,k.maxiter,tilesize,tilesize,comment,*buf);
+}
+
+int serve_tile(Tworker *w, int fd, Ttilekey k)
+{
+	Tcache *c=&w->s->cache;
+	pthread_mutex_lock(&c->mtx);
+	Tentry *e=cache_find(c,k);
+	if(e)
+	{
+		++e->refcount;
+		if(e->ready)
+		{
+			++c->hits;
+			lru_unlink(c,e);
+			lru_pushfront(c,e);
+		}
+		else
+		{	/* in flight */
+			++c->coalesced;
+			while(!e->ready) pthread_cond_wait(&c->ready,&c->mtx);
+		}
+		pthread_mutex_unlock(&c->mtx);
+	}
+	else
+	{
+		++c->misses;
+		e=cache_insert(c,k);
+		pthread_mutex_unlock(&c->mtx);
+		unsigned char *buf;
+		size_t size=render_tile(w,k,&buf);
+		pthread_mutex_lock(&c->mtx);
+		e->buf=buf;
+		e->size=size;
+		e->ready=1;
+		pthread_cond_broadcast(&c->ready);
+		cache_evict(c);
+		pthread_mutex_unlock(&c->mtx);
+	}
+	int err=sendresponse(fd,e->buf,e->size);	/* e is referenced, buf stays valid */
+	pthread_mutex_lock(&c->mtx);
+	entry_release(e);
+	pthread_mutex_unlock(&c->mtx);
+	return err;
+}
+
+int serve_request(Tworker *w, int fd, char *line)
+{	/* returns 0 if the connection can be used for further requests */
+	Tserver *s=w->s;
+	Ttilekey k;
+	char *p=line, *end;
+	__sync_add_and_fetch(&s->requests,1);
+	if(!strcmp(line,"stats"))
+	{
+		Tcache *c=&s->cache;
+		char text[256];
+		pthread_mutex_lock(&c->mtx);
+		int n=snprintf(text,sizeof(text),"requests %lu\thits %lu\tmisses %lu\tcoalesced %lu\tevictions %lu\tcached %lu\n"
+		              ,s->requests,c->hits,c->misses,c->coalesced,c->evictions,c->count);
+		pthread_mutex_unlock(&c->mtx);
+		return sendresponse(fd,text,n);
+	}
+	k.z=strtoul(p,&end,10);
+	int valid=(end!=p);
+	p=end; k.x=strtoul(p,&end,10); valid=valid && end!=p;
+	p=end; k.y=strtoul(p,&end,10); valid=valid && end!=p;
+	p=end; k.maxiter=strtoul(p,&end,10); valid=valid && end!=p && *end=='\0';
+	const char *error=NULL;
+	if(!valid) error="usage: <z> <x> <y> <maxiter> | stats";
+	else if(k.z>MAXZOOM) error="zoom level too large";
+	else if(k.x>=(1UL<<k.z) || k.y>=(1UL<<k.z)) error="tile outside of the zoom level";
+	else if(k.maxiter<1 || k.maxiter>65535) error="maxiter has to be 1..65535";
+	if(error)
+	{
+		char text[MAXREQUESTLEN];
+		int n=snprintf(text,sizeof(text),"ERR %s\n",error);
+		return sendall(fd,text,n);
+	}
+	return serve_tile(w,fd,k);
+}
+
+void connection_close(Tserver *s, Tconnection *conn)
+{
+	close(conn->fd);
+	free(conn);
+	__sync_sub_and_fetch(&s->numopen,1);
+}
+
+void* server_worker(void *arg)
+{
+	Tworker *w=(Tworker*)arg;
+	Tserver *s=w->s;
+	Tconnection *conn;
+	while((conn=(Tconnection*)queue_pop(&s->ready)))
+	{
+		int err=0;
+		char *nl=(char*)memchr(conn->buf,'\n',conn->len);
+		if(!nl)
+		{	/* readable according to poll(), does not block */
+			ssize_t n=recv(conn->fd,conn->buf+conn->len,MAXREQUESTLEN-conn->len,0);
+			if(n<=0) err=1;
+			else
+			{
+				conn->len+=n;
+				nl=(char*)memchr(conn->buf,'\n',conn->len);
+				if(!nl && conn->len==MAXREQUESTLEN) err=1;	/* line too long */
+			}
+		}
+		if(!err && nl)
+		{
+			*nl='\0';
+			if(nl>conn->buf && nl[-1]=='\r') nl[-1]='\0';
+			err=serve_request(w,conn->fd,conn->buf);
+			conn->len-=nl+1-conn->buf;
+			memmove(conn->buf,nl+1,conn->len);
+		}
+		if(!err && memchr(conn->buf,'\n',conn->len))
+			queue_push(&s->ready,conn);	/* pipelined request, poll() would not see it */
+		else if(err || write(s->wakeup[1],&conn,sizeof(conn))!=(ssize_t)sizeof(conn))
+			connection_close(s,conn);
+	}
+	return NULL;
+}
+
+int listen_socket(const char *address)
+{	/* numeric: TCP port on the loopback interface, otherwise UNIX domain socket path */
+	int fd;
+	if(address[0] && strspn(address,"0123456789")==strlen(address))
+	{
+		struct sockaddr_in a;
+		int one=1;
+		fd=socket(AF_INET,SOCK_STREAM,0);
+		memset(&a,0,sizeof(a));
+		a.sin_family=AF_INET;
+		a.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+		a.sin_port=htons(atoi(address));
+		setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+		if(fd<0 || bind(fd,(struct sockaddr*)&a,sizeof(a)))
+		{
+			printf("ERROR binding to 127.0.0.1:%s\n",address);
+			exit(2);
+		}
+	}
+	else
+	{
+		struct sockaddr_un a;
+		fd=socket(AF_UNIX,SOCK_STREAM,0);
+		memset(&a,0,sizeof(a));
+		a.sun_family=AF_UNIX;
+		if(strlen(address)>=sizeof(a.sun_path))
+		{
+			printf("ERROR socket path %s too long\n",address);
+			exit(2);
+		}
+		strcpy(a.sun_path,address);
+		unlink(address);
+		if(fd<0 || bind(fd,(struct sockaddr*)&a,sizeof(a)))
+		{
+			printf("ERROR binding to %s\n",address);
+			exit(2);
+		}
+	}
+	if(listen(fd,SOMAXCONN))
+	{
+		printf("ERROR listening on %s\n",address);
+		exit(2);
+	}
+	return fd;
+}
+
+
+int main(int argc, char *argv[])
+{
+	const char *address;
+	long numthreads=sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned long cachetiles=DEFAULT_CACHETILES;
+	Tindex tilesize=DEFAULT_TILESIZE;
+
+	if (argc<2)
+	{
+		printf("usage: %s <socketpath>|<port> [<numthreads>] [<cachetiles>] [<tilesize>]\n",argv[0]);
+		printf("\trequests: <z> <x> <y> <maxiter> | stats\n");
+		exit(0);
+	}
+	address=argv[1];
+	if (argc>2) numthreads=labs(atol(argv[2]));
+	if (argc>3) cachetiles=labs(atol(argv[3]));
+	if (argc>4) tilesize=labs(atol(argv[4]));
+	if(numthreads<1) numthreads=1;
+	if(cachetiles<1) cachetiles=1;
+	if(tilesize<1) tilesize=1;
+
+	Tserver s;
+	s.tilesize=tilesize;
+	s.requests=0;
+	s.numopen=0;
+	cache_init(&s.cache,cachetiles);
+	queue_init(&s.ready,MAXCONNECTIONS);
+	if(pipe(s.wakeup))
+	{
+		printf("ERROR creating pipe\n");
+		exit(2);
+	}
+	int listenfd=listen_socket(address);
+
+	struct sigaction sa;
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler=stophandler;	/* no SA_RESTART: poll() returns EINTR */
+	sigaction(SIGINT,&sa,NULL);
+	sigaction(SIGTERM,&sa,NULL);
+
+	printf("listening on:\t%s\n",address);
+	printf("threads:\t%ld\n",numthreads);
+	printf("tile size:\t%lu x %lu\n",tilesize,tilesize);
+	printf("cache:\t%lu tiles (<=%lu Bytes)\n",cachetiles,cachetiles*sizePGM5(65535,tilesize,tilesize));
+	fflush(stdout);
+
+	Tworker *workers=(Tworker*)malloc(numthreads*sizeof(Tworker));
+	pthread_t *threads=(pthread_t*)malloc(numthreads*sizeof(pthread_t));
+	struct pollfd *pfd=(struct pollfd*)malloc((MAXCONNECTIONS+2)*sizeof(struct pollfd));
+	Tconnection **idle=(Tconnection**)malloc(MAXCONNECTIONS*sizeof(Tconnection*));
+	if(!workers || !threads || !pfd || !idle)
+	{
+		printf("ERROR allocating memory for %ld threads\n",numthreads);
+		exit(1);
+	}
+	long t;
+	for(t=0;t<numthreads;++t)
+	{
+		workers[t].s=&s;
+		workers[t].M=(Titer*)malloc(tilesize*tilesize*sizeof(Titer));
+		workers[t].tiles=0;
+		workers[t].time_compute=0.;
+		if(!workers[t].M)
+		{
+			printf("ERROR allocating memory for tiles\n");
+			exit(1);
+		}
+		pthread_create(&threads[t],NULL,server_worker,&workers[t]);
+	}
+
+	/* poll loop: idle connections and new connections */
+	unsigned long numconnections=0;
+	int numidle=0, i;
+	double time_start=gettime();
+	while(!stop)
+	{
+		pfd[0].fd=s.wakeup[0]; pfd[0].events=POLLIN;
+		/* at most MAXCONNECTIONS open: idle[], the ready queue and the pipe cannot overflow */
+		pfd[1].fd=listenfd; pfd[1].events=(s.numopen<MAXCONNECTIONS)?POLLIN:0;
+		for(i=0;i<numidle;++i)
+		{
+			pfd[2+i].fd=idle[i]->fd;
+			pfd[2+i].events=POLLIN;
+		}
+		if(poll(pfd,2+numidle,-1)<0)
+		{
+			if(errno==EINTR) continue;
+			printf("ERROR poll\n");
+			exit(2);
+		}
+		int n=0;
+		for(i=0;i<numidle;++i)
+		{	/* readable (or closed) connections to the workers */
+			if(pfd[2+i].revents) queue_push(&s.ready,idle[i]);
+			else idle[n++]=idle[i];
+		}
+		numidle=n;
+		if(pfd[0].revents&POLLIN)
+		{	/* all handed back connections (pointer writes are atomic, i.e. whole pointers) */
+			ssize_t r=read(s.wakeup[0],idle+numidle,(MAXCONNECTIONS-numidle)*sizeof(Tconnection*));
+			if(r>0) numidle+=r/sizeof(Tconnection*);
+		}
+		if(pfd[1].revents&POLLIN)
+		{
+			int fd=accept(listenfd,NULL,NULL);
+			if(fd>=0)
+			{
+				Tconnection *conn=(Tconnection*)malloc(sizeof(Tconnection));
+				if(!conn)
+				{
+					printf("ERROR allocating connection\n");
+					exit(1);
+				}
+				conn->fd=fd;
+				conn->len=0;
+				idle[numidle++]=conn;
+				__sync_add_and_fetch(&s.numopen,1);
+				++numconnections;
+			}
+		}
+	}
+	double time_diff=gettime()-time_start;
+
+	queue_close(&s.ready);
+	double time_compute=0.;
+	unsigned long tiles=0;
+	for(t=0;t<numthreads;++t)
+	{
+		pthread_join(threads[t],NULL);
+		time_compute+=workers[t].time_compute;
+		tiles+=workers[t].tiles;
+		free(workers[t].M);
+	}
+	printf("\nTime:\t%g\n",time_diff);
+	printf("connections:\t%lu\n",numconnections);
+	printf("requests:\t%lu\n",s.requests);
+	printf("cache:\t%lu hits\t%lu misses\t%lu coalesced\t%lu evictions\n"
+	      ,s.cache.hits,s.cache.misses,s.cache.coalesced,s.cache.evictions);
+	printf("computed tiles:\t%lu (%g s compute time)\n",tiles,time_compute);
+
+	pfd[0].fd=s.wakeup[0]; pfd[0].events=POLLIN;
+	while(numidle<MAXCONNECTIONS && poll(pfd,1,0)>0)
+	{	/* handed back after the loop ended */
+		ssize_t r=read(s.wakeup[0],idle+numidle,(MAXCONNECTIONS-numidle)*sizeof(Tconnection*));
+		if(r<=0) break;
+		numidle+=r/sizeof(Tconnection*);
+	}
+	for(i=0;i<numidle;++i) connection_close(&s,idle[i]);
+	close(listenfd);
+	if(strspn(address,"0123456789")!=strlen(address)) unlink(address);
+	close(s.wakeup[0]);
+	close(s.wakeup[1]);
+	free(idle);
+	free(pfd);
+	free(threads);
+	free(workers);
+	queue_destroy(&s.ready);
+	cache_destroy(&s.cache);
+
+	return 0;
+}
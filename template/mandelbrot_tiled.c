@@ -0,0 +1,758 @@
+/* mandelbrot_tiled.c
+   calculate Mandelbrot set in tiles traversed along a space-filling curve (Morton/Hilbert)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -Wall -g -pthread mandelbrot_tiled.c -o mandelbrot_tiled
+	gcc -march=native -O3 -pthread mandelbrot_tiled.c -o mandelbrot_tiled
+
+	mandelbrot_tiled <width> <height> <maxiter> <CrealMin> <CimgMin> <CrealMax> <CimgMax> [<filename>] [<numthreads>] [<tilesize>] [raster|morton|hilbert]
+	                 [checkpoint=<file>] [--resume] [schedule=dynamic|static|cyclic] [profile=<prefix>]
+
+	e.g.
+	$ ./mandelbrot_tiled 4096 4096 1000 -2 -2 2 2 mandelbrot.pgm 8 32 hilbert
+	$ ./mandelbrot_tiled 4096 4096 1000 -2 -2 2 2 mandelbrot.pgm 8 32 raster
+	$ ./mandelbrot_tiled 16384 16384 65535 -2 -2 2 2 big.pgm 8 32 hilbert checkpoint=big.ckpt
+	  (killed)
+	$ ./mandelbrot_tiled 16384 16384 65535 -2 -2 2 2 big.pgm 8 32 hilbert checkpoint=big.ckpt --resume
+	$ ./mandelbrot_tiled 4096 4096 1000 -2 -2 2 2 mandelbrot.pgm 8 32 raster schedule=static profile=static
+
+	The image is divided into <tilesize> x <tilesize> tiles (default DEFAULT_TILESIZE, edge tiles
+	are partially used). The tiles are stored contiguously (tiled layout) in the order of the
+	traversal, i.e. tiles calculated one after another are also neighbours in memory:
+	  raster   tile rows, left to right (default)
+	  morton   Z-order curve (interleaved bits of the tile column and row)
+	  hilbert  Hilbert curve, on a 2^k x 2^k tile grid consecutive tiles share an edge, otherwise
+	           the cells of the enclosing grid outside the image are skipped and consecutive
+	           tiles may be apart
+	The threads claim chunks of TILESPERCLAIM tiles along the curve (schedule=dynamic, default),
+	alternatively each thread gets a contiguous part of the curve (static) or every
+	<numthreads>th tile (cyclic).
+	The curves do not give consecutive tiles of more similar cost in general: the cost locality
+	below, measured for the whole set (3 aspect ratios) and the antenna (-1.8 -0.1 -1.7 0) at 16,
+	32 and 64 pixel tiles, was raster 0.10-0.51, hilbert 0.12-0.59, morton 0.18-0.87 (the row
+	neighbour is as similar as a curve neighbour, morton jumps), only the zoom -0.75 0 -0.5 0.25
+	gave hilbert 0.01-0.02 vs. raster 0.03-0.07. The single thread times differed by at most 5%.
+	Hence raster is the default, the curves are there to compare the tiled layout and claims.
+	After all tiles are done, the threads copy the tiles back to raster order for the writer
+	(de-tiling, dynamic over tile rows: reads whole tiles, writes <tilesize> row segments).
+	The cost locality is reported as the mean relative difference of the iterations of
+	consecutive tiles in traversal order.
+
+	checkpoint=<file>: the tiled array lives in the mmap'd file (header, bitmap of finished
+	tiles, iterations per tile, tiles), i.e. the workers write their tiles directly to the page
+	cache. A flusher thread wakes up every CHECKPOINTINTERVAL seconds, msync()s the data of the
+	tiles completed in the meantime and only afterwards sets their bits in the bitmap. The
+	workers never wait for it, and a bit is only set for a tile whose data is on disk.
+	--resume reopens the file (the header has to match the view, tile size and order) and
+	skips the tiles in the bitmap. The file is kept after the render.
+
+	profile=<prefix>: the tiles are calculated row by row and each row segment is timed
+	(one clock_gettime() per row segment, i.e. some overhead for cheap tiles), written are
+	  <prefix>_tiles.pgm  cost heatmap, one pixel per tile, wall time scaled to 0..255
+	  <prefix>_tiles.dat  position, tile column and row, thread, iterations, time per tile
+	  <prefix>_rows.dat   iterations and time per image row
+	and a summary of the busy/idle time per thread with
+	  imbalance ratio   max/mean busy time of the threads (1: perfectly balanced)
+	  speedup           sum of busy times / compute wall time (achieved) vs. the ideal
+	                    min(<numthreads>, sum of busy times / most expensive tile)
+	the times are wall clock times, i.e. meaningful with at most one thread per core.
+*/
+
+#include<stdlib.h>	/* malloc(),free(),qsort(),labs(),atol(),atof() */
+#include<stdio.h>	/* printf() */
+#include<string.h>	/* strcmp(),memcpy() */
+#include<unistd.h>	/* sysconf(),ftruncate(),close() */
+#include<fcntl.h>	/* open() */
+#include<sys/mman.h>	/* mmap(),msync(),munmap() */
+#include<pthread.h>
+
+#include "mandelbrot.h"
+
+#define DEFAULT_TILESIZE 32
+#define TILESPERCLAIM 1
+#define CHECKPOINTINTERVAL 1	/* [s] */
+
+typedef enum { RASTER, MORTON, HILBERT } Torder;
+static const char *ordername[]={"raster","morton","hilbert"};
+typedef enum { DYNAMIC, STATIC, CYCLIC } Tschedule;
+static const char *schedulename[]={"dynamic","static","cyclic"};
+
+typedef struct {
+	unsigned int column, row;	/* tile column and row */
+} Ttilepos;
+
+
+/* space-filling curves =========================================================================*/
+static inline unsigned long morton_spread(unsigned long x)
+{	/* insert a 0 bit after each of the lower 32 bits */
+	x&=0xffffffffUL;
+	x=(x|(x<<16))&0x0000ffff0000ffffUL;
+	x=(x|(x<<8)) &0x00ff00ff00ff00ffUL;
+	x=(x|(x<<4)) &0x0f0f0f0f0f0f0f0fUL;
+	x=(x|(x<<2)) &0x3333333333333333UL;
+	x=(x|(x<<1)) &0x5555555555555555UL;
+	return x;
+}
+
+static inline unsigned long morton_index(unsigned int column, unsigned int row)
+{
+	return morton_spread(column)|(morton_spread(row)<<1);
+}
+
+unsigned long hilbert_index(unsigned long n, unsigned long column, unsigned long row)
+{	/* position on the Hilbert curve through n x n cells (n power of 2) */
+	unsigned long s, d=0, rx, ry, t;
+	for(s=n/2;s>0;s/=2)
+	{
+		rx=(column&s)>0;
+		ry=(row&s)>0;
+		d+=s*s*((3*rx)^ry);
+		if(ry==0)
+		{	/* rotate the quadrant */
+			if(rx==1)
+			{
+				column=s-1-column;
+				row=s-1-row;
+			}
+			t=column; column=row; row=t;
+		}
+	}
+	return d;
+}
+
+typedef struct {
+	unsigned long key;	/* position on the curve */
+	Ttilepos pos;
+} Tcurvetile;
+
+static int curvetile_cmp(const void *a, const void *b)
+{
+	unsigned long ka=((const Tcurvetile*)a)->key, kb=((const Tcurvetile*)b)->key;
+	return (ka>kb)-(ka<kb);
+}
+
+/* tile positions in traversal order, the curves are defined on the enclosing 2^k x 2^k grid,
+   the tiles are sorted by their curve position (memory linear in the number of tiles) */
+Ttilepos* tileorder(Torder order, unsigned int numtilecolumns, unsigned int numtilerows)
+{
+	unsigned long numtiles=(unsigned long)numtilecolumns*numtilerows;
+	Ttilepos *tiles=(Ttilepos*)malloc(numtiles*sizeof(Ttilepos));
+	unsigned long n=1, k=0;
+	if(!tiles)
+	{
+		printf("ERROR allocating memory for %lu tiles\n",numtiles);
+		exit(1);
+	}
+	while(n<numtilecolumns || n<numtilerows) n*=2;
+	unsigned int column, row;
+	switch(order)
+	{
+		case RASTER:
+			for(row=0;row<numtilerows;++row)
+				for(column=0;column<numtilecolumns;++column)
+				{
+					tiles[k].column=column; tiles[k].row=row; ++k;
+				}
+			break;
+		case MORTON:
+		case HILBERT:
+		{
+			Tcurvetile *curve=(Tcurvetile*)malloc(numtiles*sizeof(Tcurvetile));
+			if(!curve)
+			{
+				printf("ERROR allocating memory for %lu curve positions\n",numtiles);
+				exit(1);
+			}
+			for(row=0;row<numtilerows;++row)
+				for(column=0;column<numtilecolumns;++column)
+				{
+					curve[k].key=(order==MORTON)?morton_index(column,row):hilbert_index(n,column,row);
+					curve[k].pos.column=column; curve[k].pos.row=row; ++k;
+				}
+			qsort(curve,numtiles,sizeof(Tcurvetile),curvetile_cmp);
+			for(k=0;k<numtiles;++k) tiles[k]=curve[k].pos;
+			free(curve);
+			break;
+		}
+	}
+	return tiles;
+}
+
+
+/* checkpoint file ==============================================================================*/
+typedef struct {
+	char magic[8];
+	unsigned long numcolumns, numrows, maxiter, tilesize, order, numtiles;
+	double CrealMin, CimgMin, CrealMax, CimgMax;
+} Tcheckpointheader;
+
+static const char checkpointmagic[8]="MBTCKP1";
+
+typedef struct {
+	int fd;
+	unsigned char *map;
+	size_t mapsize, dataoffset;	/* tile iterations and tiles start at dataoffset (page aligned) */
+	Tcheckpointheader *header;
+	unsigned char *bitmap;	/* bit k: tile k (traversal order) is on disk */
+	unsigned long *pending;	/* tiles collected by a flush */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	int finished;
+	unsigned long numflushes, numflushed;
+	double time_flush;
+} Tcheckpoint;
+
+static inline int checkpoint_isset(const Tcheckpoint *c, unsigned long k)
+{
+	return (c->bitmap[k/8]>>(k%8))&1;
+}
+
+/* map (and create or check) the checkpoint file, the tile iterations and tiles are returned */
+void checkpoint_open(Tcheckpoint *c, const char *filename, int resume, const Tview *v
+                    ,Tindex tilesize, Torder order, Tindex numtiles
+                    ,unsigned long **tileiter, Titer **T)
+{
+	Tcheckpointheader h;
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,checkpointmagic,sizeof(h.magic));
+	h.numcolumns=v->numcolumns; h.numrows=v->numrows; h.maxiter=v->maxiter;
+	h.tilesize=tilesize; h.order=order; h.numtiles=numtiles;
+	h.CrealMin=v->CrealMin; h.CimgMin=v->CimgMin; h.CrealMax=v->CrealMax; h.CimgMax=v->CimgMax;
+
+	size_t pagesize=sysconf(_SC_PAGESIZE);
+	c->dataoffset=(sizeof(h)+(numtiles+7)/8+pagesize-1)/pagesize*pagesize;
+	c->mapsize=c->dataoffset+numtiles*sizeof(unsigned long)+numtiles*tilesize*tilesize*sizeof(Titer);
+	c->fd=open(filename,resume?O_RDWR:(O_RDWR|O_CREAT|O_TRUNC),0644);
+	if(c->fd<0)
+	{
+		printf("ERROR opening checkpoint file %s\n",filename);
+		exit(2);
+	}
+	if(resume)
+	{
+		Tcheckpointheader hfile;
+		if(pread(c->fd,&hfile,sizeof(hfile),0)!=(ssize_t)sizeof(hfile)
+		   || lseek(c->fd,0,SEEK_END)!=(off_t)c->mapsize
+		   || memcmp(&hfile,&h,sizeof(h)))
+		{
+			printf("ERROR checkpoint file %s does not match the view, tile size and order\n",filename);
+			exit(2);
+		}
+	}
+	else if(ftruncate(c->fd,c->mapsize))
+	{	/* sparse file, zero filled (empty bitmap) */
+		printf("ERROR allocating checkpoint file %s (%lu Bytes)\n",filename,c->mapsize);
+		exit(2);
+	}
+	c->map=(unsigned char*)mmap(NULL,c->mapsize,PROT_READ|PROT_WRITE,MAP_SHARED,c->fd,0);
+	if(c->map==MAP_FAILED)
+	{
+		printf("ERROR mapping checkpoint file %s\n",filename);
+		exit(2);
+	}
+	c->header=(Tcheckpointheader*)c->map;
+	c->bitmap=c->map+sizeof(h);
+	if(!resume)
+	{
+		memcpy(c->header,&h,sizeof(h));
+		msync(c->map,c->dataoffset,MS_SYNC);
+	}
+	c->pending=(unsigned long*)malloc(numtiles*sizeof(unsigned long));
+	if(!c->pending)
+	{
+		printf("ERROR allocating memory for checkpoint\n");
+		exit(1);
+	}
+	pthread_mutex_init(&c->mtx,NULL);
+	pthread_cond_init(&c->cond,NULL);
+	c->finished=0;
+	c->numflushes=c->numflushed=0;
+	c->time_flush=0.;
+	*tileiter=(unsigned long*)(c->map+c->dataoffset);
+	*T=(Titer*)(c->map+c->dataoffset+numtiles*sizeof(unsigned long));
+}
+
+void checkpoint_close(Tcheckpoint *c)
+{
+	pthread_cond_destroy(&c->cond);
+	pthread_mutex_destroy(&c->mtx);
+	free(c->pending);
+	munmap(c->map,c->mapsize);
+	close(c->fd);
+}
+
+/* write tiles finished (done[k]) since the last flush, data first, then their bits */
+void checkpoint_flush(Tcheckpoint *c, const unsigned char *done, unsigned long numtiles)
+{
+	double t0=gettime();
+	unsigned long k, i, n=0;
+	for(k=0;k<numtiles;++k)
+		if(done[k] && !checkpoint_isset(c,k)) c->pending[n++]=k;
+	if(n==0) return;
+	__sync_synchronize();	/* tile data written before done[k] was set */
+	msync(c->map+c->dataoffset,c->mapsize-c->dataoffset,MS_SYNC);	/* only dirty pages */
+	for(i=0;i<n;++i)
+	{
+		k=c->pending[i];
+		c->bitmap[k/8]|=(unsigned char)(1<<(k%8));
+	}
+	msync(c->map,c->dataoffset,MS_ASYNC);
+	++c->numflushes;
+	c->numflushed+=n;
+	c->time_flush+=gettime()-t0;
+}
+
+
+/* tiled renderer ===============================================================================*/
+typedef struct {
+	double *tiletime;	/* traversal order */
+	unsigned int *tilethread;
+	unsigned long *rowiter, *rownsec;	/* per image row (atomic) */
+} Tprofile;
+
+typedef struct {
+	Tview v;
+	Tindex tilesize, numtilecolumns, numtilerows, numtiles;
+	const Ttilepos *tiles;	/* traversal order */
+	Tindex *tileslot;	/* tile row*numtilecolumns+column -> position in T */
+	Titer *T;	/* tiled storage: tile k at T+k*tilesize^2 */
+	Titer *M;	/* raster image */
+	unsigned long *tileiter;	/* iterations per tile (traversal order) */
+	unsigned char *done;	/* tile finished (traversal order) */
+	Tcheckpoint *checkpoint;	/* NULL: none */
+	Tprofile *profile;	/* NULL: none */
+	Torder order;
+	Tschedule schedule;
+	unsigned int numthreads;
+	unsigned long nexttile, nexttilerow;	/* dynamic scheduling (atomic) */
+	pthread_barrier_t barrier;
+} Trenderer;
+
+typedef struct {
+	Trenderer *r;
+	unsigned int id;
+	unsigned long sumiter, numtiles;
+	double time_compute, time_detile;
+	double time_busy;	/* profile only */
+} Tworker;
+
+static inline Tindex tilewidth(const Trenderer *r, Tindex tilecolumn)
+{	/* edge tiles are smaller */
+	Tindex c0=tilecolumn*r->tilesize;
+	return (c0+r->tilesize<=r->v.numcolumns)?r->tilesize:r->v.numcolumns-c0;
+}
+
+static inline Tindex tileheight(const Trenderer *r, Tindex tilerow)
+{
+	Tindex r0=tilerow*r->tilesize;
+	return (r0+r->tilesize<=r->v.numrows)?r->tilesize:r->v.numrows-r0;
+}
+
+/* calculate tile k (traversal order) */
+static inline void render_tile(Tworker *w, unsigned long k)
+{
+	Trenderer *r=w->r;
+	Tindex tilesize=r->tilesize;
+	Tindex column0=r->tiles[k].column*tilesize, column1=column0+tilewidth(r,r->tiles[k].column);
+	Tindex row0=r->tiles[k].row*tilesize, row1=row0+tileheight(r,r->tiles[k].row);
+	Titer *T=r->T+k*tilesize*tilesize;
+	unsigned long iter=0;
+	if(r->done[k]) return;	/* resumed */
+	if(r->profile)
+	{	/* row by row */
+		Tprofile *p=r->profile;
+		double t0=gettime(), t1=t0, t2;
+		Tindex row;
+		for(row=row0;row<row1;++row)
+		{
+			unsigned long rowiter=mandelbrot_block(&r->v,T+(row-row0)*tilesize,tilesize,column0,column1,row,row+1);
+			t2=gettime();
+			__sync_add_and_fetch(&p->rowiter[row],rowiter);
+			__sync_add_and_fetch(&p->rownsec[row],(unsigned long)((t2-t1)*1.E9));
+			iter+=rowiter;
+			t1=t2;
+		}
+		p->tiletime[k]=t1-t0;
+		p->tilethread[k]=w->id;
+		w->time_busy+=t1-t0;
+	}
+	else
+		iter=mandelbrot_block(&r->v,T,tilesize,column0,column1,row0,row1);
+	r->tileiter[k]=iter;
+	w->sumiter+=iter;
+	++w->numtiles;
+	__sync_synchronize();
+	r->done[k]=1;
+}
+
+void* tiled_worker(void *arg)
+{
+	Tworker *w=(Tworker*)arg;
+	Trenderer *r=w->r;
+	Tindex tilesize=r->tilesize, tilesize2=tilesize*tilesize;
+	unsigned long k, k0, k1;
+
+	double t0=gettime();
+	switch(r->schedule)
+	{
+		case DYNAMIC:
+			while((k0=__sync_fetch_and_add(&r->nexttile,TILESPERCLAIM))<r->numtiles)
+			{
+				k1=(k0+TILESPERCLAIM<r->numtiles)?k0+TILESPERCLAIM:r->numtiles;
+				for(k=k0;k<k1;++k) render_tile(w,k);
+			}
+			break;
+		case STATIC:
+			k1=r->numtiles*(w->id+1)/r->numthreads;
+			for(k=r->numtiles*w->id/r->numthreads;k<k1;++k) render_tile(w,k);
+			break;
+		case CYCLIC:
+			for(k=w->id;k<r->numtiles;k+=r->numthreads) render_tile(w,k);
+			break;
+	}
+	w->time_compute=gettime()-t0;
+
+	pthread_barrier_wait(&r->barrier);
+
+	/* de-tiling: one tile row (all tiles are complete now) */
+	t0=gettime();
+	Tindex tilerow, tilecolumn, row;
+	while((tilerow=__sync_fetch_and_add(&r->nexttilerow,1))<r->numtilerows)
+	{
+		Tindex height=tileheight(r,tilerow);
+		for(tilecolumn=0;tilecolumn<r->numtilecolumns;++tilecolumn)
+		{
+			const Titer *src=r->T+r->tileslot[tilerow*r->numtilecolumns+tilecolumn]*tilesize2;
+			Titer *dst=r->M+colrow2index(tilecolumn*tilesize,tilerow*tilesize,r->v.numcolumns);
+			size_t width=tilewidth(r,tilecolumn)*sizeof(Titer);
+			for(row=0;row<height;++row)
+				memcpy(dst+row*r->v.numcolumns,src+row*tilesize,width);
+		}
+	}
+	w->time_detile=gettime()-t0;
+	return NULL;
+}
+
+/* write the profile files and print the load balance summary */
+void profile_report(const Trenderer *r, const Tworker *workers, const char *prefix)
+{
+	const Tprofile *p=r->profile;
+	unsigned int t, numthreads=r->numthreads;
+	unsigned long k;
+	Tindex row;
+	char filename[1024];
+	FILE *f;
+	double maxtiletime=0., sumbusy=0., maxbusy=0., minbusy=0., walltime=0.;
+	for(k=0;k<r->numtiles;++k)
+		if(p->tiletime[k]>maxtiletime) maxtiletime=p->tiletime[k];
+	for(t=0;t<numthreads;++t)
+	{
+		sumbusy+=workers[t].time_busy;
+		if(workers[t].time_busy>maxbusy) maxbusy=workers[t].time_busy;
+		if(t==0 || workers[t].time_busy<minbusy) minbusy=workers[t].time_busy;
+		if(workers[t].time_compute>walltime) walltime=workers[t].time_compute;
+	}
+
+	/* heatmap: one pixel per tile */
+	Titer *H=(Titer*)malloc(r->numtiles*sizeof(Titer));
+	if(!H)
+	{
+		printf("ERROR allocating memory for heatmap\n");
+		exit(1);
+	}
+	for(k=0;k<r->numtiles;++k)
+		H[colrow2index(r->tiles[k].column,r->tiles[k].row,r->numtilecolumns)]
+		 =(maxtiletime>0.)?(Titer)(255.*p->tiletime[k]/maxtiletime+0.5):0;
+	snprintf(filename,sizeof(filename),"%s_tiles.pgm",prefix);
+	writePGM(H,255,r->numtilecolumns,r->numtilerows,filename);
+	free(H);
+
+	snprintf(filename,sizeof(filename),"%s_tiles.dat",prefix);
+	if(!(f=fopen(filename,"w")))
+	{
+		printf("ERROR opening file %s\n",filename);
+		exit(2);
+	}
+	fprintf(f,"# %s order, %s schedule, %u threads\n",ordername[r->order],schedulename[r->schedule],numthreads);
+	fprintf(f,"# position\ttilecolumn\ttilerow\tthread\titerations\ttime[s]\n");
+	for(k=0;k<r->numtiles;++k)
+		fprintf(f,"%lu\t%u\t%u\t%u\t%lu\t%g\n",k,r->tiles[k].column,r->tiles[k].row
+		       ,p->tilethread[k],r->tileiter[k],p->tiletime[k]);
+	fclose(f);
+
+	snprintf(filename,sizeof(filename),"%s_rows.dat",prefix);
+	if(!(f=fopen(filename,"w")))
+	{
+		printf("ERROR opening file %s\n",filename);
+		exit(2);
+	}
+	fprintf(f,"# row\titerations\ttime[s]\n");
+	for(row=0;row<r->v.numrows;++row)
+		fprintf(f,"%lu\t%lu\t%g\n",row,p->rowiter[row],p->rownsec[row]*1.E-9);
+	fclose(f);
+
+	printf("# thread\ttiles\titerations\tbusy[s]\tidle[s]\n");
+	for(t=0;t<numthreads;++t)
+		printf("%u\t%lu\t%lu\t%g\t%g\n",t,workers[t].numtiles,workers[t].sumiter
+		      ,workers[t].time_busy,walltime-workers[t].time_busy);
+	double meanbusy=sumbusy/numthreads, ideal=numthreads;
+	if(maxtiletime>0. && sumbusy/maxtiletime<ideal) ideal=sumbusy/maxtiletime;
+	printf("thread busy time [s]:\t%g (max)\t%g (mean)\t%g (min)\n",maxbusy,meanbusy,minbusy);
+	printf("imbalance ratio (max/mean):\t%g\n",meanbusy>0.?maxbusy/meanbusy:0.);
+	printf("most expensive tile [s]:\t%g\n",maxtiletime);
+	printf("speedup:\t%g (achieved)\t%g (ideal)\t%g%% efficiency\n"
+	      ,walltime>0.?sumbusy/walltime:0.,ideal,walltime>0.?100.*sumbusy/walltime/numthreads:0.);
+	printf("profile files:\t%s_tiles.pgm %s_tiles.dat %s_rows.dat\n",prefix,prefix,prefix);
+}
+
+void* checkpoint_flusher(void *arg)
+{
+	Trenderer *r=(Trenderer*)arg;
+	Tcheckpoint *c=r->checkpoint;
+	pthread_mutex_lock(&c->mtx);
+	while(!c->finished)
+	{
+		struct timespec t;
+		clock_gettime(CLOCK_REALTIME,&t);
+		t.tv_sec+=CHECKPOINTINTERVAL;
+		pthread_cond_timedwait(&c->cond,&c->mtx,&t);
+		pthread_mutex_unlock(&c->mtx);
+		checkpoint_flush(c,r->done,r->numtiles);
+		pthread_mutex_lock(&c->mtx);
+	}
+	pthread_mutex_unlock(&c->mtx);
+	checkpoint_flush(c,r->done,r->numtiles);
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	Tindex numcolumns, numrows;
+	Titer maxiter;
+	Tfloat CrealMin, CimgMin, CrealMax, CimgMax;
+	char filename_default[]="mandelbrot.pgm";
+	char *filename=filename_default;
+	long numthreads=sysconf(_SC_NPROCESSORS_ONLN);
+	Tindex tilesize=DEFAULT_TILESIZE;
+	Torder order=RASTER;
+	const char *checkpointfile=NULL;
+	int resume=0;
+	Tschedule schedule=DYNAMIC;
+	const char *profileprefix=NULL;
+
+	/* options may appear anywhere, remove them from the positional arguments */
+	int i, n=1;
+	for(i=1;i<argc;++i)
+	{
+		if(!strncmp(argv[i],"checkpoint=",11)) checkpointfile=argv[i]+11;
+		else if(!strcmp(argv[i],"--resume")) resume=1;
+		else if(!strncmp(argv[i],"profile=",8)) profileprefix=argv[i]+8;
+		else if(!strcmp(argv[i],"schedule=dynamic")) schedule=DYNAMIC;
+		else if(!strcmp(argv[i],"schedule=static")) schedule=STATIC;
+		else if(!strcmp(argv[i],"schedule=cyclic")) schedule=CYCLIC;
+		else if(!strncmp(argv[i],"schedule=",9))
+		{
+			printf("ERROR unknown schedule %s (dynamic|static|cyclic)\n",argv[i]+9);
+			exit(1);
+		}
+		else argv[n++]=argv[i];
+	}
+	argc=n;
+	if (argc<8)
+	{
+		printf("usage: %s <width> <height> <maxiter> <CrealMin> <CimgMin> <CrealMax> <CimgMax> [<filename>] [<numthreads>] [<tilesize>] [raster|morton|hilbert]\n",argv[0]);
+		printf("\t[checkpoint=<file>] [--resume] [schedule=dynamic|static|cyclic] [profile=<prefix>]\n");
+		exit(0);
+	}
+	if(resume && !checkpointfile)
+	{
+		printf("ERROR --resume needs checkpoint=<file>\n");
+		exit(1);
+	}
+	numcolumns=labs(atol(argv[1]));
+	numrows=labs(atol(argv[2]));
+	maxiter=labs(atol(argv[3]));
+	CrealMin=atof(argv[4]);
+	CimgMin=atof(argv[5]);
+	CrealMax=atof(argv[6]);
+	CimgMax=atof(argv[7]);
+	if (argc>8) filename=argv[8];
+	if (argc>9) numthreads=labs(atol(argv[9]));
+	if (argc>10) tilesize=labs(atol(argv[10]));
+	if (argc>11)
+	{
+		if(!strcmp(argv[11],"raster")) order=RASTER;
+		else if(!strcmp(argv[11],"morton")) order=MORTON;
+		else if(!strcmp(argv[11],"hilbert")) order=HILBERT;
+		else
+		{
+			printf("ERROR unknown order %s (raster|morton|hilbert)\n",argv[11]);
+			exit(1);
+		}
+	}
+	if(numcolumns<1) numcolumns=1;
+	if(numrows<1) numrows=1;
+	if(maxiter>65535) maxiter=65535;
+	if(numthreads<1) numthreads=1;
+	if(tilesize<1) tilesize=1;
+
+	Trenderer r;
+	view_init(&r.v,numcolumns,numrows,maxiter,CrealMin,CimgMin,CrealMax,CimgMax);
+	r.tilesize=tilesize;
+	r.numtilecolumns=(numcolumns+tilesize-1)/tilesize;
+	r.numtilerows=(numrows+tilesize-1)/tilesize;
+	r.numtiles=r.numtilecolumns*r.numtilerows;
+	r.tiles=tileorder(order,r.numtilecolumns,r.numtilerows);
+	r.nexttile=r.nexttilerow=0;
+	r.order=order;
+	r.schedule=schedule;
+	r.numthreads=numthreads;
+
+	printf("width x height:\t%lu x %lu\n",numcolumns,numrows);
+	printf("Creal: %g...%g\tCimg: %g...%g\n",CrealMin,CrealMax,CimgMin,CimgMax);
+	printf("maxiter:\t%u\n",maxiter);
+	printf("threads:\t%ld\n",numthreads);
+	printf("tiles:\t%lu x %lu of %lu x %lu (%s order)\n"
+	      ,r.numtilecolumns,r.numtilerows,tilesize,tilesize,ordername[order]);
+	printf("schedule:\t%s\n",schedulename[schedule]);
+
+	unsigned long k, tiledsize=r.numtiles*tilesize*tilesize*sizeof(Titer);
+	Tcheckpoint checkpoint;
+	r.checkpoint=NULL;
+	if(checkpointfile)
+	{
+		r.checkpoint=&checkpoint;
+		checkpoint_open(&checkpoint,checkpointfile,resume,&r.v,tilesize,order,r.numtiles,&r.tileiter,&r.T);
+	}
+	else
+	{
+		r.T=(Titer*)malloc(tiledsize);
+		r.tileiter=(unsigned long*)malloc(r.numtiles*sizeof(unsigned long));
+	}
+	r.M=(Titer*)malloc(numcolumns*numrows*sizeof(Titer));
+	r.done=(unsigned char*)calloc(r.numtiles,1);
+	Tprofile profile;
+	r.profile=NULL;
+	if(profileprefix)
+	{
+		r.profile=&profile;
+		profile.tiletime=(double*)calloc(r.numtiles,sizeof(double));
+		profile.tilethread=(unsigned int*)calloc(r.numtiles,sizeof(unsigned int));
+		profile.rowiter=(unsigned long*)calloc(numrows,sizeof(unsigned long));
+		profile.rownsec=(unsigned long*)calloc(numrows,sizeof(unsigned long));
+		if(!profile.tiletime || !profile.tilethread || !profile.rowiter || !profile.rownsec)
+		{
+			printf("ERROR allocating memory for profile\n");
+			exit(1);
+		}
+	}
+	r.tileslot=(Tindex*)malloc(r.numtiles*sizeof(Tindex));
+	Tworker *workers=(Tworker*)malloc(numthreads*sizeof(Tworker));
+	pthread_t *threads=(pthread_t*)malloc(numthreads*sizeof(pthread_t));
+	if(!r.T || !r.M || !r.tileiter || !r.done || !r.tileslot || !workers || !threads)
+	{
+		printf("ERROR allocating memory (tiled array %lu Bytes)\n",tiledsize);
+		exit(1);
+	}
+	for(k=0;k<r.numtiles;++k)
+		r.tileslot[r.tiles[k].row*r.numtilecolumns+r.tiles[k].column]=k;
+	pthread_barrier_init(&r.barrier,NULL,numthreads);
+	unsigned long numresumed=0, sumiterresumed=0;
+	if(resume)
+	{
+		for(k=0;k<r.numtiles;++k)
+			if(checkpoint_isset(&checkpoint,k))
+			{
+				r.done[k]=1;
+				++numresumed;
+				sumiterresumed+=r.tileiter[k];
+			}
+		printf("resumed:\t%lu of %lu tiles from %s\n",numresumed,r.numtiles,checkpointfile);
+	}
+	pthread_t flusher;
+
+/*------------------------------------------------------------------------------------------------*/
+	double time_start=gettime();
+	long t;
+	if(r.checkpoint) pthread_create(&flusher,NULL,checkpoint_flusher,&r);
+	for(t=0;t<numthreads;++t)
+	{
+		workers[t].r=&r;
+		workers[t].id=t;
+		workers[t].sumiter=workers[t].numtiles=0;
+		workers[t].time_busy=0.;
+		pthread_create(&threads[t],NULL,tiled_worker,&workers[t]);
+	}
+	for(t=0;t<numthreads;++t) pthread_join(threads[t],NULL);
+	if(r.checkpoint)
+	{
+		pthread_mutex_lock(&checkpoint.mtx);
+		checkpoint.finished=1;
+		pthread_cond_signal(&checkpoint.cond);
+		pthread_mutex_unlock(&checkpoint.mtx);
+		pthread_join(flusher,NULL);
+	}
+	double time_diff=gettime()-time_start;
+/*------------------------------------------------------------------------------------------------*/
+
+	unsigned long sumiter=0;	/* calculated by this run */
+	double time_compute_max=0., time_compute_min=0., time_detile_max=0.;
+	for(t=0;t<numthreads;++t)
+	{
+		sumiter+=workers[t].sumiter;
+		if(t==0 || workers[t].time_compute>time_compute_max) time_compute_max=workers[t].time_compute;
+		if(t==0 || workers[t].time_compute<time_compute_min) time_compute_min=workers[t].time_compute;
+		if(workers[t].time_detile>time_detile_max) time_detile_max=workers[t].time_detile;
+	}
+	/* cost locality: mean |iter(k+1)-iter(k)| relative to the mean tile cost */
+	unsigned long sumitertotal=sumiter+sumiterresumed;
+	double costdiff=0.;
+	for(k=1;k<r.numtiles;++k)
+		costdiff+=(r.tileiter[k]>r.tileiter[k-1])?r.tileiter[k]-r.tileiter[k-1]:r.tileiter[k-1]-r.tileiter[k];
+	if(r.numtiles>1 && sumitertotal>0) costdiff/=(r.numtiles-1)*((double)sumitertotal/r.numtiles);
+
+	printf("Time:\t%g\n",time_diff);
+	printf("compute time [s]:\t%g (max)\t%g (min)\n",time_compute_max,time_compute_min);
+	printf("de-tiling time [s]:\t%g (max)\n",time_detile_max);
+	printf("total number of iterations:\t%lu (%lu FlOp)\n",sumiter,sumiter*10);
+	if(time_diff>0.) printf("FlOp/s:\t%g\n",sumiter*10./time_diff);
+	if(numresumed) printf("iterations of resumed tiles:\t%lu\n",sumiterresumed);
+	printf("tile cost difference of consecutive tiles:\t%g (relative to mean tile cost)\n",costdiff);
+	if(r.checkpoint)
+	{	/* the flusher runs concurrently, its time is an upper bound of the overhead */
+		printf("checkpoint:\t%lu flushes, %lu tiles, %g s (%g%% of Time)\n"
+		      ,checkpoint.numflushes,checkpoint.numflushed,checkpoint.time_flush
+		      ,time_diff>0.?100.*checkpoint.time_flush/time_diff:0.);
+	}
+
+	double time_write=gettime();
+	writePGM(r.M,maxiter,numcolumns,numrows,filename);
+	time_write=gettime()-time_write;
+	printf("PGM file:\t%s (%g s)\n",filename,time_write);
+	if(r.profile)
+	{
+		profile_report(&r,workers,profileprefix);
+		free(profile.rownsec);
+		free(profile.rowiter);
+		free(profile.tilethread);
+		free(profile.tiletime);
+	}
+
+	pthread_barrier_destroy(&r.barrier);
+	free(threads);
+	free(workers);
+	free(r.tileslot);
+	free(r.done);
+	free(r.M);
+	if(r.checkpoint)
+		checkpoint_close(&checkpoint);
+	else
+	{
+		free(r.tileiter);
+		free(r.T);
+	}
+	free((void*)r.tiles);
+
+	return 0;
+}
@@ -0,0 +1,258 @@
+/* peakflops.cpp
+   instruction latency/throughput and peak FlOp/s microbenchmarks (scalar, SSE2, AVX2, AVX-512)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	g++ -march=native -O2 -fno-math-errno peakflops.cpp -o peakflops
+	// -march=native: the widths the CPU supports (__SSE2__, __AVX2__, __AVX512F__) are measured
+	// -fno-math-errno: sqrt without errno check
+	// default gnu++17, i.e. FMA contraction like the C programs (mandelbrot.h)
+
+	peakflops [<mintime [s]>]
+
+	e.g.
+	$ taskset -c 2 ./peakflops
+
+	For each width and operation (add, mul, fma, div, sqrt; double precision)
+	- latency: one dependent chain x=op(x), time per instruction
+	- throughput: CHAINS independent chains (enough to fill the pipelines of all ports)
+	An empty asm statement keeps each chain in its own register (no vectorization of the
+	scalar chains, no reassociation). The values stay in the normal range (no denormals).
+	Cycles are derived from the clock frequency measured with a chain of dependent integer adds
+	(1 cycle latency, tsctimer_corefrequency() of tsctimer.h), i.e. the actual (turbo) frequency,
+	not the TSC or nominal one.
+	GFlOp/s per core from the throughput (fma: 2 FlOp per element), per socket it is
+	multiplied with the number of cores ("cpu cores" in /proc/cpuinfo), assuming all cores
+	keep the frequency (the AVX-512 frequency license usually is lower).
+
+	The Mandelbrot iteration (mandelbrot_point() of mandelbrot.h, C=0: never escapes) is
+	compared with its bounds: the critical path of the Zreal chain (Zimg*Zimg, fms, +Creal,
+	with FMA contraction mul+fma+add latency) and the throughput of its FP instructions.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <type_traits>
+#include <unistd.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#include "mandelbrot.h"  /* mandelbrot_point(),gettime() */
+#include "tsctimer.h"  /* tsctimer_corefrequency() */
+
+constexpr int CHAINS = 12;  /* independent chains: <= 16 registers of AVX2 with the constants */
+constexpr int NUMSAMPLES = 5;
+constexpr double DEFAULT_MINTIME = 0.05;  /* [s] per sample */
+
+enum class Top { Add, Mul, Fma, Div, Sqrt };
+constexpr int NUMOPS = 5;
+constexpr Top ops[NUMOPS] = {Top::Add, Top::Mul, Top::Fma, Top::Div, Top::Sqrt};
+constexpr const char* opname[] = {"add", "mul", "fma", "div", "sqrt"};
+constexpr int opflop[] = {1, 1, 2, 1, 1};
+
+typedef double V128 __attribute__((vector_size(16)));
+typedef double V256 __attribute__((vector_size(32)));
+typedef double V512 __attribute__((vector_size(64)));
+
+/* fma and sqrt per width (the arithmetic operators work for all) */
+template <typename V> struct Width;
+template <> struct Width<double> {
+  static constexpr const char* name = "scalar";
+  static double fma(double x, double a, double b) { return std::fma(x, a, b); }
+  static double sqrt(double x) { return std::sqrt(x); }
+};
+#ifdef __SSE2__
+template <> struct Width<V128> {
+  static constexpr const char* name = "SSE2";
+#ifdef __FMA__
+  static V128 fma(V128 x, V128 a, V128 b) { return (V128)_mm_fmadd_pd((__m128d)x, (__m128d)a, (__m128d)b); }
+#else
+  static V128 fma(V128 x, V128 a, V128 b) { return x * a + b; }
+#endif
+  static V128 sqrt(V128 x) { return (V128)_mm_sqrt_pd((__m128d)x); }
+};
+#endif
+#ifdef __AVX2__
+template <> struct Width<V256> {
+  static constexpr const char* name = "AVX2";
+#ifdef __FMA__
+  static V256 fma(V256 x, V256 a, V256 b) { return (V256)_mm256_fmadd_pd((__m256d)x, (__m256d)a, (__m256d)b); }
+#else
+  static V256 fma(V256 x, V256 a, V256 b) { return x * a + b; }
+#endif
+  static V256 sqrt(V256 x) { return (V256)_mm256_sqrt_pd((__m256d)x); }
+};
+#endif
+#ifdef __AVX512F__
+template <> struct Width<V512> {
+  static constexpr const char* name = "AVX-512";
+  static V512 fma(V512 x, V512 a, V512 b) { return (V512)_mm512_fmadd_pd((__m512d)x, (__m512d)a, (__m512d)b); }
+  static V512 sqrt(V512 x) { return (V512)_mm512_maskz_sqrt_pd(0xFF, (__m512d)x); }  /* all lanes */
+};
+#endif
+
+template <typename V> inline void keep(V& x) {
+#ifdef __x86_64__
+  __asm__ volatile("" : "+v"(x));  /* in a (xmm/ymm/zmm) register, opaque to the optimizer */
+#else
+  __asm__ volatile("" : "+m"(x));
+#endif
+}
+
+template <Top OP, typename V> inline V op(V x, V a, V b) {
+  if constexpr (OP == Top::Add) return x + b;
+  else if constexpr (OP == Top::Mul) return x * a;
+  else if constexpr (OP == Top::Fma) return Width<V>::fma(x, a, b);  /* fixed point x=1 */
+  else if constexpr (OP == Top::Div) return x / a;
+  else return Width<V>::sqrt(x);  /* converges to 1 */
+}
+
+double sink = 0.;
+
+/* seconds for n iterations of C chains */
+template <typename V, Top OP, int C>
+double run(unsigned long n) {
+  V x[C], a = V{} + 0.99999999, b = V{} + 1.E-8;  /* |x| stays in 1e-5...1e5 for n<1e9 */
+#pragma GCC unroll 16
+  for (int k = 0; k < C; ++k) x[k] = V{} + (1. + k * 1.E-3);  /* constant indices only, else x stays in memory */
+  double time_start = gettime();
+  for (unsigned long i = 0; i < n; ++i)
+#pragma GCC unroll 16
+    for (int k = 0; k < C; ++k) {  /* unrolled: all chains in registers */
+      x[k] = op<OP>(x[k], a, b);
+      keep(x[k]);
+    }
+  double time_diff = gettime() - time_start;
+#pragma GCC unroll 16
+  for (int k = 0; k < C; ++k) {
+    if constexpr (std::is_same_v<V, double>) sink += x[k];
+    else sink += x[k][0];
+  }
+  return time_diff;
+}
+
+/* best time per iteration [s], n doubled until a sample takes mintime */
+template <typename V, Top OP, int C>
+double measure(double mintime) {
+  unsigned long n = 1000;
+  double best = 0.;
+  for (int sample = 0; sample < NUMSAMPLES;) {
+    double t = run<V, OP, C>(n);
+    if (t < mintime) {
+      n *= 2;
+      continue;
+    }
+    if (sample == 0 || t / n < best) best = t / n;
+    ++sample;
+  }
+  return best;
+}
+
+int corespersocket() {
+  int cores = 0;
+  if (FILE* f = std::fopen("/proc/cpuinfo", "r")) {
+    char line[256];
+    while (std::fgets(line, sizeof(line), f))
+      if (std::sscanf(line, "cpu cores : %d", &cores) == 1) break;
+    std::fclose(f);
+  }
+  if (cores < 1) cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  return cores;
+}
+
+struct Tresult {
+  double latency, throughput;  /* [s] per instruction */
+};
+
+template <typename V, Top OP>
+Tresult measure_op(double mintime) {
+  return {measure<V, OP, 1>(mintime), measure<V, OP, CHAINS>(mintime) / CHAINS};
+}
+
+template <typename V>
+void measure_width(double mintime, double frequency, int cores, Tresult result[]) {
+  constexpr int lanes = sizeof(V) / sizeof(double);
+  result[0] = measure_op<V, Top::Add>(mintime);
+  result[1] = measure_op<V, Top::Mul>(mintime);
+  result[2] = measure_op<V, Top::Fma>(mintime);
+  result[3] = measure_op<V, Top::Div>(mintime);
+  result[4] = measure_op<V, Top::Sqrt>(mintime);
+  for (int o = 0; o < NUMOPS; ++o) {
+    double gflops = opflop[o] * lanes / result[o].throughput / 1.E9;
+#ifndef __FMA__
+    if (ops[o] == Top::Fma && lanes > 1) gflops /= 2.;  /* mul+add: 2 instructions */
+#endif
+    std::printf("%s\t%s\t%g\t%g\t%g\t%g\t%g\n", Width<V>::name, opname[o], result[o].latency * frequency,
+                result[o].throughput * frequency, 1. / (result[o].throughput * frequency), gflops, gflops * cores);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  double mintime = DEFAULT_MINTIME;
+  if (argc > 1) mintime = std::atof(argv[1]);
+  if (mintime <= 0.) mintime = DEFAULT_MINTIME;
+
+  Ttsctimer timer;
+  tsctimer_init(&timer);
+  double frequency = 0.;
+  for (int sample = 0; sample < NUMSAMPLES; ++sample)
+    frequency = std::fmax(frequency, tsctimer_corefrequency(&timer, mintime));
+  int cores = corespersocket();
+  if (!(frequency > 0.)) {
+    std::printf("ERROR clock frequency not measurable on this architecture\n");
+    std::exit(1);
+  }
+  std::printf("clock frequency:\t%g GHz (dependent integer adds)\n", frequency / 1.E9);
+  std::printf("cores per socket:\t%d\n", cores);
+  std::printf("# width\top\tlatency[cycles]\tthroughput[cycles/instr]\tinstr/cycle\tGFlOp/s/core\tGFlOp/s/socket\n");
+
+  Tresult scalar[NUMOPS];
+  measure_width<double>(mintime, frequency, cores, scalar);
+#ifdef __SSE2__
+  Tresult sse2[NUMOPS];
+  measure_width<V128>(mintime, frequency, cores, sse2);
+#endif
+#ifdef __AVX2__
+  Tresult avx2[NUMOPS];
+  measure_width<V256>(mintime, frequency, cores, avx2);
+#endif
+#ifdef __AVX512F__
+  Tresult avx512[NUMOPS];
+  measure_width<V512>(mintime, frequency, cores, avx512);
+#endif
+
+  /* Mandelbrot iteration: 10 FlOp, dependent chain Zreal -> Zreal */
+  const Titer maxiter = 10000000;
+  volatile Tfloat C0 = 0.;  /* not known at compile time */
+  double best = 0.;
+  for (int sample = 0; sample < NUMSAMPLES; ++sample) {
+    double time_start = gettime();
+    Titer i = mandelbrot_point(C0, C0, maxiter, 4.);
+    double t = (gettime() - time_start) / maxiter;
+    sink += i;
+    if (sample == 0 || t < best) best = t;
+  }
+  const int Add = 0, Mul = 1;  /* index in ops */
+#ifdef __FMA__
+  const int Fma = 2;
+  double critical = scalar[Mul].latency + scalar[Fma].latency + scalar[Add].latency;
+  const int fpinstr = 7;  /* Zi*Zi, fms, +Cr, 2*Zr, fma(Zi), Zi*Zi, fma(|Z|^2) */
+  const char* path = "mul+fma+add";
+#else
+  double critical = scalar[Mul].latency + 2. * scalar[Add].latency;
+  const int fpinstr = 10;
+  const char* path = "mul+sub+add";
+#endif
+  double throughputbound = fpinstr * scalar[Add].throughput;  /* add/mul/fma share the ports */
+  std::printf("# Mandelbrot iteration (mandelbrot_point, scalar, 10 FlOp)\n");
+  std::printf("measured:\t%g cycles/iteration\t%g GFlOp/s\n", best * frequency, 10. / best / 1.E9);
+  std::printf("latency bound (%s):\t%g cycles/iteration\n", path, critical * frequency);
+  std::printf("throughput bound (%d FP instructions):\t%g cycles/iteration\n", fpinstr, throughputbound * frequency);
+  std::printf("measured/latency bound:\t%g\n", best / critical);
+  std::printf("measured/throughput bound:\t%g\t(latency bound/throughput bound: %g)\n", best / throughputbound,
+              critical / throughputbound);
+  if (sink == 0.) std::printf("#\n");  /* use the results */
+
+  return 0;
+}
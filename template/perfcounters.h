@@ -0,0 +1,254 @@
+/* perfcounters.h
+   hardware performance counters with Linux perf_event_open (no PAPI needed)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static inline functions), just #include "perfcounters.h"
+
+	Tperfcounters pc;
+	perfcounters_open(&pc);		// once, one note line on stderr lists the counters not available
+	perfcounters_start(&pc);
+	...				// timed region
+	perfcounters_stop(&pc);
+	double cycles=perfcounters_value(&pc,PERFCOUNTER_CYCLES);	// NAN if not available
+	perfcounters_close(&pc);
+
+	counters:
+	  cycles, instructions	generic hardware events
+	  LLC misses		generic cache-misses event (last level cache)
+	  DTLB misses		data TLB load misses
+	  FP ops		double precision floating point operations, Intel only (FP_ARITH_INST_RETIRED
+				 scalar, 128, 256 and 512 bit packed weighted with 1, 2, 4, 8; FMA counts 2)
+	  ref-cycles		reference cycles (constant rate, on Intel the TSC frequency)
+	  APERF, MPERF		actual/reference cycles of the msr PMU (/sys/bus/event_source/devices/msr)
+	perfcounters_frequency(&pc,tscfrequency) is the effective core frequency in the counted
+	region: APERF/MPERF or cycles/ref-cycles times the reference (TSC) frequency.
+	perfcounters_openfrequency(&pc) opens only these four (no note line), for the
+	frequency of a timed region without the other counters.
+	Each counter is opened separately, i.e. the ones the PMU (or the VM, or
+	/proc/sys/kernel/perf_event_paranoid) does not offer are skipped and return NAN.
+	If there are more events than hardware counters, the kernel multiplexes them and
+	the values are extrapolated with time_enabled/time_running.
+	Only user space of the calling thread is counted (and of threads created later, after
+	they have finished: inherit).
+*/
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include<stdio.h>	/* fprintf(),fopen() */
+#include<string.h>	/* memset(),strstr() */
+#include<math.h>	/* NAN */
+#ifdef __linux__
+#include<unistd.h>	/* syscall(),read(),close() */
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<linux/perf_event.h>
+#endif
+
+typedef enum {
+	PERFCOUNTER_CYCLES, PERFCOUNTER_INSTRUCTIONS, PERFCOUNTER_LLCMISSES, PERFCOUNTER_DTLBMISSES, PERFCOUNTER_FPOPS,
+	PERFCOUNTER_REFCYCLES, PERFCOUNTER_APERF, PERFCOUNTER_MPERF,
+	NUMPERFCOUNTERS
+} Tperfcounter;
+static const char *const perfcountername[NUMPERFCOUNTERS]={"cycles","instructions","LLCmisses","DTLBmisses","FPops"
+                                                          ,"refcycles","APERF","MPERF"};
+
+#define NUMPERFEVENTS (NUMPERFCOUNTERS-1+4)	/* FP ops: 4 events */
+
+typedef struct {
+	int fd[NUMPERFEVENTS];
+	double weight[NUMPERFEVENTS];
+	Tperfcounter counter[NUMPERFEVENTS];
+	double value[NUMPERFCOUNTERS];
+	int available[NUMPERFCOUNTERS];
+} Tperfcounters;
+
+
+#ifdef __linux__
+static inline int perfcounters_openevent(unsigned int type, unsigned long long config)
+{
+	struct perf_event_attr attr;
+	memset(&attr,0,sizeof(attr));
+	attr.size=sizeof(attr);
+	attr.type=type;
+	attr.config=config;
+	attr.disabled=1;
+	attr.inherit=1;
+	if(type<PERF_TYPE_MAX)
+	{	/* the dynamic PMUs (msr) do not support the filters */
+		attr.exclude_kernel=1;
+		attr.exclude_hv=1;
+	}
+	attr.read_format=PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(__NR_perf_event_open,&attr,0,-1,-1,0);	/* this process, any CPU */
+}
+
+/* PMU type and event config from sysfs (e.g. msr/aperf), 0 if not available */
+static inline int perfcounters_sysfsevent(const char *pmu, const char *event, unsigned int *type, unsigned long long *config)
+{
+	char path[256];
+	FILE *f;
+	int ok;
+	snprintf(path,sizeof(path),"/sys/bus/event_source/devices/%s/type",pmu);
+	if(!(f=fopen(path,"r"))) return 0;
+	ok=(fscanf(f,"%u",type)==1);
+	fclose(f);
+	snprintf(path,sizeof(path),"/sys/bus/event_source/devices/%s/events/%s",pmu,event);
+	if(!ok || !(f=fopen(path,"r"))) return 0;
+	ok=(fscanf(f,"event=%llx",config)==1);
+	fclose(f);
+	return ok;
+}
+
+static inline int perfcounters_intelcpu(void)
+{
+	char line[256];
+	int intel=0;
+	FILE *f=fopen("/proc/cpuinfo","r");
+	if(!f) return 0;
+	while(fgets(line,sizeof(line),f))
+		if(strstr(line,"vendor_id"))
+		{
+			intel=(strstr(line,"GenuineIntel")!=NULL);
+			break;
+		}
+	fclose(f);
+	return intel;
+}
+#endif
+
+/* open the counters of mask (bits 1<<Tperfcounter), note line with the missing ones if verbose */
+static inline void perfcounters_openmask(Tperfcounters *pc, unsigned int mask, int verbose)
+{
+	int e, k;
+	memset(pc,0,sizeof(*pc));
+	for(e=0;e<NUMPERFEVENTS;++e) pc->fd[e]=-1;
+#ifdef __linux__
+	struct { Tperfcounter counter; unsigned int type; unsigned long long config; double weight; } events[NUMPERFEVENTS]={
+		{PERFCOUNTER_CYCLES,      PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES,1.},
+		{PERFCOUNTER_INSTRUCTIONS,PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS,1.},
+		{PERFCOUNTER_LLCMISSES,   PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES,1.},
+		{PERFCOUNTER_DTLBMISSES,  PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_DTLB|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16),1.},
+		/* Intel FP_ARITH_INST_RETIRED (event 0xC7), umask: scalar double, 128b/256b/512b packed double */
+		{PERFCOUNTER_FPOPS,       PERF_TYPE_RAW,0x01C7,1.},
+		{PERFCOUNTER_FPOPS,       PERF_TYPE_RAW,0x04C7,2.},
+		{PERFCOUNTER_FPOPS,       PERF_TYPE_RAW,0x10C7,4.},
+		{PERFCOUNTER_FPOPS,       PERF_TYPE_RAW,0x40C7,8.},
+		{PERFCOUNTER_REFCYCLES,   PERF_TYPE_HARDWARE,PERF_COUNT_HW_REF_CPU_CYCLES,1.},
+		{PERFCOUNTER_APERF,       PERF_TYPE_MAX,0,1.},	/* type and config from sysfs */
+		{PERFCOUNTER_MPERF,       PERF_TYPE_MAX,0,1.}};
+	if(!perfcounters_sysfsevent("msr","aperf",&events[NUMPERFEVENTS-2].type,&events[NUMPERFEVENTS-2].config)
+	   || !perfcounters_sysfsevent("msr","mperf",&events[NUMPERFEVENTS-1].type,&events[NUMPERFEVENTS-1].config))
+		events[NUMPERFEVENTS-2].type=events[NUMPERFEVENTS-1].type=PERF_TYPE_MAX;	/* not available */
+	int intel=perfcounters_intelcpu();
+	int fpevents=0;
+	for(e=0;e<NUMPERFEVENTS;++e)
+	{
+		pc->counter[e]=events[e].counter;
+		pc->weight[e]=events[e].weight;
+		if((events[e].type==PERF_TYPE_RAW && !intel) || events[e].type==PERF_TYPE_MAX
+		   || !(mask&(1U<<events[e].counter))) continue;
+		pc->fd[e]=perfcounters_openevent(events[e].type,events[e].config);
+		if(events[e].counter==PERFCOUNTER_FPOPS)
+			fpevents+=(pc->fd[e]>=0);
+		else
+			pc->available[events[e].counter]=(pc->fd[e]>=0);
+	}
+	/* FP ops only if all widths are counted (512 bit might not exist on older CPUs: counts 0) */
+	pc->available[PERFCOUNTER_FPOPS]=(fpevents==4);
+	if(!pc->available[PERFCOUNTER_FPOPS])
+		for(e=0;e<NUMPERFEVENTS;++e)
+			if(pc->counter[e]==PERFCOUNTER_FPOPS && pc->fd[e]>=0)
+			{
+				close(pc->fd[e]);
+				pc->fd[e]=-1;
+			}
+#endif
+	int missing=0;
+	for(k=0;k<NUMPERFCOUNTERS;++k)
+	{
+		pc->value[k]=NAN;
+		if(pc->available[k] || !verbose || !(mask&(1U<<k))) continue;
+		fprintf(stderr,"%s %s",missing?"":"# perfcounters not available:",perfcountername[k]);
+		missing=1;
+	}
+	if(missing) fprintf(stderr,"\n");
+}
+
+static inline void perfcounters_open(Tperfcounters *pc)
+{
+	perfcounters_openmask(pc,(1U<<NUMPERFCOUNTERS)-1,1);
+}
+
+/* cycles, ref-cycles, APERF and MPERF only: perfcounters_frequency() */
+static inline void perfcounters_openfrequency(Tperfcounters *pc)
+{
+	perfcounters_openmask(pc,1U<<PERFCOUNTER_CYCLES|1U<<PERFCOUNTER_REFCYCLES|1U<<PERFCOUNTER_APERF|1U<<PERFCOUNTER_MPERF,0);
+}
+
+static inline void perfcounters_start(Tperfcounters *pc)
+{
+#ifdef __linux__
+	int e;
+	for(e=0;e<NUMPERFEVENTS;++e)
+		if(pc->fd[e]>=0)
+		{
+			ioctl(pc->fd[e],PERF_EVENT_IOC_RESET,0);
+			ioctl(pc->fd[e],PERF_EVENT_IOC_ENABLE,0);
+		}
+#else
+	(void)pc;
+#endif
+}
+
+static inline void perfcounters_stop(Tperfcounters *pc)
+{
+	int k;
+#ifdef __linux__
+	int e;
+	for(e=0;e<NUMPERFEVENTS;++e)
+		if(pc->fd[e]>=0) ioctl(pc->fd[e],PERF_EVENT_IOC_DISABLE,0);
+	for(k=0;k<NUMPERFCOUNTERS;++k) pc->value[k]=pc->available[k]?0.:NAN;
+	for(e=0;e<NUMPERFEVENTS;++e)
+	{
+		unsigned long long v[3];	/* value, time_enabled, time_running */
+		if(pc->fd[e]<0) continue;
+		if(read(pc->fd[e],v,sizeof(v))!=(ssize_t)sizeof(v) || v[2]==0)
+		{	/* never scheduled */
+			pc->value[pc->counter[e]]=NAN;
+			continue;
+		}
+		pc->value[pc->counter[e]]+=pc->weight[e]*(double)v[0]*((double)v[1]/(double)v[2]);
+	}
+#else
+	for(k=0;k<NUMPERFCOUNTERS;++k) pc->value[k]=NAN;
+#endif
+}
+
+static inline double perfcounters_value(const Tperfcounters *pc, Tperfcounter k)
+{
+	return pc->value[k];
+}
+
+/* effective core frequency [Hz] of the counted region, NAN if not available */
+static inline double perfcounters_frequency(const Tperfcounters *pc, double reffrequency)
+{
+	double v=NAN;
+	if(pc->available[PERFCOUNTER_APERF] && pc->available[PERFCOUNTER_MPERF])
+		v=pc->value[PERFCOUNTER_APERF]/pc->value[PERFCOUNTER_MPERF];
+	if(!(v>0.) && pc->available[PERFCOUNTER_CYCLES] && pc->available[PERFCOUNTER_REFCYCLES])
+		v=pc->value[PERFCOUNTER_CYCLES]/pc->value[PERFCOUNTER_REFCYCLES];
+	return (v>0.)?v*reffrequency:NAN;
+}
+
+static inline void perfcounters_close(Tperfcounters *pc)
+{
+#ifdef __linux__
+	int e;
+	for(e=0;e<NUMPERFEVENTS;++e)
+		if(pc->fd[e]>=0) close(pc->fd[e]);
+#endif
+	memset(pc->available,0,sizeof(pc->available));
+}
+
+#endif /* PERFCOUNTERS_H */
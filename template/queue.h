@@ -0,0 +1,79 @@
+/* queue.h
+   bounded (blocking) FIFO queue of pointers for pthread producer/consumer pipelines
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static functions), just #include "queue.h" (compile with -pthread)
+*/
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include<stdlib.h>	/* malloc(),free(),exit() */
+#include<stdio.h>	/* printf() */
+#include<pthread.h>
+
+typedef struct {
+	void **items;
+	unsigned int capacity, head, count;
+	int closed;
+	pthread_mutex_t mtx;
+	pthread_cond_t notempty, notfull;
+} Tqueue;
+
+static inline void queue_init(Tqueue *q, unsigned int capacity)
+{
+	q->items=(void**)malloc(capacity*sizeof(void*));
+	if(!q->items)
+	{
+		printf("ERROR allocating queue\n");
+		exit(1);
+	}
+	q->capacity=capacity; q->head=0; q->count=0; q->closed=0;
+	pthread_mutex_init(&q->mtx,NULL);
+	pthread_cond_init(&q->notempty,NULL);
+	pthread_cond_init(&q->notfull,NULL);
+}
+
+static inline void queue_destroy(Tqueue *q)
+{
+	pthread_cond_destroy(&q->notfull);
+	pthread_cond_destroy(&q->notempty);
+	pthread_mutex_destroy(&q->mtx);
+	free(q->items);
+}
+
+static inline void queue_push(Tqueue *q, void *item)
+{	/* blocks while the queue is full */
+	pthread_mutex_lock(&q->mtx);
+	while(q->count==q->capacity) pthread_cond_wait(&q->notfull,&q->mtx);
+	q->items[(q->head+q->count)%q->capacity]=item;
+	++q->count;
+	pthread_cond_signal(&q->notempty);
+	pthread_mutex_unlock(&q->mtx);
+}
+
+static inline void* queue_pop(Tqueue *q)
+{	/* blocks while the queue is empty, returns NULL if empty and closed */
+	void *item=NULL;
+	pthread_mutex_lock(&q->mtx);
+	while(q->count==0 && !q->closed) pthread_cond_wait(&q->notempty,&q->mtx);
+	if(q->count>0)
+	{
+		item=q->items[q->head];
+		q->head=(q->head+1)%q->capacity;
+		--q->count;
+		pthread_cond_signal(&q->notfull);
+	}
+	pthread_mutex_unlock(&q->mtx);
+	return item;
+}
+
+static inline void queue_close(Tqueue *q)
+{	/* no more items will be pushed */
+	pthread_mutex_lock(&q->mtx);
+	q->closed=1;
+	pthread_cond_broadcast(&q->notempty);
+	pthread_mutex_unlock(&q->mtx);
+}
+
+#endif /* QUEUE_H */
@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+# results.py
+# machine-readable results store (JSON lines) with regression detection against baselines
+# M. Bernreuther <bernreuther@hlrs.de>
+#
+#  ./results.py record -b stream_ref -o stream_ref.jsonl < <(for i in `seq 10`; do ./stream_ref 100000; done)
+#    benchmark output (stream_ref, stream_ref_func, ... lines, "# env" lines of envcheck.sh)
+#    from stdin, without "# env" lines the fingerprint of envcheck.sh is recorded
+#  ./results.py import -o old.jsonl stream_list_vissgs17.dat ../ue3-10.6/avx.dat
+#    existing .dat files: stream_ref lines (current and older column layout, the tab groups
+#    are the same), run.sh ("N (rep)<tab>median mean min max<tab>FlOp/s") and the "N nrepeat time"
+#    of ue3-10.6/stream_template.c (kernel time, time per repetition, threads 1) or
+#    "N nrepeat time wtime" of ue4-17.6/stream_template_omp.c (kernel time_omp, metrics time and
+#    wtime (omp_get_wtime()) per repetition, threads 0: OMP_NUM_THREADS is not in the output)
+#  ./results.py compare baseline.jsonl candidate.jsonl [--alpha 0.05] [--threshold 0.05]
+#    aligned by kernel/N/threads, Mann-Whitney U test per point (>=MINSAMPLES samples each, else
+#    only the threshold; exact U distribution without ties up to EXACTMAXN samples, else the
+#    normal approximation), exit status 1 if a point is significantly slower by more than threshold
+#    (3 vs. 3 samples cannot reach p<0.05: complete separation gives p=0.1)
+#
+# file format: one JSON object per line
+#  {"record": "run", "source": ..., "date": ..., "env": {key: value}}	fingerprint of the following points
+#  {"record": "point", "kernel": ..., "N": ..., "threads": ..., "metric": "time_iter", "unit": "s",
+#   "samples": [...]}	equal kernel/N/threads lines of a source are merged into samples
+#  (time metrics: smaller is better)
+
+import argparse
+import json
+import math
+import os
+import re
+import subprocess
+import sys
+import time
+
+MINSAMPLES = 4  # per side for the test, 4 vs. 4 separated completely: p=0.029
+EXACTMAXN = 20  # n1+n2 up to which the exact U distribution is used (without ties)
+
+
+def parse_dat(lines, source):
+    """run record and points of benchmark output or .dat lines"""
+    env = {}
+    points = {}
+    for line in lines:
+        line = line.rstrip('\n')
+        if not line.strip():
+            continue
+        if line.startswith('#'):
+            m = re.match(r'#\s*env\s+([^:]+):\s*(.*)', line)
+            if m:
+                env[m.group(1)] = m.group(2)
+                continue
+            m = re.match(r'#\s*running\s+(\S+)\s+on\s+(\S+)\s+\((.*)\)', line)
+            if m:
+                env.setdefault('host', m.group(2))
+                env.setdefault('cpu', m.group(3))
+            continue
+        fields = line.split()
+        try:
+            if re.match(r'^[0-9]', fields[0]) is None:
+                # stream_ref: "bintype #PE\tbmtype\tN\t...\t\ttime_diff\t\ttime_avg\ttime_iter\t\t..."
+                groups = line.split('\t\t')
+                if len(groups) < 3 or len(fields) < 4:
+                    continue  # e.g. maxerror=0
+                kernel = '%s/%s' % (fields[0], fields[2])
+                n = int(fields[3])
+                threads = int(fields[1])
+                metric, value = 'time_iter', float(groups[2].split()[1])
+            elif '(' in line:
+                # run.sh: "N (rep)\tmedian mean min max\tFlOp/s"
+                m = re.match(r'(\d+)\s+\((\d+)\)\s+(\S+)', line)
+                if m is None:
+                    continue
+                kernel, n, threads = 'run', int(m.group(1)), 1
+                metric, value = 'runtime_median', float(m.group(3))
+            elif len(fields) in (3, 4):
+                # "N nrepeat time" (ue3-10.6), "N nrepeat time wtime" (ue4-17.6 OpenMP)
+                n, nrepeat = int(fields[0]), int(fields[1])
+                if nrepeat < 1:
+                    continue
+                kernel, threads = ('time', 1) if len(fields) == 3 else ('time_omp', 0)
+                if len(fields) == 4:
+                    wtime = float(fields[3]) / nrepeat
+                    if math.isfinite(wtime):
+                        points.setdefault((kernel, n, threads, 'wtime'), []).append(wtime)
+                metric, value = 'time', float(fields[2]) / nrepeat
+            else:
+                continue
+        except (ValueError, IndexError):
+            continue
+        if not math.isfinite(value):
+            continue
+        key = (kernel, n, threads, metric)
+        points.setdefault(key, []).append(value)
+    run = {'record': 'run', 'source': source, 'date': time.strftime('%Y-%m-%dT%H:%M:%S'), 'env': env}
+    return run, [{'record': 'point', 'kernel': k[0], 'N': k[1], 'threads': k[2], 'metric': k[3], 'unit': 's',
+                  'samples': v} for k, v in points.items()]
+
+
+def envcheck(binary=None):
+    """fingerprint of envcheck.sh (next to this script)"""
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'envcheck.sh')
+    if not os.path.exists(script):
+        return {}
+    out = subprocess.run(['bash', script] + (['-b', binary] if binary else []), stdout=subprocess.PIPE,
+                         universal_newlines=True).stdout
+    return parse_dat(out.splitlines(), script)[0]['env']
+
+
+def write(out, records):
+    for r in records:
+        out.write(json.dumps(r) + '\n')
+
+
+def load(filename):
+    """points {(kernel, N, threads, metric): samples} and the fingerprints"""
+    points, envs = {}, []
+    with open(filename) as f:
+        for line in f:
+            if not line.strip():
+                continue
+            r = json.loads(line)
+            if r.get('record') == 'run':
+                envs.append(r.get('env', {}))
+            elif r.get('record') == 'point':
+                key = (r['kernel'], r['N'], r['threads'], r['metric'])
+                points.setdefault(key, []).extend(r['samples'])
+    return points, envs
+
+
+def median(x):
+    s = sorted(x)
+    return (s[(len(s) - 1) // 2] + s[len(s) // 2]) / 2.
+
+
+def mannwhitney_exact(n1, n2, u):
+    """two-sided p of U for n1, n2 samples without ties: counts of the rank arrangements"""
+    # count[u] for the current (i, j), c(i, j, u) = c(i-1, j, u-j) + c(i, j-1, u)
+    count = [[[1] if i == 0 or j == 0 else None for j in range(n2 + 1)] for i in range(n1 + 1)]
+    for i in range(1, n1 + 1):
+        for j in range(1, n2 + 1):
+            c = [0] * (i * j + 1)
+            for k, v in enumerate(count[i - 1][j]):
+                c[k + j] += v
+            for k, v in enumerate(count[i][j - 1]):
+                c[k] += v
+            count[i][j] = c
+    c = count[n1][n2]
+    total = float(sum(c))
+    u = int(round(u))
+    return min(1., 2. * min(sum(c[:u + 1]), sum(c[u:])) / total)
+
+
+def mannwhitney(x, y):
+    """two-sided p of the Mann-Whitney U test (exact for small samples without ties, else
+    normal approximation with tie correction)"""
+    values = sorted([(v, 0) for v in x] + [(v, 1) for v in y])
+    n1, n2 = len(x), len(y)
+    n = n1 + n2
+    ranksum, ties, i = 0., 0., 0
+    while i < n:
+        j = i
+        while j < n and values[j][0] == values[i][0]:
+            j += 1
+        rank = (i + 1 + j) / 2.
+        ranksum += rank * sum(1 for k in range(i, j) if values[k][1] == 0)
+        t = j - i
+        ties += t ** 3 - t
+        i = j
+    u = ranksum - n1 * (n1 + 1) / 2.
+    if ties == 0. and n <= EXACTMAXN:
+        return mannwhitney_exact(n1, n2, u)
+    mean = n1 * n2 / 2.
+    var = n1 * n2 / 12. * ((n + 1) - ties / (n * (n - 1)))
+    if var <= 0.:
+        return 1.
+    z = max(abs(u - mean) - 0.5, 0.) / math.sqrt(var)
+    return min(1., math.erfc(z / math.sqrt(2.)))
+
+
+def compare(args):
+    base, baseenvs = load(args.baseline)
+    cand, candenvs = load(args.candidate)
+    if baseenvs and candenvs:
+        b, c = baseenvs[0], candenvs[0]
+        for key in sorted(set(b) | set(c)):
+            if key not in ('loadavg', 'date') and b.get(key) != c.get(key):
+                print('# WARNING environment differs: %s: %s -> %s' % (key, b.get(key), c.get(key)))
+    print('# kernel\tN\tthreads\tmetric\tbaseline(median)\tcandidate(median)\tratio\tp(Mann-Whitney)\tverdict')
+    regressions = 0
+    for key in sorted(set(base) & set(cand)):
+        x, y = base[key], cand[key]
+        ratio = median(y) / median(x) if median(x) > 0. else math.nan
+        tested = len(x) >= MINSAMPLES and len(y) >= MINSAMPLES
+        p = mannwhitney(x, y) if tested else math.nan
+        significant = (p < args.alpha) if tested else True
+        verdict = ''
+        if ratio > 1. + args.threshold and significant:
+            verdict = 'REGRESSION' if tested else 'REGRESSION (untested, <%d samples)' % MINSAMPLES
+            regressions += 1
+        elif ratio < 1. - args.threshold and significant:
+            verdict = 'improvement' if tested else 'improvement (untested)'
+        print('%s\t%d\t%d\t%s\t%g\t%g\t%.4f\t%g\t%s' % (key + (median(x), median(y), ratio, p, verdict)))
+    for key in sorted(set(base) ^ set(cand)):
+        print('# only in %s: %s N=%d threads=%d %s' % ((args.baseline if key in base else args.candidate,) + key))
+    print('# %d regressions' % regressions)
+    return 1 if regressions else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='benchmark results store and regression check')
+    sub = parser.add_subparsers(dest='command')
+    p = sub.add_parser('record', help='benchmark output from stdin')
+    p.add_argument('-o', '--output', help='append to (default: stdout)')
+    p.add_argument('-b', '--binary', help='benchmark binary (compiler and flags for the fingerprint)')
+    p = sub.add_parser('import', help='existing .dat files')
+    p.add_argument('-o', '--output', help='append to (default: stdout)')
+    p.add_argument('files', nargs='+')
+    p = sub.add_parser('compare', help='exit status 1 on significant regressions')
+    p.add_argument('baseline')
+    p.add_argument('candidate')
+    p.add_argument('--alpha', type=float, default=0.05, help='significance level')
+    p.add_argument('--threshold', type=float, default=0.05, help='relative slowdown to report')
+    args = parser.parse_args()
+
+    if args.command == 'compare':
+        sys.exit(compare(args))
+    if args.command == 'record':
+        run, points = parse_dat(sys.stdin, 'stdin')
+        if not run['env']:
+            run['env'] = envcheck(args.binary)
+        inputs = [(run, points)]
+    elif args.command == 'import':
+        inputs = []
+        for filename in args.files:
+            with open(filename) as f:
+                run, points = parse_dat(f, filename)
+            run['date'] = time.strftime('%Y-%m-%dT%H:%M:%S', time.localtime(os.path.getmtime(filename)))
+            inputs.append((run, points))
+    else:
+        parser.print_help()
+        sys.exit(2)
+    out = open(args.output, 'a') if args.output else sys.stdout
+    for run, points in inputs:
+        if not points:
+            print('# WARNING no results in %s' % run['source'], file=sys.stderr)
+        write(out, [run] + points)
+    if args.output:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,336 @@
+/* roofline.c
+   roofline model: measured peak FlOp/s and L1/L2/L3/DRAM bandwidth, kernels placed by arithmetic intensity
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	gcc -march=native -O3 -pthread roofline.c -o roofline -lm
+	// -march=native: the peak is measured with the widest vectors available (AVX-512, AVX, SSE2)
+	//  and FMA contraction of x*a+b (-ffp-contract=fast, default for gcc)
+
+	roofline [<output prefix>] [<DRAM working set [MB]>]
+
+	e.g.
+	$ taskset -c 2 ./roofline roofline
+	$ gnuplot roofline.gplt		# -> roofline.eps
+
+	- cache sizes: /sys/devices/system/cpu/cpu0/cache (data or unified caches of level 1,2,3),
+	  defaults if not available
+	- peak: FMACHAINS independent chains x=x*a+b of the widest vector type (enough to cover
+	  the FMA latency times the number of FMA ports), 2 FlOp per FMA and vector element
+	- bandwidth: vector triad a=b*c+d (stream_kernels.h) with a working set of half the L1, L2
+	  and L3 size and at least 4x the L3 for DRAM (default max. MAXDRAMBYTES), best of NUMSAMPLES
+	- kernels: copy, add, sTRIAD, vTRIAD at the same working sets and the Mandelbrot kernel
+	  (mandelbrot.h, 10 FlOp per iteration), placed at
+	    arithmetic intensity = FlOp / Bytes (loads+stores as counted by stream_ref.c, without write allocate)
+	  copy has no FlOp (intensity 0) and only appears in the table.
+	All numbers are per core (one thread). The table lists the attainable performance
+	min(peak, intensity*bandwidth of that level) and the fraction reached (the roofs are the
+	vTRIAD bandwidths, kernels with another load/store ratio may exceed them slightly).
+	<prefix>.dat contains the roofs (commented, also set in the gnuplot script) and the points.
+*/
+
+#include<stdlib.h>	/* malloc(),free(),labs(),atol() */
+#include<stdio.h>	/* printf(),fopen(),fprintf() */
+#include<string.h>	/* strcmp() */
+
+#include "stream_kernels.h"
+#include "mandelbrot.h"	/* mandelbrot_rows(),gettime() */
+
+#define FMACHAINS 12
+#define NUMSAMPLES 5
+#define MINSAMPLETIME 0.02	/* [s] */
+#define MAXDRAMBYTES (1024UL<<20)
+#define MINDRAMBYTES (64UL<<20)
+/* if /sys does not tell */
+#define DEFAULT_L1SIZE (32UL<<10)
+#define DEFAULT_L2SIZE (1024UL<<10)
+#define DEFAULT_L3SIZE (8UL<<20)
+
+#if defined(__AVX512F__)
+#define VECLEN 8
+#elif defined(__AVX__)
+#define VECLEN 4
+#elif defined(__SSE2__)
+#define VECLEN 2
+#else
+#define VECLEN 1
+#endif
+typedef double Tvec __attribute__((vector_size(VECLEN*sizeof(double))));
+/* in a (xmm/ymm/zmm) register and opaque to the optimizer, i.e. no store/reload of the chains */
+#ifdef __x86_64__
+#define KEEP(x) __asm__ volatile("" : "+v"(x))
+#else
+#define KEEP(x) __asm__ volatile("" : "+m"(x))
+#endif
+
+#define NUMLEVELS 4
+static const char *const levelname[NUMLEVELS]={"L1","L2","L3","DRAM"};
+
+
+unsigned long cachesize(unsigned int level)
+{	/* data or unified cache of cpu0 [Bytes], 0 if unknown */
+	unsigned int index;
+	for(index=0;index<16;++index)
+	{
+		char path[128], type[32]="", unit=' ';
+		unsigned int l=0;
+		unsigned long size=0;
+		FILE *f;
+		snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%u/level",index);
+		if(!(f=fopen(path,"r"))) break;
+		if(fscanf(f,"%u",&l)!=1) l=0;
+		fclose(f);
+		snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%u/type",index);
+		if((f=fopen(path,"r")))
+		{
+			if(fscanf(f,"%31s",type)!=1) type[0]='\0';
+			fclose(f);
+		}
+		if(l!=level || (strcmp(type,"Data") && strcmp(type,"Unified"))) continue;
+		snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%u/size",index);
+		if((f=fopen(path,"r")))
+		{
+			if(fscanf(f,"%lu%c",&size,&unit)<1) size=0;
+			fclose(f);
+		}
+		if(unit=='K') size<<=10;
+		if(unit=='M') size<<=20;
+		return size;
+	}
+	return 0;
+}
+
+
+/* peak FlOp/s ==================================================================================*/
+double peak_flops(void)
+{
+	Tvec x[FMACHAINS], a, b, sum;
+	double flops=0.;
+	unsigned long n=1000, i;
+	int k, sample;
+	for(k=0;k<VECLEN;++k) { a[k]=0.999999; b[k]=1.E-6; }	/* fixed point x=1, no overflow, no denormals */
+	for(sample=0;sample<NUMSAMPLES;)
+	{
+#pragma GCC unroll 16
+		for(k=0;k<FMACHAINS;++k) x[k]=a*(double)(k+1);	/* constant indices only, else x stays in memory */
+		double time_start=gettime();
+		for(i=0;i<n;++i)
+		{
+#pragma GCC unroll 16
+			for(k=0;k<FMACHAINS;++k)
+			{	/* independent chains, unrolled: all in registers (as peakflops.cpp) */
+				x[k]=x[k]*a+b;
+				KEEP(x[k]);
+			}
+		}
+		double time_diff=gettime()-time_start;
+		sum=x[0];
+#pragma GCC unroll 16
+		for(k=1;k<FMACHAINS;++k) sum+=x[k];
+		if(sum[0]==0.) printf("#");	/* use the result */
+		if(time_diff<MINSAMPLETIME)
+		{
+			n*=2;
+			continue;
+		}
+		double f=2.*VECLEN*FMACHAINS*n/time_diff;
+		if(f>flops) flops=f;
+		++sample;
+	}
+	return flops;
+}
+
+
+/* stream kernels ===============================================================================*/
+typedef struct {
+	const Tstreamkernel *kernel;
+	unsigned int numarrays, flop;	/* per element */
+} Tbenchkernel;
+
+/* best of NUMSAMPLES [s] for one sweep over N elements */
+double time_stream(const Tstreamkernel *k, Tindex N, Tfloat *a, Tfloat *b, Tfloat *c, Tfloat *d)
+{
+	double best=0.;
+	unsigned long nrepeat=1, j;
+	int sample;
+	for(sample=0;sample<NUMSAMPLES;)
+	{
+		double time_start=gettime();
+		for(j=0;j<nrepeat;++j) k->func(N,1,a,b,c,d,1.0001);
+		double time_diff=gettime()-time_start;
+		if(time_diff<MINSAMPLETIME)
+		{
+			nrepeat*=2;
+			continue;
+		}
+		if(sample==0 || time_diff/nrepeat<best) best=time_diff/nrepeat;
+		++sample;
+	}
+	return best;
+}
+
+
+int main(int argc, char *argv[])
+{
+	const char *prefix="roofline";
+	unsigned long drambytes=0;
+	if (argc>1) prefix=argv[1];
+	if (argc>2) drambytes=labs(atol(argv[2]))<<20;
+
+	unsigned long cache[3];
+	unsigned int l;
+	for(l=0;l<3;++l) cache[l]=cachesize(l+1);
+	if(!cache[0]) cache[0]=DEFAULT_L1SIZE;
+	if(!cache[1]) cache[1]=DEFAULT_L2SIZE;
+	if(!cache[2]) cache[2]=DEFAULT_L3SIZE;
+	if(!drambytes)
+	{
+		drambytes=4*cache[2];
+		if(drambytes>MAXDRAMBYTES) drambytes=MAXDRAMBYTES;
+		if(drambytes<MINDRAMBYTES) drambytes=MINDRAMBYTES;
+	}
+	unsigned long workingset[NUMLEVELS]={cache[0]/2,cache[1]/2,cache[2]/2,drambytes};
+	printf("caches:\tL1 %lu kB\tL2 %lu kB\tL3 %lu kB\n",cache[0]>>10,cache[1]>>10,cache[2]>>10);
+	if(drambytes<2*cache[2]) printf("WARNING DRAM working set %lu MB < 2x L3\n",drambytes>>20);
+
+	/* peak */
+	double peak=peak_flops();
+	printf("peak:\t%g FlOp/s\t(%d x %d doubles FMA chains)\n",peak,FMACHAINS,VECLEN);
+
+	/* kernels (scalar loops of stream_kernels.h, vectorized by the compiler) */
+	static const Tbenchkernel kernels[]={
+		{&streamkernels[0],2,0},	/* copy_scalar */
+		{&streamkernels[1],3,1},	/* add_scalar */
+		{&streamkernels[2],3,2},	/* striad_scalar */
+		{&streamkernels[3],4,2}};	/* vtriad_scalar */
+	const unsigned int numkernels=sizeof(kernels)/sizeof(kernels[0]), triad=3;
+
+	/* a,b used by all kernels (2 arrays: longest), c from 3 arrays on, d only by vTRIAD */
+	Tindex Nab=drambytes/(2*sizeof(Tfloat)), Nc=drambytes/(3*sizeof(Tfloat)), Nd=drambytes/(4*sizeof(Tfloat));
+	Tfloat *a=(Tfloat*)malloc(Nab*sizeof(Tfloat)), *b=(Tfloat*)malloc(Nab*sizeof(Tfloat));
+	Tfloat *c=(Tfloat*)malloc(Nc*sizeof(Tfloat)), *d=(Tfloat*)malloc(Nd*sizeof(Tfloat));
+	if(!a || !b || !c || !d)
+	{
+		printf("ERROR allocating memory (%lu Bytes)\n",(2*Nab+Nc+Nd)*sizeof(Tfloat));
+		exit(1);
+	}
+	Tindex i;
+	for(i=0;i<Nab;++i) { a[i]=0.; b[i]=1.; }	/* first touch */
+	for(i=0;i<Nc;++i) c[i]=2.;
+	for(i=0;i<Nd;++i) d[i]=3.;
+
+	double bandwidth[NUMLEVELS], achieved[4][NUMLEVELS];
+	unsigned int lv, k;
+	for(lv=0;lv<NUMLEVELS;++lv)
+		for(k=0;k<numkernels;++k)
+		{
+			Tindex N=workingset[lv]/(kernels[k].numarrays*sizeof(Tfloat));
+			double t=time_stream(kernels[k].kernel,N,a,b,c,d);
+			double bytes=(double)N*kernels[k].numarrays*sizeof(Tfloat);
+			achieved[k][lv]=(double)N*kernels[k].flop/t;
+			if(k==triad) bandwidth[lv]=bytes/t;
+			if(k==0) achieved[k][lv]=bytes/t;	/* copy: Byte/s instead */
+		}
+
+	/* Mandelbrot: 10 FlOp per iteration, 1 store (Titer) per pixel */
+	Tview v;
+	view_init(&v,800,600,1000,-2.,-1.125,1.,1.125);
+	Titer *M=(Titer*)malloc(v.numcolumns*v.numrows*sizeof(Titer));
+	if(!M)
+	{
+		printf("ERROR allocating memory for Mandelbrot\n");
+		exit(1);
+	}
+	double time_mb=0.;
+	unsigned long sumiter=0;
+	int sample;
+	for(sample=0;sample<NUMSAMPLES;++sample)
+	{
+		double time_start=gettime();
+		sumiter=mandelbrot_rows(&v,M,0,v.numrows);
+		double time_diff=gettime()-time_start;
+		if(sample==0 || time_diff<time_mb) time_mb=time_diff;
+	}
+	double mb_intensity=10.*sumiter/((double)v.numcolumns*v.numrows*sizeof(Titer));
+	double mb_flops=10.*sumiter/time_mb;
+	free(M);
+
+	/* table */
+	printf("bandwidth (vTRIAD):");
+	for(lv=0;lv<NUMLEVELS;++lv) printf("\t%s %g Byte/s (%lu kB)",levelname[lv],bandwidth[lv],workingset[lv]>>10);
+	printf("\n");
+	printf("# kernel\tlevel\tFlOp/Byte\tFlOp/s\tattainable FlOp/s\tfraction\n");
+	for(k=0;k<numkernels;++k)
+	{
+		double intensity=kernels[k].flop/(double)(kernels[k].numarrays*sizeof(Tfloat));
+		for(lv=0;lv<NUMLEVELS;++lv)
+		{
+			if(k==0)
+			{	/* copy */
+				printf("%s\t%s\t0\t0 (%g Byte/s)\t-\t%g of bandwidth\n",streamopname[kernels[k].kernel->op],levelname[lv]
+				      ,achieved[k][lv],achieved[k][lv]/bandwidth[lv]);
+				continue;
+			}
+			double bound=intensity*bandwidth[lv];
+			if(bound>peak) bound=peak;
+			printf("%s\t%s\t%g\t%g\t%g\t%g\n",streamopname[kernels[k].kernel->op],levelname[lv],intensity
+			      ,achieved[k][lv],bound,achieved[k][lv]/bound);
+		}
+	}
+	double mb_bound=mb_intensity*bandwidth[NUMLEVELS-1];
+	if(mb_bound>peak) mb_bound=peak;
+	printf("Mandelbrot\tDRAM\t%g\t%g\t%g\t%g\n",mb_intensity,mb_flops,mb_bound,mb_flops/mb_bound);
+
+	/* data and gnuplot script */
+	char filename[1024];
+	snprintf(filename,sizeof(filename),"%s.dat",prefix);
+	FILE *f=fopen(filename,"w");
+	if(!f)
+	{
+		printf("ERROR opening %s\n",filename);
+		exit(2);
+	}
+	fprintf(f,"# roofline: peak %g FlOp/s\n",peak);
+	for(lv=0;lv<NUMLEVELS;++lv) fprintf(f,"# roof %s %g Byte/s (working set %lu Bytes)\n",levelname[lv],bandwidth[lv],workingset[lv]);
+	fprintf(f,"# kernel_level\tFlOp/Byte\tFlOp/s\n");
+	for(k=1;k<numkernels;++k)
+	{
+		double intensity=kernels[k].flop/(double)(kernels[k].numarrays*sizeof(Tfloat));
+		for(lv=0;lv<NUMLEVELS;++lv)
+			fprintf(f,"%s_%s\t%g\t%g\n",streamopname[kernels[k].kernel->op],levelname[lv],intensity,achieved[k][lv]);
+	}
+	fprintf(f,"Mandelbrot\t%g\t%g\n",mb_intensity,mb_flops);
+	fclose(f);
+	printf("data file:\t%s\n",filename);
+
+	snprintf(filename,sizeof(filename),"%s.gplt",prefix);
+	if(!(f=fopen(filename,"w")))
+	{
+		printf("ERROR opening %s\n",filename);
+		exit(2);
+	}
+	fprintf(f,"# %s (generated by roofline)\n",filename);
+	fprintf(f,"set encoding utf8\nset grid\nset key left top\nset logscale xy\n");
+	fprintf(f,"set title 'Roofline (per core)'\n");
+	fprintf(f,"set terminal postscript eps enhanced color\nset output '%s.eps'\n",prefix);
+	fprintf(f,"set xlabel 'arithmetic intensity [FlOp/Byte]'\nset ylabel '[FlOp/s]'\n");
+	fprintf(f,"set xrange [0.01:%g]\nset yrange [%g:%g]\nset samples 1000\n"
+	       ,mb_intensity>100.?mb_intensity*4.:400.,peak/1.E4,peak*2.);
+	fprintf(f,"peak=%g\n",peak);
+	for(lv=0;lv<NUMLEVELS;++lv) fprintf(f,"bw%s=%g\n",levelname[lv],bandwidth[lv]);
+	fprintf(f,"roof(x,bw)=(x*bw<peak)?x*bw:peak\n");
+	fprintf(f,"plot");
+	for(lv=0;lv<NUMLEVELS;++lv)
+		fprintf(f,"%s roof(x,bw%s) title '%s %.3g GByte/s' lw 2"
+		       ,lv?" \\\n   ,":"",levelname[lv],levelname[lv],bandwidth[lv]/1.E9);
+	fprintf(f," \\\n   ,'%s.dat' u 2:3 title 'kernels (%.3g GFlOp/s peak)' with points pt 7 ps 1.5",prefix,peak/1.E9);
+	fprintf(f," \\\n   ,'%s.dat' u 2:3:1 notitle with labels left offset 1,0 font ',8'\n",prefix);
+	fclose(f);
+	printf("gnuplot script:\t%s\n",filename);
+
+	free(d);
+	free(c);
+	free(b);
+	free(a);
+
+	return 0;
+}
@@ -3,6 +3,11 @@
 # start stream benchmarks, e.g. with
 #  ./run.sh stream_ref |tee stream_ref.dat
 # runtime on visgs about 1min
+# the environment fingerprint of envcheck.sh is embedded in the header
+# result cache: points measured before with the same binary (sha256), fingerprint,
+#  cpumask, N and repetitions are taken from ${RUNCACHE} if younger than RUNCACHE_TTL [s]
+#  ./run.sh -f stream_ref	force: measure all points (and update the cache)
+# in-cache points in parallel on cores without shared L2: sweep.py
 #
 # M. Bernreuther <bernreuther@hlrs.de>
 
@@ -11,6 +16,14 @@ cpumask='0x1'
 
 rep=25
 
+RUNCACHE="${RUNCACHE:-${HOME}/.cache/stream_run}"
+RUNCACHE_TTL=${RUNCACHE_TTL:-604800}	# [s] 1 week
+force=0
+if [ "$1" = "-f" ]; then
+	force=1
+	shift
+fi
+
 #d="`dirname $0`"
 ##d="$(readlink -f "$d")"
 #cd $d
@@ -37,6 +50,23 @@ echo    "# ${b}.dat"
 #os_release="`lsb_release -d | sed -e 's/\S*\s*//'`"
 echo    "# $b (`stat -c "size: %s mod.:%y" "$b"`)"
 echo    "# running $b on ${HOSTNAME} (`grep -m 1 'model name' /proc/cpuinfo | sed -e 's/.*:\s*//' -e 's/(R)//' -e 's/(TM)//'`)"
+# environment fingerprint, refuses e.g. with powersave governor or busy target cores
+envcheck="$(dirname "$(readlink -f "$0")")/envcheck.sh"
+fingerprint=""
+if [ -r "${envcheck}" ]; then
+	envout="$(bash "${envcheck}" ${cpumask:+-c ${cpumask}} -b "$b")"
+	envstatus=$?
+	echo "${envout}"
+	if [ ${envstatus} -ge 2 ] && [ "${ENVCHECK_FORCE}" != "1" ]; then
+		echo "# ERROR environment check failed (ENVCHECK_FORCE=1 to run anyway)"
+		exit 2
+	fi
+	# cache key: the settings, not the load or warnings
+	fingerprint="$(echo "${envout}" | grep '^# env ' | grep -v '^# env loadavg:')"
+fi
+binhash="$(sha256sum "$b" | cut -d ' ' -f 1)"
+mkdir -p "${RUNCACHE}" 2>/dev/null
+cached=0
 starttime=`date +%s`
 echo    "# starting at `date -d @${starttime} +'%d.%m.%Y %H:%M:%S'`"
 echo -e "# #PE (repetitions)\truntime(median,mean,min,max)"
@@ -45,6 +75,14 @@ for e in `seq 7`; do
 	for m in `seq 9`; do
 		n="$m${trailing0}"
 		#rep=$(( 100000000/1${trailing0} ))
+		key="$(printf '%s\n' "${binhash}" "${fingerprint}" "${cpumask}" "$n" "${rep}" | sha256sum | cut -d ' ' -f 1)"
+		cachefile="${RUNCACHE}/${key}"
+		if [ ${force} -eq 0 ] && [ -s "${cachefile}" ] \
+		   && [ $(( `date +%s`-`stat -c %Y "${cachefile}"` )) -lt ${RUNCACHE_TTL} ]; then
+			cat "${cachefile}"
+			cached=$(( cached+1 ))
+			continue
+		fi
 		runtimes=""
 		for i in `seq ${rep}`; do
 			if [ -n "${cpumask}" ]; then
@@ -61,11 +99,16 @@ for e in `seq 7`; do
 		rtmedavgminmax="$(echo "${runtimes}" | Rscript -e 'print(summary(scan("stdin")));' 2>/dev/null | tail -n 1 | awk '{print $3,$4,$1,$6}')"
 		runtime="$(echo "${rtmedavgminmax}" | awk '{print $1}')"
 		flops="$(echo "${runtime}" | sed -e "s/[eE]+*/*10^/;s#^#$n*2/(#;s/$/)/" | bc -l )"
-		echo -e "$n (${rep})\t${rtmedavgminmax}\t${flops}"
+		if [ -n "${rtmedavgminmax}" ]; then
+			echo -e "$n (${rep})\t${rtmedavgminmax}\t${flops}" | tee "${cachefile}"
+		else	# not cached
+			echo -e "$n (${rep})\t${rtmedavgminmax}\t${flops}"
+		fi
 	done
 	trailing0="${trailing0}0"
 done
 endtime=`date +%s`
+echo "# ${cached} points from the cache ${RUNCACHE}"
 echo "# finished at `date -d @${endtime} +'%d.%m.%Y %H:%M:%S'`"
 difftime=$(( ${endtime}-${starttime} ))
 printf "# running for %d sec (%d:%02d:%02d)\n" ${difftime} $((${difftime}/3600)) $((${difftime}/60 % 60)) $((${difftime} % 60))
@@ -0,0 +1,445 @@
+/* stream_kernels.h
+   registry of the vector streaming kernel variants (scalar, strided, SIMD, NT stores, threads)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static functions), just #include "stream_kernels.h"
+	(compile with -pthread, optionally -fopenmp, the SIMD variants depend on -march)
+
+	The loops are the ones of stream_ref.c (scalar, OpenMP), stream-stride_template.c (strided),
+	../bernremn.develop/stream_sse2.c and stream_avx.c (SIMD, NT stores) and
+	../ue4-17.6/stream_template.c (pthreads, blocked), made callable with a common signature
+		a=b          COPY
+		a=b+c        ADD
+		a=s*b+c      sTRIAD
+		a=b*c+d      vTRIAD
+	All variants accept any N and any (double aligned) address, i.e. the SIMD versions have
+	scalar peel and tail loops, and only write a[i] with i%stride==0, i<N.
+	Every op has scalar, OpenMP, pthread and SIMD (SSE2, AVX, AVX-512) variants, NT stores
+	for COPY and vTRIAD, FMA for the triads. Strided: vTRIAD only (stream-stride_template.c).
+	maxulp is the allowed deviation from the correctly rounded result (1 for the triads:
+	separate multiply and add or FMA contraction).
+	With USE_TRACE the OpenMP and pthread variants record their chunks, barrier waits and
+	thread creation/join (trace.h).
+*/
+
+#ifndef STREAM_KERNELS_H
+#define STREAM_KERNELS_H
+
+#include<stdint.h>	/* uintptr_t */
+#include<pthread.h>
+#if defined(__SSE2__) || defined(__AVX__)
+#include<immintrin.h>
+#endif
+#ifdef _OPENMP
+#include<omp.h>
+#endif
+
+#include "trace.h"
+
+#define STREAMKERNELS_NUMTHREADS 4	/* pthread variant */
+
+typedef unsigned long Tindex;
+typedef double Tfloat;
+
+typedef enum { COPY, ADD, sTRIAD, vTRIAD } Tstreamop;
+static const char *const streamopname[]={"COPY","ADD","sTRIAD","vTRIAD"};
+
+typedef void (*Tstreamfunc)(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s);
+
+typedef struct {
+	const char *name;
+	Tstreamop op;
+	Tstreamfunc func;
+	int strided;	/* stride>1 supported */
+	unsigned int maxulp;
+} Tstreamkernel;
+
+
+/* scalar (stream_ref.c) ========================================================================*/
+static void copy_scalar(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)c; (void)d; (void)s;
+	for(i=0;i<N;++i) a[i]=b[i];
+}
+
+static void add_scalar(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)d; (void)s;
+	for(i=0;i<N;++i) a[i]=b[i]+c[i];
+}
+
+static void striad_scalar(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)d;
+	for(i=0;i<N;++i) a[i]=s*b[i]+c[i];
+}
+
+static void vtriad_scalar(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)s;
+	for(i=0;i<N;++i) a[i]=b[i]*c[i]+d[i];
+}
+
+/* strided (stream-stride_template.c) ===========================================================*/
+static void vtriad_strided(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)s;
+	for(i=0;i<N;i+=stride) a[i]=b[i]*c[i]+d[i];
+}
+
+/* OpenMP =======================================================================================*/
+#ifdef _OPENMP
+static void copy_omp(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)c; (void)d; (void)s;
+#pragma omp parallel
+	{
+		TRACE_START(trace_chunk);
+#pragma omp for nowait
+		for(i=0;i<N;++i) a[i]=b[i];
+		TRACE_SPAN("copy_omp",trace_chunk,-1);
+		TRACE_START(trace_barrier);
+#pragma omp barrier
+		TRACE_SPAN("barrier",trace_barrier,-1);
+	}
+}
+
+static void add_omp(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)d; (void)s;
+#pragma omp parallel
+	{
+		TRACE_START(trace_chunk);
+#pragma omp for nowait
+		for(i=0;i<N;++i) a[i]=b[i]+c[i];
+		TRACE_SPAN("add_omp",trace_chunk,-1);
+		TRACE_START(trace_barrier);
+#pragma omp barrier
+		TRACE_SPAN("barrier",trace_barrier,-1);
+	}
+}
+
+static void striad_omp(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)d;
+#pragma omp parallel
+	{
+		TRACE_START(trace_chunk);
+#pragma omp for nowait
+		for(i=0;i<N;++i) a[i]=s*b[i]+c[i];
+		TRACE_SPAN("striad_omp",trace_chunk,-1);
+		TRACE_START(trace_barrier);
+#pragma omp barrier
+		TRACE_SPAN("barrier",trace_barrier,-1);
+	}
+}
+
+static void vtriad_omp(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i;
+	(void)stride; (void)s;
+#pragma omp parallel
+	{
+		TRACE_START(trace_chunk);
+#pragma omp for nowait
+		for(i=0;i<N;++i) a[i]=b[i]*c[i]+d[i];
+		TRACE_SPAN("vtriad_omp",trace_chunk,-1);
+		TRACE_START(trace_barrier);
+#pragma omp barrier
+		TRACE_SPAN("barrier",trace_barrier,-1);
+	}
+}
+#endif
+
+/* pthreads, one block per thread (ue4-17.6/stream_template.c) ==================================*/
+typedef struct {
+	Tstreamop op;
+	Tindex i0, i1;
+	Tfloat *a;
+	const Tfloat *b, *c, *d;
+	Tfloat s;
+} Tstreamblock;
+
+static const char *const streampthreadname[]={"copy_pthread","add_pthread","striad_pthread","vtriad_pthread"};
+
+static void* stream_pthread_work(void *arg)
+{
+	Tstreamblock *w=(Tstreamblock*)arg;
+	Tindex i;
+	TRACE_START(trace_block);
+	switch(w->op)
+	{
+		case COPY: for(i=w->i0;i<w->i1;++i) w->a[i]=w->b[i]; break;
+		case ADD: for(i=w->i0;i<w->i1;++i) w->a[i]=w->b[i]+w->c[i]; break;
+		case sTRIAD: for(i=w->i0;i<w->i1;++i) w->a[i]=w->s*w->b[i]+w->c[i]; break;
+		case vTRIAD: for(i=w->i0;i<w->i1;++i) w->a[i]=w->b[i]*w->c[i]+w->d[i]; break;
+	}
+	TRACE_SPAN(streampthreadname[w->op],trace_block,(long)w->i0);
+	return NULL;
+}
+
+static void stream_pthread(Tstreamop op, Tindex N, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	pthread_t threads[STREAMKERNELS_NUMTHREADS];
+	Tstreamblock blocks[STREAMKERNELS_NUMTHREADS];
+	int t;
+	TRACE_START(trace_create);
+	for(t=0;t<STREAMKERNELS_NUMTHREADS;++t)
+	{	/* the last block gets the remainder */
+		blocks[t].op=op;
+		blocks[t].i0=N/STREAMKERNELS_NUMTHREADS*t;
+		blocks[t].i1=(t+1<STREAMKERNELS_NUMTHREADS)?N/STREAMKERNELS_NUMTHREADS*(t+1):N;
+		blocks[t].a=a; blocks[t].b=b; blocks[t].c=c; blocks[t].d=d; blocks[t].s=s;
+		pthread_create(&threads[t],NULL,stream_pthread_work,&blocks[t]);
+	}
+	TRACE_SPAN("create",trace_create,-1);
+	TRACE_START(trace_join);
+	for(t=0;t<STREAMKERNELS_NUMTHREADS;++t) pthread_join(threads[t],NULL);
+	TRACE_SPAN("join",trace_join,-1);
+}
+
+static void copy_pthread(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	(void)stride;
+	stream_pthread(COPY,N,a,b,c,d,s);
+}
+
+static void add_pthread(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	(void)stride;
+	stream_pthread(ADD,N,a,b,c,d,s);
+}
+
+static void striad_pthread(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	(void)stride;
+	stream_pthread(sTRIAD,N,a,b,c,d,s);
+}
+
+static void vtriad_pthread(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	(void)stride;
+	stream_pthread(vTRIAD,N,a,b,c,d,s);
+}
+
+/* SIMD (stream_sse2.c, stream_avx.c) ===========================================================*/
+#ifdef __SSE2__
+static void copy_sse2(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)c; (void)d; (void)s;
+	for(;i+2<=N;i+=2) _mm_storeu_pd(&a[i],_mm_loadu_pd(&b[i]));
+	for(;i<N;++i) a[i]=b[i];
+}
+
+static void add_sse2(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)d; (void)s;
+	for(;i+2<=N;i+=2) _mm_storeu_pd(&a[i],_mm_add_pd(_mm_loadu_pd(&b[i]),_mm_loadu_pd(&c[i])));
+	for(;i<N;++i) a[i]=b[i]+c[i];
+}
+
+static void striad_sse2(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	const __m128d vs=_mm_set1_pd(s);
+	(void)stride; (void)d;
+	for(;i+2<=N;i+=2) _mm_storeu_pd(&a[i],_mm_add_pd(_mm_mul_pd(vs,_mm_loadu_pd(&b[i])),_mm_loadu_pd(&c[i])));
+	for(;i<N;++i) a[i]=s*b[i]+c[i];
+}
+
+static void vtriad_sse2(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)s;
+	for(;i+2<=N;i+=2)
+		_mm_storeu_pd(&a[i],_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(&b[i]),_mm_loadu_pd(&c[i])),_mm_loadu_pd(&d[i])));
+	for(;i<N;++i) a[i]=b[i]*c[i]+d[i];	/* tail */
+}
+#endif
+
+#ifdef __AVX__
+static void copy_avx(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)c; (void)d; (void)s;
+	for(;i+4<=N;i+=4) _mm256_storeu_pd(&a[i],_mm256_loadu_pd(&b[i]));
+	for(;i<N;++i) a[i]=b[i];
+}
+
+static void add_avx(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)d; (void)s;
+	for(;i+4<=N;i+=4) _mm256_storeu_pd(&a[i],_mm256_add_pd(_mm256_loadu_pd(&b[i]),_mm256_loadu_pd(&c[i])));
+	for(;i<N;++i) a[i]=b[i]+c[i];
+}
+
+static void striad_avx(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	const __m256d vs=_mm256_set1_pd(s);
+	(void)stride; (void)d;
+	for(;i+4<=N;i+=4) _mm256_storeu_pd(&a[i],_mm256_add_pd(_mm256_mul_pd(vs,_mm256_loadu_pd(&b[i])),_mm256_loadu_pd(&c[i])));
+	for(;i<N;++i) a[i]=s*b[i]+c[i];
+}
+
+static void copy_avx_nt(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{	/* peel as vtriad_avx_nt */
+	Tindex i=0;
+	(void)stride; (void)c; (void)d; (void)s;
+	for(;i<N && ((uintptr_t)&a[i])%32;++i) a[i]=b[i];
+	for(;i+4<=N;i+=4) _mm256_stream_pd(&a[i],_mm256_loadu_pd(&b[i]));
+	_mm_sfence();
+	for(;i<N;++i) a[i]=b[i];
+}
+
+static void vtriad_avx(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)s;
+	for(;i+4<=N;i+=4)
+		_mm256_storeu_pd(&a[i],_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&b[i]),_mm256_loadu_pd(&c[i])),_mm256_loadu_pd(&d[i])));
+	for(;i<N;++i) a[i]=b[i]*c[i]+d[i];
+}
+
+/* non-temporal (streaming) stores need an aligned a: peel until a+i is 32 Byte aligned */
+static void vtriad_avx_nt(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)s;
+	for(;i<N && ((uintptr_t)&a[i])%32;++i) a[i]=b[i]*c[i]+d[i];	/* peel */
+	for(;i+4<=N;i+=4)
+		_mm256_stream_pd(&a[i],_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&b[i]),_mm256_loadu_pd(&c[i])),_mm256_loadu_pd(&d[i])));
+	_mm_sfence();
+	for(;i<N;++i) a[i]=b[i]*c[i]+d[i];
+}
+#endif
+
+#ifdef __FMA__
+static void striad_avx_fma(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	const __m256d vs=_mm256_set1_pd(s);
+	(void)stride; (void)d;
+	for(;i+4<=N;i+=4) _mm256_storeu_pd(&a[i],_mm256_fmadd_pd(vs,_mm256_loadu_pd(&b[i]),_mm256_loadu_pd(&c[i])));
+	for(;i<N;++i) a[i]=s*b[i]+c[i];
+}
+
+static void vtriad_avx_fma(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)s;
+	for(;i+4<=N;i+=4)
+		_mm256_storeu_pd(&a[i],_mm256_fmadd_pd(_mm256_loadu_pd(&b[i]),_mm256_loadu_pd(&c[i]),_mm256_loadu_pd(&d[i])));
+	for(;i<N;++i) a[i]=b[i]*c[i]+d[i];
+}
+#endif
+
+#ifdef __AVX512F__
+static void copy_avx512(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)c; (void)d; (void)s;
+	for(;i+8<=N;i+=8) _mm512_storeu_pd(&a[i],_mm512_loadu_pd(&b[i]));
+	if(i<N)
+	{	/* masked tail */
+		__mmask8 m=(__mmask8)((1u<<(N-i))-1);
+		_mm512_mask_storeu_pd(&a[i],m,_mm512_maskz_loadu_pd(m,&b[i]));
+	}
+}
+
+static void add_avx512(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)d; (void)s;
+	for(;i+8<=N;i+=8) _mm512_storeu_pd(&a[i],_mm512_add_pd(_mm512_loadu_pd(&b[i]),_mm512_loadu_pd(&c[i])));
+	if(i<N)
+	{
+		__mmask8 m=(__mmask8)((1u<<(N-i))-1);
+		_mm512_mask_storeu_pd(&a[i],m,_mm512_add_pd(_mm512_maskz_loadu_pd(m,&b[i]),_mm512_maskz_loadu_pd(m,&c[i])));
+	}
+}
+
+static void striad_avx512(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	const __m512d vs=_mm512_set1_pd(s);
+	(void)stride; (void)d;
+	for(;i+8<=N;i+=8) _mm512_storeu_pd(&a[i],_mm512_fmadd_pd(vs,_mm512_loadu_pd(&b[i]),_mm512_loadu_pd(&c[i])));
+	if(i<N)
+	{
+		__mmask8 m=(__mmask8)((1u<<(N-i))-1);
+		_mm512_mask_storeu_pd(&a[i],m,_mm512_fmadd_pd(vs,_mm512_maskz_loadu_pd(m,&b[i]),_mm512_maskz_loadu_pd(m,&c[i])));
+	}
+}
+
+static void vtriad_avx512(Tindex N, Tindex stride, Tfloat *a, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s)
+{
+	Tindex i=0;
+	(void)stride; (void)s;
+	for(;i+8<=N;i+=8)
+		_mm512_storeu_pd(&a[i],_mm512_fmadd_pd(_mm512_loadu_pd(&b[i]),_mm512_loadu_pd(&c[i]),_mm512_loadu_pd(&d[i])));
+	if(i<N)
+	{	/* masked tail */
+		__mmask8 m=(__mmask8)((1u<<(N-i))-1);
+		_mm512_mask_storeu_pd(&a[i],m,_mm512_fmadd_pd(_mm512_maskz_loadu_pd(m,&b[i]),_mm512_maskz_loadu_pd(m,&c[i])
+		                                               ,_mm512_maskz_loadu_pd(m,&d[i])));
+	}
+}
+#endif
+
+
+static const Tstreamkernel streamkernels[]={
+	{"copy_scalar",   COPY,   copy_scalar,   0, 0},
+	{"add_scalar",    ADD,    add_scalar,    0, 0},
+	{"striad_scalar", sTRIAD, striad_scalar, 0, 1},
+	{"vtriad_scalar", vTRIAD, vtriad_scalar, 0, 1},
+	{"vtriad_strided",vTRIAD, vtriad_strided,1, 1},
+#ifdef _OPENMP
+	{"copy_omp",      COPY,   copy_omp,      0, 0},
+	{"add_omp",       ADD,    add_omp,       0, 0},
+	{"striad_omp",    sTRIAD, striad_omp,    0, 1},
+	{"vtriad_omp",    vTRIAD, vtriad_omp,    0, 1},
+#endif
+	{"copy_pthread",  COPY,   copy_pthread,  0, 0},
+	{"add_pthread",   ADD,    add_pthread,   0, 0},
+	{"striad_pthread",sTRIAD, striad_pthread,0, 1},
+	{"vtriad_pthread",vTRIAD, vtriad_pthread,0, 1},
+#ifdef __SSE2__
+	{"copy_sse2",     COPY,   copy_sse2,     0, 0},
+	{"add_sse2",      ADD,    add_sse2,      0, 0},
+	{"striad_sse2",   sTRIAD, striad_sse2,   0, 1},
+	{"vtriad_sse2",   vTRIAD, vtriad_sse2,   0, 1},
+#endif
+#ifdef __AVX__
+	{"copy_avx",      COPY,   copy_avx,      0, 0},
+	{"add_avx",       ADD,    add_avx,       0, 0},
+	{"striad_avx",    sTRIAD, striad_avx,    0, 1},
+	{"vtriad_avx",    vTRIAD, vtriad_avx,    0, 1},
+	{"copy_avx_nt",   COPY,   copy_avx_nt,   0, 0},
+	{"vtriad_avx_nt", vTRIAD, vtriad_avx_nt, 0, 1},
+#endif
+#ifdef __FMA__
+	{"striad_avx_fma",sTRIAD, striad_avx_fma,0, 1},
+	{"vtriad_avx_fma",vTRIAD, vtriad_avx_fma,0, 1},
+#endif
+#ifdef __AVX512F__
+	{"copy_avx512",   COPY,   copy_avx512,   0, 0},
+	{"add_avx512",    ADD,    add_avx512,    0, 0},
+	{"striad_avx512", sTRIAD, striad_avx512, 0, 1},
+	{"vtriad_avx512", vTRIAD, vtriad_avx512, 0, 1},
+#endif
+};
+static const unsigned int numstreamkernels=sizeof(streamkernels)/sizeof(streamkernels[0]);
+
+#endif /* STREAM_KERNELS_H */
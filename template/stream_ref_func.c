@@ -21,7 +21,23 @@
 	craycc -O3 -hfp3 stream_ref_func.c -o stream_ref_func.cray
 
 
-	//USE_PAPI: add -lpapi
+	//USE_TSCTIMER: invariant TSC with rdtscp (tsctimer.h), calibrated frequency, timer overhead subtracted
+	//  <nrepeat> 0 (default): repeated (with increasing nrepeat) until the timed region lasts >= MINTIME
+	//  appends the columns  GHz cycles/element cycles/cacheline  (core cycles, CACHELINESIZE Bytes)
+	//  with the effective core frequency of the timed region (APERF/MPERF or cycles/refcycles,
+	//  perfcounters.h, opened for that alone without USE_PERFCOUNTERS) and a warning line, if the
+	//  frequency changed more than FREQTOLERANCE against the probes before and after (turbo,
+	//  throttling). Without these counters (e.g. in a VM) the columns are the mean of the probes
+	//  (tsctimer_corefrequency()), marked by a "# frequency not measured" line: too noisy for a warning
+	//USE_PERFCOUNTERS: hardware counters with Linux perf_event_open (perfcounters.h), nothing to link
+	//  appends the columns (per repetition)
+	//  cycles instructions LLCmisses DTLBmisses FPops refcycles APERF MPERF  IPC Bytes/LLCmiss FPops(counted)/FlOp(nominal)
+	//  (nan if the counter is not available, e.g. in a VM)
+	//USE_HISTOGRAM (needs USE_TSCTIMER): every repetition is timed (histogram.h), a comment line
+	//  with min p50 p99 p99.9 max per repetition and the bandwidth at p50 and p99 follows
+	//  (a repetition includes one rdtscp, i.e. use N large enough), additional arguments
+	//  <soaktime [s]>: run for soaktime instead of nrepeat times (soak test)
+	//  <timeseries file>: per TIMESERIESINTERVAL: time count min mean max bandwidth(mean)
 
 
 	stream_ref_func [<N>] [<nrepeat>]
@@ -30,7 +46,12 @@
 
 /* Defaults for command line arguments ===========================================================*/
 #define DEFAULT_N 100000
-#define DEFAULT_NREPEAT 1
+#define DEFAULT_NREPEAT 0	/* 0: automatic (USE_TSCTIMER), else 1 */
+#define MINTIME 0.05	/* [s] automatic repetitions */
+#define FREQPROBETIME 0.005	/* [s] core frequency probe before/after the timed region */
+#define FREQTOLERANCE 0.05	/* relative frequency change for a warning */
+#define CACHELINESIZE 64	/* [Bytes] */
+#define TIMESERIESINTERVAL 1.	/* [s] USE_HISTOGRAM */
 #define STRIDE 1
 /*================================================================================================*/
 
@@ -41,10 +62,12 @@
 
 
 /*#define USE_CLOCK*/
-#define USE_GETTIMEOFDAY
+/*#define USE_GETTIMEOFDAY*/
 /*#define USE_CLOCKGETTIME*/
+#define USE_TSCTIMER
 
-/*#define USE_PAPI*/
+/*#define USE_PERFCOUNTERS*/
+/*#define USE_HISTOGRAM*/
 /*#define USE_IACA*/
 
 /*#define DEBUG*/
@@ -64,8 +87,19 @@
 #include <sys/time.h>	/* gettimeofday() */
 #endif
 
-#ifdef USE_PAPI
-#include <papi.h>
+#ifdef USE_TSCTIMER
+#include "tsctimer.h"
+#endif
+
+#if defined(USE_PERFCOUNTERS) || defined(USE_TSCTIMER)
+#include "perfcounters.h"	/* USE_TSCTIMER: frequency of the timed region */
+#endif
+
+#ifdef USE_HISTOGRAM
+#ifndef USE_TSCTIMER
+#error "USE_HISTOGRAM needs USE_TSCTIMER"
+#endif
+#include "histogram.h"
 #endif
 
 #ifdef USE_IACA
@@ -75,6 +109,7 @@
 #define IACA_END
 #endif
 
+#define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
 typedef unsigned long Tindex;
@@ -170,6 +205,11 @@ int main(int argc, char *argv[])
 #ifdef USE_GETTIMEOFDAY
 	struct timeval tod_start,tod_end;
 #endif
+#ifdef USE_TSCTIMER
+	Ttsctimer tsctimer;
+	Ttscticks tsc_start,tsc_end;
+	double freq_before,freq_during=NAN,freq_after,frequency;
+#endif
 #ifdef USE_CLOCKGETTIME
 	clockid_t clkt_id=CLOCK_MONOTONIC;	/* CLOCK_REALTIME,CLOCK_MONOTONIC,CLOCK_PROCESS_CPUTIME_ID,CLOCK_THREAD_CPUTIME_ID */
 	struct timespec clkt_start,clkt_end,clkt_res;
@@ -187,10 +227,15 @@ int main(int argc, char *argv[])
 	double flops;
 	double bandwidth;
 	Tindex j;
-#ifdef USE_PAPI
-	int papi_retval;
-	float papi_realtime, papi_proctime, papi_mflops;
-	long long papi_flpins;
+#if defined(USE_PERFCOUNTERS) || defined(USE_TSCTIMER)
+	Tperfcounters perfcounters;
+#endif
+#ifdef USE_HISTOGRAM
+	Thistogram *histogram=histogram_new();
+	Ttimeseries timeseries={NULL};	/* closed */
+	Ttscticks tsc_rep,tsc_prev,soakticks=0;
+	double soaktime=0.;
+	const char *timeseriesfile=NULL;
 #endif
 	
 	Tindex N=DEFAULT_N;
@@ -232,7 +277,11 @@ int main(int argc, char *argv[])
 	{
 		if (!strcmp(argv[1],"-h") || !strcmp(argv[1],"--help"))
 		{
+#ifdef USE_HISTOGRAM
+			printf("usage: %s [<N>] [<nrepeat>] [<soaktime [s]> [<timeseries file>]]\n",argv[0]);
+#else
 			printf("usage: %s [<N>] [<nrepeat>]\n",argv[0]);
+#endif
 			exit(0);
 		}
 		N=labs(atol(argv[1]));
@@ -242,6 +291,18 @@ int main(int argc, char *argv[])
 	{
 		nrepeat=labs(atol(argv[2]));
 	}
+#ifdef USE_HISTOGRAM
+	if (argc>3) soaktime=atof(argv[3]);
+	if (argc>4) timeseriesfile=argv[4];
+	if(!histogram)
+	{
+		printf("ERROR allocating memory for the histogram\n");
+		exit(1);
+	}
+#endif
+#ifdef USE_TSCTIMER
+	int autorepeat=(nrepeat<1);
+#endif
 	if(nrepeat<1) nrepeat=1;
 	
 	Neff=(Tindex)(ceil(N/STRIDE));
@@ -291,46 +352,110 @@ int main(int argc, char *argv[])
 	Tfloat s=1.23;
 #endif
 	
+#ifdef USE_PERFCOUNTERS
+	perfcounters_open(&perfcounters);	/* outside of the timed region */
+#elif defined(USE_TSCTIMER)
+	perfcounters_openfrequency(&perfcounters);
+#endif
+#ifdef USE_TSCTIMER
+	tsctimer_init(&tsctimer);
+	freq_before=tsctimer_corefrequency(&tsctimer,FREQPROBETIME);
+#endif
+#ifdef USE_HISTOGRAM
+	if(soaktime>0.)
+	{	/* until soaktime instead of nrepeat times */
+		autorepeat=0;
+		soakticks=(Ttscticks)(soaktime*tsctimer.frequency);
+		nrepeat=(Tindex)-1;
+	}
+#endif
+	
 /*================================================================================================*/
+	for(;;)
+	{	/* once, or until MINTIME is reached (autorepeat) */
 #ifdef USE_CLOCK
-	clk_start = clock();
+		clk_start = clock();
 #endif
 #ifdef USE_GETTIMEOFDAY
-	gettimeofday( &tod_start, NULL );
+		gettimeofday( &tod_start, NULL );
 #endif
 #ifdef USE_CLOCKGETTIME
-	clock_gettime(clkt_id,&clkt_start);
+		clock_gettime(clkt_id,&clkt_start);
 #endif
-#ifdef USE_PAPI
-	papi_retval=PAPI_flops(&papi_realtime,&papi_proctime,&papi_flpins,&papi_mflops);
+#ifdef USE_HISTOGRAM
+		histogram_reset(histogram);
+		timeseries_close(&timeseries);	/* only the last pass (autorepeat) */
+		timeseries_open(&timeseries,timeseriesfile,tsctimer.frequency,TIMESERIESINTERVAL,(double)datasize,tsctimer_start());
 #endif
-	
-	for(j=0;j<nrepeat;++j)
-	{
-		stream(N
-		      ,a, b
+#if defined(USE_PERFCOUNTERS) || defined(USE_TSCTIMER)
+		perfcounters_start(&perfcounters);
+#endif
+#ifdef USE_TSCTIMER
+		tsc_start=tsctimer_start();
+#endif
+#ifdef USE_HISTOGRAM
+		tsc_prev=tsc_start;
+#endif
+		
+		for(j=0;j<nrepeat;++j)
+		{
+			stream(N
+			      ,a, b
 #if defined(DO_ADD) || defined(DO_sTRIAD) || defined(DO_vTRIAD)
-		      ,c
+			      ,c
 #endif
 #ifdef DO_vTRIAD
-		      ,d
+			      ,d
 #endif
 #ifdef DO_sTRIAD
-		      ,s
+			      ,s
+#endif
+		 	      );
+#ifdef USE_HISTOGRAM
+			tsc_rep=tsctimer_stop();
+			histogram_add(histogram,tsc_rep-tsc_prev);
+			timeseries_add(&timeseries,tsc_rep,tsc_rep-tsc_prev);
+			tsc_prev=tsc_rep;
+			if(soakticks && tsc_rep-tsc_start>=soakticks)
+			{
+				++j;
+				break;
+			}
+#endif
+		} /* for-loop 0<=j<nrepeat */
+		
+#ifdef USE_TSCTIMER
+		tsc_end=tsctimer_stop();
+#endif
+#ifdef USE_HISTOGRAM
+		if(soakticks) nrepeat=j;
+#endif
+#if defined(USE_PERFCOUNTERS) || defined(USE_TSCTIMER)
+		perfcounters_stop(&perfcounters);
 #endif
-	 	      );
-	} /* for-loop 0<=j<nrepeat */
-	
-#ifdef USE_PAPI
-	papi_retval=PAPI_flops(&papi_realtime,&papi_proctime,&papi_flpins,&papi_mflops);
+#ifdef USE_CLOCKGETTIME
+		clock_gettime(clkt_id,&clkt_end);
 #endif
 #ifdef USE_GETTIMEOFDAY
-	gettimeofday( &tod_end, NULL );
+		gettimeofday( &tod_end, NULL );
 #endif
 #ifdef USE_CLOCK
-	clk_end = clock();
+		clk_end = clock();
+#endif
+#ifdef USE_TSCTIMER
+		time_diff=tsctimer_seconds(&tsctimer,tsc_start,tsc_end);
+		if(!autorepeat || time_diff>=MINTIME) break;
+		nrepeat=tsctimer_repetitions(nrepeat,time_diff,MINTIME);
+#else
+		break;
 #endif
+	}
 /*================================================================================================*/
+#ifdef USE_TSCTIMER
+	freq_after=tsctimer_corefrequency(&tsctimer,FREQPROBETIME);
+	if(tsctimer.tsc) freq_during=perfcounters_frequency(&perfcounters,tsctimer.frequency);
+	frequency=(freq_during>0.)?freq_during:(freq_before+freq_after)/2.;
+#endif
 	printf("ref_func");
 	printf(" 1");	/* #PEs */
 	printf("\t%s\t%lu\t%lu\t%u\t%lu\t%zu\t%lu",bmtypes,N,nrepeat,STRIDE,Neff
@@ -347,8 +472,8 @@ int main(int argc, char *argv[])
 	time_diff=(double)(clkt_end.tv_sec-clkt_start.tv_sec)+(double)(clkt_end.tv_nsec-clkt_start.tv_nsec)/1.E9;
 	printf("\t\t%g",time_diff);
 #endif
-#ifdef USE_CLOCKGETTIME
-	clock_gettime(clkt_id,&clkt_end);
+#ifdef USE_TSCTIMER
+	printf("\t\t%g",time_diff);	/* overhead subtracted */
 #endif
 	time_avg=time_diff/nrepeat;
 	time_iter=time_avg/Neff;
@@ -357,10 +482,55 @@ int main(int argc, char *argv[])
 	bandwidth=datasize/time_avg;
 	printf("\t\t%u\t%g",iternumflop,flops);
 	printf("\t%g",bandwidth);
+#ifdef USE_TSCTIMER
+	{	/* core cycles per element and per cache line (elements of one array) */
+		double elempercacheline=MAX(1.,(double)CACHELINESIZE/(sizeofTfloat*STRIDE));
+		printf("\t\t%g\t%g\t%g",frequency/1.E9,time_iter*frequency,time_iter*frequency*elempercacheline);
+	}
+#endif
+#ifdef USE_PERFCOUNTERS
+	{	/* per repetition, derived: IPC, Bytes/LLC miss, counted/nominal FlOp */
+		int k;
+		printf("\t");
+		for(k=0;k<NUMPERFCOUNTERS;++k) printf("\t%g",perfcounters_value(&perfcounters,k)/nrepeat);
+		printf("\t\t%g\t%g\t%g"
+		      ,perfcounters_value(&perfcounters,PERFCOUNTER_INSTRUCTIONS)/perfcounters_value(&perfcounters,PERFCOUNTER_CYCLES)
+		      ,(double)datasize*nrepeat/perfcounters_value(&perfcounters,PERFCOUNTER_LLCMISSES)
+		      ,iternumflop>0?perfcounters_value(&perfcounters,PERFCOUNTER_FPOPS)/((double)iternumflop*Neff*nrepeat):NAN);
+	}
+#endif
+#if defined(USE_PERFCOUNTERS) || defined(USE_TSCTIMER)
+	perfcounters_close(&perfcounters);
+#endif
 	printf("\n");
-#ifdef USE_PAPI
-	printf("#PAPI\tReal_time: %f\tProc_time: %f\tTotal flpins: %lld\tMFLOPS: %f\n",papi_realtime, papi_proctime, papi_flpins, papi_mflops);
-	PAPI_shutdown();
+#ifdef USE_TSCTIMER
+	if(freq_during>0.)
+	{	/* frequency spread over before, during and after, only if counted (the short probes
+		   alone jitter more than FREQTOLERANCE, e.g. preempted in a VM) */
+		double freqmin=MIN(MIN(freq_before,freq_after),freq_during);
+		double freqmax=MAX(MAX(freq_before,freq_after),freq_during);
+		if(freqmax>(1.+FREQTOLERANCE)*freqmin)
+			printf("# WARNING frequency changed during the measurement (before %g, during %g, after %g GHz)\n"
+			      ,freq_before/1.E9,freq_during/1.E9,freq_after/1.E9);
+	}
+	else
+		printf("# frequency not measured (no APERF/MPERF or cycles/refcycles counters), GHz and cycles from the probes (before %g, after %g GHz)\n"
+		      ,freq_before/1.E9,freq_after/1.E9);
+#endif
+#ifdef USE_HISTOGRAM
+	{	/* per repetition */
+		const double percentile[]={0.,50.,99.,99.9,100.};
+		const char *const percentilename[]={"min","p50","p99","p99.9","max"};
+		int k;
+		printf("# repetitions %lu\ttime[s]",(unsigned long)histogram->total);
+		for(k=0;k<5;++k)
+			printf("\t%s %g",percentilename[k],histogram_percentile(histogram,percentile[k])/tsctimer.frequency);
+		printf("\tbandwidth(p50) %g\tbandwidth(p99) %g\n"
+		      ,datasize*tsctimer.frequency/histogram_percentile(histogram,50.)
+		      ,datasize*tsctimer.frequency/histogram_percentile(histogram,99.));
+	}
+	timeseries_close(&timeseries);
+	free(histogram);
 #endif
 	
 #ifdef DEBUG
@@ -376,10 +546,10 @@ int main(int argc, char *argv[])
 		error=a[i]-(b[i]+c[i]);
 #endif
 #ifdef DO_sTRIAD
-		error=a[i]-(s*b[i]+c[i]);
+		error=a[i]-(b[i]+s*c[i]);
 #endif
 #ifdef DO_vTRIAD
-		error=a[i]-(b[i]*c[i]+d[i]);
+		error=a[i]-(b[i]+c[i]*d[i]);
 #endif
 		/*printf("%lu\t%g\t%g\n",i,a[i],error);*/
 		error=fabs(error);
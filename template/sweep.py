@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+# sweep.py
+# N sweep of a single-core benchmark with independent points in parallel on disjoint cores
+# M. Bernreuther <bernreuther@hlrs.de>
+#
+#  ./sweep.py ./stream_ref | ./results.py record -b stream_ref -o stream_ref.jsonl
+#  ./sweep.py --cores 0-7 --arrays 4 --repetitions 5 --check 0.2 ./stream_ref
+#
+# The points (N of run.sh: 1..9e6, each --repetitions times) are classified by their working set
+# (N*arrays*sizeof): points that fit into the (private) L2 cache run at the same time, one per core,
+# on cores that share no L2 (one cpu per L2, i.e. no SMT siblings either; cache topology of
+# /sys/devices/system/cpu/cpu*/cache). Larger points (L3 and DRAM are shared) run serially
+# afterwards on one core with all others idle.
+# Interference check: a fraction (--check) of the parallel points is re-run in isolation, a
+# Mann-Whitney U test (results.py) with a relative difference > --tolerance is reported as
+# interference (exit status 1).
+# Output: the benchmark lines sorted by N (for results.py record), "#" comment lines.
+
+import argparse
+import os
+import queue
+import random
+import subprocess
+import sys
+import threading
+
+from results import mannwhitney, median, parse_dat
+
+
+def cpulist(s):
+    """cpus of a list like 0-3,8"""
+    cpus = []
+    for r in s.strip().split(','):
+        if r:
+            lo, _, hi = r.partition('-')
+            cpus.extend(range(int(lo), int(hi or lo) + 1))
+    return cpus
+
+
+def readsysfs(path, default=None):
+    try:
+        with open(path) as f:
+            return f.read().strip()
+    except OSError:
+        return default
+
+
+def cachesize(cpu, level):
+    """size [Bytes] and shared cpus of the unified/data cache of level"""
+    base = '/sys/devices/system/cpu/cpu%d/cache' % cpu
+    for index in sorted(os.listdir(base)) if os.path.isdir(base) else []:
+        if not index.startswith('index'):
+            continue
+        path = os.path.join(base, index)
+        if readsysfs(path + '/level') == str(level) and readsysfs(path + '/type') in ('Unified', 'Data'):
+            size = readsysfs(path + '/size', '0')
+            factor = {'K': 1024, 'M': 1024 ** 2}.get(size[-1], 1)
+            return int(size.rstrip('KM')) * factor, cpulist(readsysfs(path + '/shared_cpu_list', str(cpu)))
+    return 0, [cpu]
+
+
+def disjointcores(cpus):
+    """one cpu per L2 cache"""
+    chosen, covered = [], set()
+    for cpu in cpus:
+        if cpu in covered:
+            continue
+        chosen.append(cpu)
+        covered.update(cachesize(cpu, 2)[1])
+    return chosen
+
+
+def run(binary, n, cpu):
+    out = subprocess.run(['taskset', '-c', str(cpu), binary, str(n)], stdout=subprocess.PIPE,
+                         stderr=subprocess.DEVNULL, universal_newlines=True).stdout
+    return [line for line in out.splitlines() if line.strip() and not line.startswith('maxerror')]
+
+
+def parallel(binary, tasks, cores):
+    """tasks [(N, repetition)] on cores, one at a time per core; {task: lines}"""
+    todo = queue.Queue()
+    for task in tasks:
+        todo.put(task)
+    results = {}
+
+    def worker(cpu):
+        while True:
+            try:
+                task = todo.get_nowait()
+            except queue.Empty:
+                return
+            results[task] = run(binary, task[0], cpu)
+
+    threads = [threading.Thread(target=worker, args=(cpu,)) for cpu in cores]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return results
+
+
+def samples(lines):
+    points = parse_dat(lines, '')[1]
+    return points[0]['samples'] if points else []
+
+
+def main():
+    parser = argparse.ArgumentParser(description='parallel N sweep on disjoint cores')
+    parser.add_argument('binary')
+    parser.add_argument('--cores', help='cpus to use (default: online)')
+    parser.add_argument('--arrays', type=int, default=4, help='arrays of the kernel (vTRIAD: 4)')
+    parser.add_argument('--sizeof', type=int, default=8, help='Bytes per element')
+    parser.add_argument('--repetitions', type=int, default=5, help='runs per N')
+    parser.add_argument('--check', type=float, default=0.2, help='fraction of parallel points re-run in isolation')
+    parser.add_argument('--tolerance', type=float, default=0.05, help='relative difference for interference')
+    parser.add_argument('--alpha', type=float, default=0.05, help='significance level')
+    args = parser.parse_args()
+
+    binary = os.path.abspath(args.binary)
+    if not os.access(binary, os.X_OK):
+        print('ERROR: no executable %s' % binary)
+        sys.exit(2)
+    cpus = cpulist(args.cores or readsysfs('/sys/devices/system/cpu/online', '0'))
+    cores = disjointcores(cpus)
+    l2size = cachesize(cores[0], 2)[0]
+    sizes = [m * 10 ** e for e in range(7) for m in range(1, 10)]
+    incache = [n for n in sizes if n * args.arrays * args.sizeof <= l2size]
+    serial = [n for n in sizes if n not in incache]
+    print('# %s: %d points parallel on cpus %s (L2 %d Bytes, one cpu per L2), %d serial on cpu %d'
+          % (binary, len(incache), ','.join(map(str, cores)), l2size, len(serial), cores[0]))
+
+    reps = range(args.repetitions)
+    lines = parallel(binary, [(n, r) for n in incache for r in reps], cores)
+    lines.update(parallel(binary, [(n, r) for n in serial for r in reps], cores[:1]))
+    for n in sizes:
+        for r in reps:
+            for line in lines[(n, r)]:
+                print(line)
+
+    status = 0
+    checked = random.sample(incache, max(1, int(round(args.check * len(incache))))) if incache else []
+    for n in sorted(checked):
+        isolated = parallel(binary, [(n, r) for r in reps], cores[:1])
+        x = [v for r in reps for v in samples(isolated[(n, r)])]
+        y = [v for r in reps for v in samples(lines[(n, r)])]
+        if not x or not y:
+            continue
+        ratio = median(y) / median(x)
+        p = mannwhitney(x, y) if len(x) >= 3 and len(y) >= 3 else float('nan')
+        interference = abs(ratio - 1.) > args.tolerance and p < args.alpha
+        print('# check N=%d: parallel/isolated %.4f (p %g)%s' % (n, ratio, p, ' INTERFERENCE' if interference else ''))
+        if interference:
+            status = 1
+    if status:
+        print('# WARNING parallel points disturb each other, use fewer --cores')
+    sys.exit(status)
+
+
+if __name__ == '__main__':
+    main()
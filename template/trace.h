@@ -0,0 +1,210 @@
+/* trace.h
+   per-thread timeline instrumentation, written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static inline functions), just #include "trace.h" (compile with -pthread)
+	Everything is a macro, empty without USE_TRACE (no overhead at all), e.g.
+
+	TRACE_INIT(getenv("TRACEFILE"));	// once in main(), NULL: tracing off
+	TRACE_START(t0);			// declares Ttraceticks t0 (TSC timestamp)
+	...					// work chunk
+	TRACE_SPAN("row",t0,row);		// complete event t0..now, arg (<0: none)
+	TRACE_MARK("steal",victim);		// instant event
+	TRACE_THREADNAME("omp",t);		// timeline label of this thread: "omp 3"
+	TRACE_WRITE();				// at the end, after all threads finished
+
+	Each thread gets a ring buffer of TRACE_BUFFERSIZE events at its first event (registered
+	under a mutex once, later events are lock free), i.e. only the latest events are kept.
+	The buffer of a finished thread is reused by the next new one (same timeline row), e.g.
+	for the pthreads created per call of vtriad_pthread(). Timestamps are plain rdtsc (no fences,
+	invariant TSC synchronized over the cores), converted with the frequency of tsctimer.h.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef USE_TRACE
+
+#include<stdio.h>	/* FILE,fopen(),fprintf() */
+#include<stdlib.h>	/* malloc() */
+#include<string.h>	/* snprintf() */
+#include<unistd.h>	/* getpid() */
+#include<pthread.h>
+
+#include "tsctimer.h"
+
+#define TRACE_BUFFERSIZE 16384	/* events per thread, power of 2 */
+#define TRACE_MAXTHREADS 256
+
+typedef Ttscticks Ttraceticks;
+
+typedef struct {
+	const char *name;	/* string literal */
+	Ttraceticks start, end;	/* end==start: instant */
+	long arg;
+} Ttraceevent;
+
+typedef struct {
+	Ttraceevent events[TRACE_BUFFERSIZE];
+	unsigned long count;
+	int tid, inuse;
+	char name[32];
+} Ttracebuffer;
+
+static struct {
+	int enabled;
+	const char *filename;
+	Ttsctimer timer;
+	Ttraceticks start;
+	pthread_mutex_t mtx;
+	pthread_key_t key;
+	Ttracebuffer *buffers[TRACE_MAXTHREADS];
+	int numbuffers;
+	unsigned long lostthreads;
+} trace_global;
+
+static __thread Ttracebuffer *trace_local=NULL;
+
+
+static inline Ttraceticks trace_now(void)
+{
+#ifdef TSCTIMER_X86
+	if(tsctimer_usetsc) return __rdtsc();
+#endif
+	return tsctimer_clockticks();
+}
+
+static inline void trace_release(void *buffer)
+{	/* thread exit: buffer free for the next thread */
+	pthread_mutex_lock(&trace_global.mtx);
+	((Ttracebuffer*)buffer)->inuse=0;
+	pthread_mutex_unlock(&trace_global.mtx);
+}
+
+static inline void trace_init(const char *filename)
+{
+	trace_global.enabled=(filename!=NULL && filename[0]!='\0');
+	if(!trace_global.enabled) return;
+	trace_global.filename=filename;
+	tsctimer_init(&trace_global.timer);
+	pthread_mutex_init(&trace_global.mtx,NULL);
+	pthread_key_create(&trace_global.key,trace_release);
+	trace_global.start=trace_now();
+}
+
+/* buffer of the calling thread, NULL if there are TRACE_MAXTHREADS already */
+static inline Ttracebuffer* trace_buffer(void)
+{
+	int k;
+	if(trace_local) return trace_local;
+	pthread_mutex_lock(&trace_global.mtx);
+	for(k=0;k<trace_global.numbuffers && trace_global.buffers[k]->inuse;++k);
+	if(k==trace_global.numbuffers)
+	{
+		Ttracebuffer *b=NULL;
+		if(k<TRACE_MAXTHREADS && (b=(Ttracebuffer*)malloc(sizeof(Ttracebuffer))))
+		{
+			b->count=0;
+			b->tid=k;
+			snprintf(b->name,sizeof(b->name),"thread %d",k);
+			trace_global.buffers[trace_global.numbuffers++]=b;
+		}
+		else
+		{
+			++trace_global.lostthreads;
+			k=-1;
+		}
+	}
+	if(k>=0)
+	{
+		trace_local=trace_global.buffers[k];
+		trace_local->inuse=1;
+		pthread_setspecific(trace_global.key,trace_local);
+	}
+	pthread_mutex_unlock(&trace_global.mtx);
+	return trace_local;
+}
+
+static inline void trace_event(const char *name, Ttraceticks start, Ttraceticks end, long arg)
+{
+	Ttracebuffer *b;
+	if(!trace_global.enabled || !(b=trace_buffer())) return;
+	Ttraceevent *e=&b->events[b->count&(TRACE_BUFFERSIZE-1)];
+	e->name=name;
+	e->start=start;
+	e->end=end;
+	e->arg=arg;
+	++b->count;
+}
+
+static inline void trace_threadname(const char *name, int id)
+{
+	Ttracebuffer *b;
+	if(!trace_global.enabled || !(b=trace_buffer())) return;
+	snprintf(b->name,sizeof(b->name),"%s %d",name,id);
+}
+
+static inline double trace_us(Ttraceticks t)
+{
+	return (double)(t-trace_global.start)/trace_global.timer.frequency*1.E6;
+}
+
+static inline void trace_write(void)
+{
+	FILE *f;
+	int k, first=1;
+	unsigned long numevents=0, dropped=0;
+	if(!trace_global.enabled) return;
+	if(!(f=fopen(trace_global.filename,"w")))
+	{
+		printf("ERROR opening trace file %s\n",trace_global.filename);
+		return;
+	}
+	fprintf(f,"{\"traceEvents\":[\n");
+	for(k=0;k<trace_global.numbuffers;++k)
+	{
+		const Ttracebuffer *b=trace_global.buffers[k];
+		unsigned long i=(b->count>TRACE_BUFFERSIZE)?b->count-TRACE_BUFFERSIZE:0;
+		fprintf(f,"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}"
+		       ,first?"":",\n",(int)getpid(),b->tid,b->name);
+		first=0;
+		dropped+=i;
+		for(;i<b->count;++i,++numevents)
+		{
+			const Ttraceevent *e=&b->events[i&(TRACE_BUFFERSIZE-1)];
+			if(e->end==e->start)
+				fprintf(f,",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d"
+				       ,e->name,trace_us(e->start),(int)getpid(),b->tid);
+			else
+				fprintf(f,",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d"
+				       ,e->name,trace_us(e->start),trace_us(e->end)-trace_us(e->start),(int)getpid(),b->tid);
+			if(e->arg>=0) fprintf(f,",\"args\":{\"arg\":%ld}",e->arg);
+			fprintf(f,"}");
+		}
+	}
+	fprintf(f,"\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%lu,\"lostthreads\":%lu}}\n"
+	       ,dropped,trace_global.lostthreads);
+	fclose(f);
+	printf("trace file:\t%s (%lu events, %lu dropped)\n",trace_global.filename,numevents,dropped);
+	trace_global.enabled=0;	/* the buffers stay (thread exits still release them) */
+}
+
+#define TRACE_INIT(filename) trace_init(filename)
+#define TRACE_START(t) Ttraceticks t=trace_now()
+#define TRACE_SPAN(name,t,arg) trace_event(name,t,trace_now(),arg)
+#define TRACE_MARK(name,arg) do { Ttraceticks trace_t=trace_now(); trace_event(name,trace_t,trace_t,arg); } while(0)
+#define TRACE_THREADNAME(name,id) trace_threadname(name,id)
+#define TRACE_WRITE() trace_write()
+
+#else /* USE_TRACE */
+
+#define TRACE_INIT(filename)
+#define TRACE_START(t)
+#define TRACE_SPAN(name,t,arg)
+#define TRACE_MARK(name,arg)
+#define TRACE_THREADNAME(name,id)
+#define TRACE_WRITE()
+
+#endif /* USE_TRACE */
+
+#endif /* TRACE_H */
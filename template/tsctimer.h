@@ -0,0 +1,184 @@
+/* tsctimer.h
+   high resolution timer: invariant TSC (rdtscp) with calibrated frequency and overhead
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	header only (static inline functions), just #include "tsctimer.h"
+
+	Ttsctimer timer;
+	tsctimer_init(&timer);		// once: calibration (~TSCTIMER_CALIBRATIONTIME)
+	Ttscticks t0=tsctimer_start();
+	...
+	Ttscticks t1=tsctimer_stop();
+	double seconds=tsctimer_seconds(&timer,t0,t1);	// overhead subtracted, >=0
+
+	automatic repetitions: the timed region is repeated with
+	nrepeat=tsctimer_repetitions(nrepeat,seconds,target) until seconds>=target
+	(tsctimer_repetitions() returns nrepeat once the target is reached)
+
+	core frequency: tsctimer_corefrequency(&timer,duration) runs a chain of dependent integer
+	adds (1 cycle latency) for about duration [s] (fastest of TSCTIMER_FREQSAMPLES samples),
+	i.e. the actual (turbo) frequency right now, not the TSC or nominal one (NAN for other
+	architectures).
+
+	x86-64 with invariant TSC (cpuid 0x80000007 EDX bit 8, constant rate in all P-/C-states)
+	and rdtscp: start = lfence;rdtsc;lfence (earlier instructions completed, later ones not
+	started), stop = rdtscp;lfence (the timed instructions completed before the read).
+	The TSC frequency is calibrated against CLOCK_MONOTONIC_RAW (the TSC ticks with the
+	nominal, not the actual (turbo) frequency, i.e. ticks are no core cycles).
+	Overhead: minimum of TSCTIMER_OVERHEADSAMPLES empty start/stop pairs.
+	Otherwise (other architectures, no invariant TSC) ticks are CLOCK_MONOTONIC_RAW nanoseconds,
+	with the overhead calibrated in the same way.
+*/
+
+#ifndef TSCTIMER_H
+#define TSCTIMER_H
+
+#include<stdint.h>	/* uint64_t */
+#include<time.h>	/* clock_gettime() */
+#include<math.h>	/* NAN */
+#if defined(__x86_64__) || defined(__i386__)
+#include<cpuid.h>	/* __get_cpuid() */
+#include<x86intrin.h>	/* __rdtsc(),__rdtscp(),_mm_lfence() */
+#define TSCTIMER_X86
+#endif
+
+#define TSCTIMER_CALIBRATIONTIME 0.05	/* [s] */
+#define TSCTIMER_OVERHEADSAMPLES 1000
+#define TSCTIMER_FREQSAMPLES 4	/* tsctimer_corefrequency() */
+
+typedef uint64_t Ttscticks;
+
+typedef struct {
+	int tsc;	/* 1: TSC, 0: CLOCK_MONOTONIC_RAW [ns] */
+	double frequency;	/* ticks per second */
+	Ttscticks overhead;	/* ticks of an empty start/stop */
+} Ttsctimer;
+
+static int tsctimer_usetsc=0;	/* set by tsctimer_init() */
+
+
+static inline Ttscticks tsctimer_clockticks(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC_RAW,&t);
+	return (Ttscticks)t.tv_sec*1000000000UL+(Ttscticks)t.tv_nsec;
+}
+
+static inline Ttscticks tsctimer_start(void)
+{
+#ifdef TSCTIMER_X86
+	if(tsctimer_usetsc)
+	{
+		_mm_lfence();
+		Ttscticks t=__rdtsc();
+		_mm_lfence();
+		return t;
+	}
+#endif
+	return tsctimer_clockticks();
+}
+
+static inline Ttscticks tsctimer_stop(void)
+{
+#ifdef TSCTIMER_X86
+	if(tsctimer_usetsc)
+	{
+		unsigned int aux;
+		Ttscticks t=__rdtscp(&aux);
+		_mm_lfence();
+		return t;
+	}
+#endif
+	return tsctimer_clockticks();
+}
+
+static inline int tsctimer_invarianttsc(void)
+{
+#ifdef TSCTIMER_X86
+	unsigned int eax, ebx, ecx, edx;
+	if(!__get_cpuid(0x80000000,&eax,&ebx,&ecx,&edx) || eax<0x80000007) return 0;
+	if(!__get_cpuid(0x80000001,&eax,&ebx,&ecx,&edx) || !(edx&(1u<<27))) return 0;	/* rdtscp */
+	if(!__get_cpuid(0x80000007,&eax,&ebx,&ecx,&edx)) return 0;
+	return (edx&(1u<<8))!=0;
+#else
+	return 0;
+#endif
+}
+
+static inline void tsctimer_init(Ttsctimer *timer)
+{
+	int i;
+	timer->tsc=tsctimer_usetsc=tsctimer_invarianttsc();
+	timer->frequency=1.E9;
+	if(timer->tsc)
+	{	/* busy wait TSCTIMER_CALIBRATIONTIME on both clocks */
+		Ttscticks c0=tsctimer_clockticks(), t0=tsctimer_start(), c1, t1;
+		do
+		{
+			c1=tsctimer_clockticks();
+		} while(c1-c0<(Ttscticks)(TSCTIMER_CALIBRATIONTIME*1.E9));
+		t1=tsctimer_stop();
+		timer->frequency=(double)(t1-t0)/((double)(c1-c0)/1.E9);
+	}
+	timer->overhead=0;
+	for(i=0;i<TSCTIMER_OVERHEADSAMPLES;++i)
+	{
+		Ttscticks t0=tsctimer_start();
+		Ttscticks t1=tsctimer_stop();
+		if(i==0 || t1-t0<timer->overhead) timer->overhead=t1-t0;
+	}
+}
+
+static inline double tsctimer_seconds(const Ttsctimer *timer, Ttscticks start, Ttscticks stop)
+{
+	Ttscticks ticks=stop-start;
+	ticks=(ticks>timer->overhead)?ticks-timer->overhead:0;
+	return (double)ticks/timer->frequency;
+}
+
+/* repetitions needed for target [s], given that nrepeat took seconds */
+static inline unsigned long tsctimer_repetitions(unsigned long nrepeat, double seconds, double target)
+{
+	if(seconds>=target) return nrepeat;
+	if(seconds<=target/100.) return nrepeat*100;	/* too short for an estimate */
+	return (unsigned long)(nrepeat*1.1*target/seconds)+1;	/* 10% margin */
+}
+
+/* core clock frequency [Hz]: 10 dependent register adds per loop iteration,
+   the number of iterations is doubled until a sample takes duration/TSCTIMER_FREQSAMPLES,
+   the fastest sample counts (preemption, e.g. in a VM, only makes samples slower) */
+static inline double tsctimer_corefrequency(const Ttsctimer *timer, double duration)
+{
+#if defined(__x86_64__)
+	unsigned long n=1000;
+	double best=0., total=0.;
+	while(n<(1UL<<40))
+	{
+		unsigned long x=0, count=n, step=3;
+		Ttscticks t0=tsctimer_start();
+		__asm__ volatile(
+			"1:\n\t"
+			"add %2,%0\n\tadd %2,%0\n\tadd %2,%0\n\tadd %2,%0\n\tadd %2,%0\n\t"
+			"add %2,%0\n\tadd %2,%0\n\tadd %2,%0\n\tadd %2,%0\n\tadd %2,%0\n\t"
+			"dec %1\n\t"
+			"jnz 1b\n\t"
+			: "+r"(x), "+r"(count)
+			: "r"(step));	/* register operand: immediates might be folded at rename */
+		double t=tsctimer_seconds(timer,t0,tsctimer_stop());
+		if(t<duration/TSCTIMER_FREQSAMPLES)
+		{
+			n*=2;
+			continue;
+		}
+		if(10.*n/t>best) best=10.*n/t;
+		total+=t;
+		if(total>=duration) break;
+	}
+	return (best>0.)?best:NAN;
+#else
+	(void)timer; (void)duration;
+	return NAN;
+#endif
+}
+
+#endif /* TSCTIMER_H */
@@ -0,0 +1,538 @@
+/* validate.c
+   differential validation of all stream kernel variants and Mandelbrot renderers
+   M. Bernreuther <bernreuther@hlrs.de>
+
+	g++ -std=c++17 -Wall -g -fopenmp -DNOMAIN -c mandelbrot_kernels.cpp -o mandelbrot_kernels.o
+	gcc -Wall -g -pthread -fopenmp validate.c mandelbrot_kernels.o -o validate -lm -lstdc++
+	g++ -std=c++17 -march=native -O3 -fopenmp -DNOMAIN -c mandelbrot_kernels.cpp -o mandelbrot_kernels.o
+	gcc -march=native -O3 -pthread -fopenmp validate.c mandelbrot_kernels.o -o validate -lm -lstdc++
+	gcc -march=native -Ofast -pthread -fopenmp validate.c mandelbrot_kernels.o -o validate -lm -lstdc++
+	gcc -march=native -O3 -pthread -fopenmp -DUSE_TRACE validate.c mandelbrot_kernels.o -o validate -lm -lstdc++
+	// mandelbrot_kernels.o never with -Ofast (double-double, see ddouble.h)
+	// USE_TRACE: TRACEFILE=validate.json ./validate  timeline of the threaded variants (trace.h)
+	// the point is to check the aggressive options (FMA contraction, -Ofast, NT stores) as well
+
+	validate [<seed>]
+
+	stream kernels (all variants registered in stream_kernels.h):
+	  each variant runs on the same random inputs for
+	  - sizes NUMSIZES sizes 0...4099 (SIMD tails, thread blocks with remainder)
+	  - misaligned starts: a and b,c,d independently offset by 0...3 elements
+	  - strides 1,2,3,8 (strided variants)
+	  GUARD elements before and after a and all elements not written (i%stride!=0) hold a
+	  sentinel NaN that has to survive bitwise (tail and peel loops writing out of bounds).
+	  The reference is the correctly rounded result (fma() for the triads), the allowed deviation
+	  is maxulp of the variant. The inputs are positive (exponents -20...20), such that
+	  separate multiply and add is within 1 ULP of the fused result.
+	Mandelbrot (mandelbrot.h): rows, reversed row blocks, odd sized tiles, OpenMP and pthread rows
+	  have to give exactly the iteration buffer of a per pixel loop and the same sum for all views.
+	  These are the decompositions of mandelbrot_par.c (rows), mandelbrot_anim.c (row blocks) and
+	  mandelbrot_tiled.c (tiles), which call mandelbrot_point()/mandelbrot_block() of mandelbrot.h.
+	  With -Ofast (-ffast-math: reassociation) this is not guaranteed: the evaluation order of
+	  the kernel then depends on where it is inlined/vectorized, and pixels near the boundary
+	  of the set may differ (seen for larger views). -O3 -march=native (FMA contraction) passes.
+	mandelbrot_kernels.cpp (dispatch table, mandelbrot_kernels.h): every kernel (float, double,
+	  dd, fixed, powers 2...6 and generic, Mandelbrot and Julia, check intervals) on views with
+	  SIMD tails, against a per pixel loop with the arithmetic of the templated kernel at the
+	  pixel coordinates the kernels use, also the returned sum. float and double have to match
+	  their reference exactly, dd and fixed (other rounding) the double one up to MAXDIFFFRACTION
+	  of the pixels. FMA contraction (__FMA__) lets the compiler choose per instantiation which
+	  products are fused: float Julia sets then differ in up to 10% of the pixels, also between
+	  check intervals, i.e. MAXDIFFFRACTIONFLOAT (double: MAXDIFFFRACTION). With
+	  -ffp-contract=off float and double match exactly again.
+
+	Exit code 0 if everything passed, 1 otherwise.
+	(The DEBUG maxerror check of the stream programs only covers the variant compiled in.)
+*/
+
+#include<stdlib.h>	/* malloc(),free(),atol(),rand_r() */
+#include<stdio.h>	/* printf() */
+#include<string.h>	/* memcpy(),memcmp() */
+#include<stdint.h>	/* int64_t,uint64_t */
+#include<math.h>	/* fma(),ldexp() */
+#include<pthread.h>
+
+#include "stream_kernels.h"
+#include "mandelbrot.h"
+#include "mandelbrot_kernels.h"
+
+#define GUARD 8
+#define MAXOFFSET 3
+#define NUMPTHREADS 3	/* Mandelbrot pthread variant */
+#define GENERICPOWER 7	/* power for the generic kernels of mandelbrot_kernels.cpp (instantiated up to 6) */
+#define MAXDIFFFRACTION 0.01	/* allowed differing pixels: dd and fixed against the double reference, */
+#define MAXDIFFFRACTIONFLOAT 0.15	/* FMA contraction: double, float against their references */
+static const Tindex sizes[]={0,1,2,3,4,5,7,8,9,15,16,17,31,32,33,63,64,65,127,128,129,1000,1023,1024,1025,4099};
+#define NUMSIZES (sizeof(sizes)/sizeof(sizes[0]))
+#define MAXN 4099
+static const Tindex strides[]={1,2,3,8};
+static const uint64_t sentinelbits=0x7ff8deadbeef0001UL;	/* quiet NaN with payload */
+
+
+/* stream kernels ===============================================================================*/
+static inline uint64_t bits(Tfloat x)
+{
+	uint64_t u;
+	memcpy(&u,&x,sizeof(u));
+	return u;
+}
+
+static inline uint64_t ulpdistance(Tfloat x, Tfloat y)
+{	/* on the integer representation (no floating point compare, also valid with -ffast-math) */
+	int64_t ix=(int64_t)bits(x), iy=(int64_t)bits(y);
+	if(ix<0) ix=INT64_MIN-ix;	/* monotonic mapping of the negative numbers */
+	if(iy<0) iy=INT64_MIN-iy;
+	return (ix>iy)?(uint64_t)ix-(uint64_t)iy:(uint64_t)iy-(uint64_t)ix;
+}
+
+static inline Tfloat reference(Tstreamop op, Tfloat b, Tfloat c, Tfloat d, Tfloat s)
+{	/* correctly rounded */
+	switch(op)
+	{
+		case COPY: return b;
+		case ADD: return b+c;
+		case sTRIAD: return fma(s,b,c);
+		case vTRIAD: return fma(b,c,d);
+	}
+	return 0.;
+}
+
+Tfloat randompositive(unsigned int *seed)
+{	/* random mantissa, exponent -20...20 */
+	Tfloat m=1.+(Tfloat)rand_r(seed)/RAND_MAX;
+	return ldexp(m,rand_r(seed)%41-20);
+}
+
+typedef struct {
+	unsigned long cases, failures;
+	uint64_t maxulp;
+} Tstreamresult;
+
+/* run kernel k for one size, offset and stride, returns the number of wrong elements */
+unsigned long check_stream(const Tstreamkernel *k, Tindex N, Tindex aoffset, Tindex offset, Tindex stride
+                          ,Tfloat *abuf, const Tfloat *b, const Tfloat *c, const Tfloat *d, Tfloat s
+                          ,uint64_t *maxulp, int verbose)
+{
+	Tfloat sentinel;
+	memcpy(&sentinel,&sentinelbits,sizeof(sentinel));
+	Tindex i, total=N+2*GUARD+MAXOFFSET;
+	unsigned long wrong=0;
+	for(i=0;i<total;++i) abuf[i]=sentinel;
+	Tfloat *a=abuf+GUARD+aoffset;
+	k->func(N,stride,a,b+offset,c+offset,d+offset,s);
+	for(i=0;i<total;++i)
+	{
+		Tindex j=i-GUARD-aoffset;	/* index in a (wraps around below a) */
+		int written=(i>=GUARD+aoffset && j<N && j%stride==0);
+		if(written)
+		{
+			Tfloat expected=reference(k->op,b[offset+j],c[offset+j],d[offset+j],s);
+			uint64_t ulp=ulpdistance(a[j],expected);
+			if(ulp>*maxulp) *maxulp=ulp;
+			if(ulp<=k->maxulp) continue;
+			if(verbose && !wrong)
+				printf("#\t%s N=%lu offset a %lu b,c,d %lu stride %lu: a[%lu]=%.17g expected %.17g (%lu ULP)\n"
+				      ,k->name,N,aoffset,offset,stride,j,a[j],expected,(unsigned long)ulp);
+		}
+		else
+		{	/* has to be untouched */
+			if(bits(abuf[i])==sentinelbits) continue;
+			if(verbose && !wrong)
+				printf("#\t%s N=%lu offset a %lu b,c,d %lu stride %lu: element %ld (relative to a) overwritten\n"
+				      ,k->name,N,aoffset,offset,stride,(long)i-(long)(GUARD+aoffset));
+		}
+		++wrong;
+	}
+	return wrong;
+}
+
+int validate_stream(unsigned int seed)
+{
+	Tindex total=MAXN+2*GUARD+MAXOFFSET, i;
+	Tfloat *abuf=(Tfloat*)malloc(total*sizeof(Tfloat));
+	Tfloat *b=(Tfloat*)malloc(total*sizeof(Tfloat));
+	Tfloat *c=(Tfloat*)malloc(total*sizeof(Tfloat));
+	Tfloat *d=(Tfloat*)malloc(total*sizeof(Tfloat));
+	if(!abuf || !b || !c || !d)
+	{
+		printf("ERROR allocating memory\n");
+		exit(1);
+	}
+	for(i=0;i<total;++i)
+	{
+		b[i]=randompositive(&seed);
+		c[i]=randompositive(&seed);
+		d[i]=randompositive(&seed);
+	}
+	Tfloat s=randompositive(&seed);
+
+	int failed=0;
+	unsigned int kk;
+	printf("# stream kernels: %u sizes 0...%lu, offsets 0...%d, reference correctly rounded\n"
+	      ,(unsigned int)NUMSIZES,(Tindex)MAXN,MAXOFFSET);
+	printf("# kernel\top\tcases\tmaxulp(allowed)\tmaxulp(observed)\tfailed cases\tresult\n");
+	for(kk=0;kk<numstreamkernels;++kk)
+	{
+		const Tstreamkernel *k=&streamkernels[kk];
+		Tstreamresult r={0,0,0};
+		unsigned int si, sti;
+		Tindex aoffset, offset;
+		for(si=0;si<NUMSIZES;++si)
+			for(sti=0;sti<(k->strided?sizeof(strides)/sizeof(strides[0]):1);++sti)
+				for(aoffset=0;aoffset<=MAXOFFSET;++aoffset)
+					for(offset=0;offset<=MAXOFFSET;++offset)
+					{
+						++r.cases;
+						if(check_stream(k,sizes[si],aoffset,offset,strides[sti],abuf,b,c,d,s,&r.maxulp,!r.failures))
+							++r.failures;
+					}
+		printf("%s\t%s\t%lu\t%u\t%lu\t%lu\t%s\n",k->name,streamopname[k->op],r.cases,k->maxulp
+		      ,(unsigned long)r.maxulp,r.failures,r.failures?"FAILED":"passed");
+		if(r.failures) failed=1;
+	}
+
+	free(d);
+	free(c);
+	free(b);
+	free(abuf);
+	return failed;
+}
+
+
+/* Mandelbrot ===================================================================================*/
+typedef struct {
+	const Tview *v;
+	Titer *M;
+	unsigned int t;
+	unsigned long sumiter;
+} Tmbthread;
+
+void* mandelbrot_pthread_rows(void *arg)
+{	/* cyclic rows */
+	Tmbthread *w=(Tmbthread*)arg;
+	Tindex row;
+	w->sumiter=0;
+	for(row=w->t;row<w->v->numrows;row+=NUMPTHREADS) w->sumiter+=mandelbrot_rows(w->v,w->M,row,row+1);
+	return NULL;
+}
+
+unsigned long mandelbrot_variant(int variant, const Tview *v, Titer *M)
+{	/* returns the sum of the iterations as reported by the kernels */
+	unsigned long sumiter=0;
+	Tindex row, column, numrows=v->numrows, numcolumns=v->numcolumns;
+	switch(variant)
+	{
+		case 0:	/* whole image */
+			sumiter=mandelbrot_rows(v,M,0,numrows);
+			break;
+		case 1:	/* blocks of 3 rows, last block first */
+			for(row=(numrows-1)/3*3;;row-=3)
+			{
+				sumiter+=mandelbrot_rows(v,M,row,(row+3<numrows)?row+3:numrows);
+				if(row==0) break;
+			}
+			break;
+		case 2:	/* 7x5 tiles, edge tiles smaller */
+			for(row=0;row<numrows;row+=5)
+				for(column=0;column<numcolumns;column+=7)
+					sumiter+=mandelbrot_block(v,M+colrow2index(column,row,numcolumns),numcolumns
+					                         ,column,(column+7<numcolumns)?column+7:numcolumns
+					                         ,row,(row+5<numrows)?row+5:numrows);
+			break;
+		case 3:	/* OpenMP rows */
+		{
+			long r;	/* signed loop variable for OpenMP 2.5 */
+#pragma omp parallel for schedule(dynamic) reduction(+:sumiter)
+			for(r=0;r<(long)numrows;++r) sumiter+=mandelbrot_rows(v,M,r,r+1);
+			break;
+		}
+		case 4:	/* pthreads, cyclic rows */
+		{
+			pthread_t threads[NUMPTHREADS];
+			Tmbthread w[NUMPTHREADS];
+			unsigned int t;
+			for(t=0;t<NUMPTHREADS;++t)
+			{
+				w[t].v=v; w[t].M=M; w[t].t=t;
+				pthread_create(&threads[t],NULL,mandelbrot_pthread_rows,&w[t]);
+			}
+			for(t=0;t<NUMPTHREADS;++t)
+			{
+				pthread_join(threads[t],NULL);
+				sumiter+=w[t].sumiter;
+			}
+			break;
+		}
+	}
+	return sumiter;
+}
+static const char *mandelbrotvariantname[]={"rows","rowblocks_reversed","tiles7x5","omp_rows","pthread_rows"};
+#define NUMMANDELBROTVARIANTS 5
+
+int validate_mandelbrot(void)
+{
+	static const struct {
+		Tindex numcolumns, numrows;
+		Titer maxiter;
+		Tfloat CrealMin, CimgMin, CrealMax, CimgMax;
+	} views[]={
+		{ 200, 150,  255,-2.,-1.5,1.,1.5},
+		{ 157,  91, 1000,-0.7436438870371,0.1318259042052,-0.7436438870369,0.1318259042054},
+		{ 161,  61, 4096,0.25,-0.12,0.41,0.},
+		{  37,  23,    1,-2.,-2.,2.,2.},
+		{   1,   1,  100,-0.75,0.1,-0.75,0.1},
+		{   1,  97,  500,-0.75,-1.,-0.75,1.},
+		{  97,   1,  500,-2.,0.,0.5,0.}};
+	unsigned int numviews=sizeof(views)/sizeof(views[0]), vi;
+	int variant, failed=0;
+	unsigned long differing[NUMMANDELBROTVARIANTS]={0}, wrongsum[NUMMANDELBROTVARIANTS]={0};
+	int firstview[NUMMANDELBROTVARIANTS];
+	for(variant=0;variant<NUMMANDELBROTVARIANTS;++variant) firstview[variant]=-1;
+
+	for(vi=0;vi<numviews;++vi)
+	{
+		Tview v;
+		view_init(&v,views[vi].numcolumns,views[vi].numrows,views[vi].maxiter
+		         ,views[vi].CrealMin,views[vi].CimgMin,views[vi].CrealMax,views[vi].CimgMax);
+		Tindex n=v.numcolumns*v.numrows, i, row, column;
+		Titer *R=(Titer*)malloc(n*sizeof(Titer)), *M=(Titer*)malloc(n*sizeof(Titer));
+		if(!R || !M)
+		{
+			printf("ERROR allocating memory\n");
+			exit(1);
+		}
+		/* reference: per pixel, C as defined in mandelbrot.h */
+		Tfloat dCreal=view_dCreal(&v), dCimg=view_dCimg(&v);
+		for(row=0;row<v.numrows;++row)
+			for(column=0;column<v.numcolumns;++column)
+				R[colrow2index(column,row,v.numcolumns)]=mandelbrot_point(v.CrealMin+column*dCreal
+				                                         ,v.CimgMax+row*dCimg,v.maxiter,v.Zabs2bound);
+		for(variant=0;variant<NUMMANDELBROTVARIANTS;++variant)
+		{
+			unsigned long sumiter, sum=0, d=0;
+			for(i=0;i<n;++i) M[i]=~(Titer)0;	/* pixels not written show up */
+			sumiter=mandelbrot_variant(variant,&v,M);
+			for(i=0;i<n;++i)
+			{
+				sum+=M[i];
+				if(M[i]!=R[i]) ++d;
+			}
+			differing[variant]+=d;
+			if(sum!=sumiter) ++wrongsum[variant];
+			if((d || sum!=sumiter) && firstview[variant]<0) firstview[variant]=vi;
+		}
+		free(M);
+		free(R);
+	}
+	printf("# Mandelbrot: %u views, exact equality with the per pixel reference\n",numviews);
+	printf("# variant\tdiffering pixels\tviews with wrong sumiter\tfirst failing view\tresult\n");
+	for(variant=0;variant<NUMMANDELBROTVARIANTS;++variant)
+	{
+		int ok=(differing[variant]==0 && wrongsum[variant]==0);
+		printf("%s\t%lu\t%lu\t%d\t%s\n",mandelbrotvariantname[variant],differing[variant],wrongsum[variant]
+		      ,firstview[variant],ok?"passed":"FAILED");
+		if(!ok) failed=1;
+	}
+	return failed;
+}
+
+
+/* mandelbrot_kernels.cpp =======================================================================*/
+/* per pixel reference with the arithmetic of zpow() and escape_lanes() of mandelbrot_kernels.cpp:
+   power 2: 2*Zreal*Zimg, otherwise power-1 complex multiplications, the number of iterations
+   with |z|^2<=bound */
+static Titer mbk_reference_double(double Zreal, double Zimg, double Creal, double Cimg, int power, Titer maxiter, double bound)
+{
+	Titer i;
+	for(i=0;i<maxiter;++i)
+	{
+		if(power==2)
+		{
+			double Zreal_tmp=Zreal*Zreal-Zimg*Zimg;
+			Zimg=2.*Zreal*Zimg;
+			Zreal=Zreal_tmp;
+		}
+		else
+		{
+			double Preal=Zreal, Pimg=Zimg, Preal_tmp;
+			int k;
+			for(k=1;k<power;++k)
+			{
+				Preal_tmp=Preal*Zreal-Pimg*Zimg;
+				Pimg=Preal*Zimg+Pimg*Zreal;
+				Preal=Preal_tmp;
+			}
+			Zreal=Preal;
+			Zimg=Pimg;
+		}
+		Zreal=Zreal+Creal;
+		Zimg=Zimg+Cimg;
+		if(!(Zreal*Zreal+Zimg*Zimg<=bound)) break;	/* NaN escapes, too */
+	}
+	return i;
+}
+
+static Titer mbk_reference_float(float Zreal, float Zimg, float Creal, float Cimg, int power, Titer maxiter, float bound)
+{
+	Titer i;
+	for(i=0;i<maxiter;++i)
+	{
+		if(power==2)
+		{
+			float Zreal_tmp=Zreal*Zreal-Zimg*Zimg;
+			Zimg=2.f*Zreal*Zimg;
+			Zreal=Zreal_tmp;
+		}
+		else
+		{
+			float Preal=Zreal, Pimg=Zimg, Preal_tmp;
+			int k;
+			for(k=1;k<power;++k)
+			{
+				Preal_tmp=Preal*Zreal-Pimg*Zimg;
+				Pimg=Preal*Zimg+Pimg*Zreal;
+				Preal=Preal_tmp;
+			}
+			Zreal=Preal;
+			Zimg=Pimg;
+		}
+		Zreal=Zreal+Creal;
+		Zimg=Zimg+Cimg;
+		if(!(Zreal*Zreal+Zimg*Zimg<=bound)) break;
+	}
+	return i;
+}
+
+typedef struct {
+	unsigned long cases, pixels, differing, wrongsum;
+	int failed;
+	char firstfailure[64];
+} Tmbkresult;
+
+int validate_mandelbrot_kernels(void)
+{
+	static const struct {
+		Tindex numcolumns, numrows;
+		Titer maxiter;
+		const char *CrealMin, *CimgMin, *CrealMax, *CimgMax;
+	} views[]={
+		{ 120,  90,  255,"-2","-1.5","1","1.5"},
+		{ 161,  61,  400,"0.25","-0.12","0.41","0"},
+		{  33,  17, 1000,"-1.5","-1.5","1.5","1.5"},
+		{  37,  23,    1,"-2","-2","2","2"},
+		{   1,   1,  100,"-0.75","0.1","-0.75","0.1"},
+		{  97,   1,  500,"-2","0","0.5","0"}};
+	static const int powers[]={2,3,4,5,6,GENERICPOWER};
+	unsigned int numviews=sizeof(views)/sizeof(views[0]), numpowers=sizeof(powers)/sizeof(powers[0]);
+	unsigned int numkernels=mbkernels_num(), k, vi, pi;
+	int julia, failed=0;
+	Tmbkresult *results=(Tmbkresult*)calloc(numkernels,sizeof(Tmbkresult));
+	if(!results)
+	{
+		printf("ERROR allocating memory\n");
+		exit(1);
+	}
+
+	for(vi=0;vi<numviews;++vi)
+		for(pi=0;pi<numpowers;++pi)
+			for(julia=0;julia<=1;++julia)
+			{
+				Tmbkview v={views[vi].numcolumns,views[vi].numrows,views[vi].maxiter,powers[pi],julia
+				           ,views[vi].CrealMin,views[vi].CimgMin,views[vi].CrealMax,views[vi].CimgMax,"-0.8","0.156"
+				           ,0.,0.,0.,0};
+				Tindex n=v.numcolumns*v.numrows, i, row, column;
+				double *Creal=(double*)malloc(v.numcolumns*sizeof(double)), *Cimg=(double*)malloc(v.numrows*sizeof(double));
+				Titer *Rdouble=(Titer*)malloc(n*sizeof(Titer)), *Rfloat=(Titer*)malloc(n*sizeof(Titer));
+				Titer *M=(Titer*)malloc(n*sizeof(Titer));
+				if(!Creal || !Cimg || !Rdouble || !Rfloat || !M)
+				{
+					printf("ERROR allocating memory\n");
+					exit(1);
+				}
+				mbkernels_view(&v,Creal,Cimg);
+				for(row=0;row<v.numrows;++row)
+					for(column=0;column<v.numcolumns;++column)
+					{	/* Mandelbrot: z_0=0, c=pixel, Julia: z_0=pixel, c fixed */
+						double Zreal=julia?Creal[column]:0., Zimg=julia?Cimg[row]:0.;
+						double Cr=julia?v.Jrealvalue:Creal[column], Ci=julia?v.Jimgvalue:Cimg[row];
+						i=colrow2index(column,row,v.numcolumns);
+						Rdouble[i]=mbk_reference_double(Zreal,Zimg,Cr,Ci,v.power,v.maxiter,v.Zabs2bound);
+						Rfloat[i]=mbk_reference_float((float)Zreal,(float)Zimg,(float)Cr,(float)Ci,v.power,v.maxiter
+						                             ,(float)v.Zabs2bound);
+					}
+				for(k=0;k<numkernels;++k)
+				{
+					Tmbkernelinfo info=mbkernels_info(k);
+					Tmbkresult *r=&results[k];
+					unsigned long sumiter, sum=0, d=0, allowed=0;
+					const Titer *R=Rdouble;
+					if(info.julia!=julia || (info.power!=v.power && !(info.power==0 && v.power==GENERICPOWER))) continue;
+					if(!strcmp(info.prec,"float")) R=Rfloat;
+					if(strcmp(info.prec,"float") && strcmp(info.prec,"double")) allowed=(unsigned long)(MAXDIFFFRACTION*n);
+#ifdef __FMA__
+					else	/* contraction: the evaluation order depends on the instantiation */
+						allowed=(unsigned long)((R==Rfloat?MAXDIFFFRACTIONFLOAT:MAXDIFFFRACTION)*n);
+#endif
+					for(i=0;i<n;++i) M[i]=~(Titer)0;
+					sumiter=mbkernels_render(k,&v,M);
+					for(i=0;i<n;++i)
+					{
+						sum+=M[i];
+						if(M[i]!=R[i]) ++d;
+					}
+					++r->cases;
+					r->pixels+=n;
+					r->differing+=d;
+					if(sum!=sumiter) ++r->wrongsum;
+					if((d>allowed || sum!=sumiter) && !r->failed)
+					{
+						r->failed=1;
+						snprintf(r->firstfailure,sizeof(r->firstfailure),"view %u d=%d",vi,v.power);
+					}
+				}
+				free(M);
+				free(Rfloat);
+				free(Rdouble);
+				free(Cimg);
+				free(Creal);
+			}
+
+	printf("# mandelbrot_kernels.cpp: %u views, powers 2...6 and %d (generic), Mandelbrot and Julia c=-0.8+0.156i\n"
+	      ,numviews,GENERICPOWER);
+	printf("# per pixel reference with the same arithmetic: float and double exactly, dd and fixed against double\n");
+	printf("#   with at most %g%% differing pixels per case",MAXDIFFFRACTION*100.);
+#ifdef __FMA__
+	printf(" (FMA contraction: double %g%%, float %g%%)",MAXDIFFFRACTION*100.,MAXDIFFFRACTIONFLOAT*100.);
+#endif
+	printf("\n");
+	printf("# kernel\tcases\tpixels\tdiffering pixels\tcases with wrong sumiter\tfirst failing case\tresult\n");
+	for(k=0;k<numkernels;++k)
+	{
+		Tmbkernelinfo info=mbkernels_info(k);
+		Tmbkresult *r=&results[k];
+		char power[16];
+		if(info.power) snprintf(power,sizeof(power),"d%d",info.power);
+		else snprintf(power,sizeof(power),"generic");
+		printf("%s_%s_%s_k%d\t%lu\t%lu\t%lu\t%lu\t%s\t%s\n",info.prec,info.julia?"julia":"mandelbrot",power,info.check
+		      ,r->cases,r->pixels,r->differing,r->wrongsum,r->failed?r->firstfailure:"-"
+		      ,r->failed?"FAILED":(r->cases?"passed":"not run"));
+		if(r->failed || !r->cases) failed=1;
+	}
+	free(results);
+	return failed;
+}
+
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed=1;
+	if (argc>1) seed=(unsigned int)atol(argv[1]);
+	TRACE_INIT(getenv("TRACEFILE"));
+
+	int failed=validate_stream(seed);
+	failed|=validate_mandelbrot();
+	failed|=validate_mandelbrot_kernels();
+	printf("%s\n",failed?"FAILED":"PASSED");
+	TRACE_WRITE();
+	return failed;
+}
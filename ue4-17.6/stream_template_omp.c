@@ -63,7 +63,7 @@ int main(int argc, char *argv[]) {
   struct timespec clkt_start, clkt_end, clkt_res;
   /*================================================================================================*/
   clock_gettime(clkt_id, &clkt_start);
-  float start_time = omp_get_wtime();
+  double start_time = omp_get_wtime(); /* not float: 24 bit mantissa, ms resolution at typical uptimes */
 
   /*for(j=0;j<nrepeat;++j)*/
 #pragma omp parallel for
@@ -71,13 +71,13 @@ int main(int argc, char *argv[]) {
     a[i] = b[i] * c[i] + d[i];
   }
 
-  float stop_time = omp_get_wtime(); 
+  double stop_time = omp_get_wtime();
   clock_gettime(clkt_id, &clkt_end);
   /*================================================================================================*/
   double time_diff = (double)(clkt_end.tv_sec - clkt_start.tv_sec) +
                      (double)(clkt_end.tv_nsec - clkt_start.tv_nsec) / 1.E9;
 
-  printf("%lu %lu\t%g\t%f\n", n, nrepeat, time_diff, stop_time - start_time);
+  printf("%lu %lu\t%g\t%g\n", n, nrepeat, time_diff, stop_time - start_time);
 
   free(d);
   free(c);
@@ -4,6 +4,10 @@
 
 	gcc -Wall -g mandelbrot_seq.c -o mandelbrot_seq
 	gcc -march=corei7-avx -O3 -ftree-vectorizer-verbose=3 mandelbrot_seq.c -o mandelbrot_seq
+	gcc -O3 -fopenmp -pthread -DUSE_TRACE mandelbrot_par.c -o mandelbrot_par
+	// timeline of the omp critical (../template/trace.h): "critical wait" until a thread enters
+	// it, "critical" inside, the last TRACE_BUFFERSIZE events per thread
+	$ TRACEFILE=par.json ./mandelbrot_par 400 400 255
 
 	try also e.g.
 	$ ./mandelbrot_seq 640 480  127 -2 -0.9375 0.5 0.9375 mandelbrot1.pgm
@@ -43,6 +47,8 @@
 #include<stdlib.h>	/* malloc(),labs(),atol() */
 #include<stdio.h>	/* printf() */
 
+#include "../template/trace.h"	/* TRACE_* macros, empty without USE_TRACE */
+
 #if defined(USE_CLOCK) || defined(USE_CLOCKGETTIME)
 #include <time.h>	/* clock(), clock_gettime(),clock_getres() */
 #endif
@@ -142,6 +148,7 @@ int main(int argc, char *argv[])
 	}
 
 	Tindex numelements=numcolumns*numrows;
+	TRACE_INIT(getenv("TRACEFILE"));
 	
 	printf("width x height:\t%lu x %lu\n",numcolumns,numrows);
 	printf("C Range:\t%g + %g i\t-\t%g + %g i\n",CrealMin,CimgMin,CrealMax,CimgMax);
@@ -194,11 +201,15 @@ int main(int argc, char *argv[])
 				Zabs2=Zreal*Zreal+Zimg*Zimg;	/* 3 FlOp */
 				if(Zabs2>Zabs2bound) break;
 			}
+			TRACE_START(trace_wait);
 #pragma omp critical
 			{
+			TRACE_SPAN("critical wait",trace_wait,(long)column);
+			TRACE_START(trace_critical);
 			*(Mact++)=i;	/* *Mact=i; ++Mact; */
 			/*M[colrow2index(column,row,numcolumns)]=i;*/
 			Creal+=dCreal;
+			TRACE_SPAN("critical",trace_critical,-1);
 			}
 		}
 		/*printf("%lu\r",row*100/numrows);fflush(stdout);*/
@@ -226,6 +237,7 @@ int main(int argc, char *argv[])
 	
 	writePGM(M,maxiter,numcolumns,numrows,filename);
 	printf("PGM file:\t%s\n",filename);
+	TRACE_WRITE();
 
 	free(M);
 	